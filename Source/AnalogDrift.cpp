@@ -0,0 +1,113 @@
+#include "AnalogDrift.h"
+#include "MuOscillator.h"
+
+namespace rosy {
+
+namespace {
+    // Knot spacing of each curve; the drift wanders over a few knots, the jitter moves faster
+    constexpr double pitchKnotSeconds = 0.3;
+    constexpr double jitterKnotSeconds = 0.1;
+
+    // Counters per knot: one per harmonic for the jitter, and the last for the pitch
+    constexpr uint32_t lanesPerKnot = static_cast<uint32_t>(AnalogDrift::numHarmonics) + 1;
+    constexpr uint32_t pitchLane = static_cast<uint32_t>(AnalogDrift::numHarmonics);
+
+    // Integer hash with good avalanche (lowbias32), only shifts, xors and multiplies so it vectorises
+    inline uint32_t mix(uint32_t x)
+    {
+        x ^= x >> 16;
+        x *= 0x7feb352du;
+        x ^= x >> 15;
+        x *= 0x846ca68bu;
+        x ^= x >> 16;
+        return x;
+    }
+
+    // Two rounds keyed by the note, so neighbouring counters of neighbouring notes don't line up
+    inline uint32_t hashLane(uint32_t counter, uint32_t noteHash)
+    {
+        return mix(mix(counter ^ noteHash) + noteHash);
+    }
+
+    // The top 24 bits as a float in [-1, 1)
+    inline float toUniform(uint32_t bits)
+    {
+        return static_cast<float>(static_cast<int32_t>(bits >> 8)) * (1.0f / 8388608.0f) - 1.0f;
+    }
+}
+
+void AnalogDrift::prepare(double sampleRate)
+{
+    const double ticksPerSecond = sampleRate / static_cast<double>(MuOscillator<float>::controlInterval);
+    pitchKnotTicks = static_cast<uint64_t>(std::max(1.0, std::round(pitchKnotSeconds * ticksPerSecond)));
+    jitterKnotTicks = static_cast<uint64_t>(std::max(1.0, std::round(jitterKnotSeconds * ticksPerSecond)));
+}
+
+float AnalogDrift::getPitchRatio(uint32_t noteKey, uint64_t tick) const
+{
+    if (! hasPitchDrift())
+        return 1.0f;
+
+    float weights[4];
+    const uint32_t firstKnot = getSplineWeights(tick, pitchKnotTicks, weights);
+    const uint32_t noteHash = getNoteHash(noteKey);
+
+    float curve = 0.0f;
+    for (uint32_t knot = 0; knot < 4; ++knot)
+        curve += weights[knot] * toUniform(hashLane((firstKnot + knot) * lanesPerKnot + pitchLane, noteHash));
+
+    return std::exp2(curve * pitchDriftCents * (1.0f / 1200.0f));
+}
+
+void AnalogDrift::applyGainJitter(uint32_t noteKey, uint64_t tick, float* gains) const
+{
+    if (! hasGainJitter())
+        return;
+
+    float weights[4];
+    const uint32_t firstKnot = getSplineWeights(tick, jitterKnotTicks, weights);
+    const uint32_t noteHash = getNoteHash(noteKey);
+
+    // Every harmonic's knot in one pass over the lanes, then the next knot
+    alignas(32) float curve[numHarmonics] {};
+    for (uint32_t knot = 0; knot < 4; ++knot)
+    {
+        const uint32_t firstCounter = (firstKnot + knot) * lanesPerKnot;
+        const float weight = weights[knot];
+        for (uint32_t lane = 0; lane < static_cast<uint32_t>(numHarmonics); ++lane)
+            curve[lane] += weight * toUniform(hashLane(firstCounter + lane, noteHash));
+    }
+
+    // Decibels to gain, as a natural exponent
+    const float scale = gainJitterDecibels * 0.11512925f;
+    for (size_t harmonic = 0; harmonic < numHarmonics; ++harmonic)
+        gains[harmonic] *= std::exp(curve[harmonic] * scale);
+}
+
+float AnalogDrift::random(uint32_t seed, uint32_t key, uint32_t counter)
+{
+    return toUniform(hashLane(counter, mix(key ^ mix(seed))));
+}
+
+uint32_t AnalogDrift::getSplineWeights(uint64_t tick, uint64_t knotTicks, float* weights)
+{
+    const float t = static_cast<float>(tick % knotTicks) / static_cast<float>(knotTicks);
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+    const float u = 1.0f - t;
+
+    weights[0] = u * u * u * (1.0f / 6.0f);
+    weights[1] = (3.0f * t3 - 6.0f * t2 + 4.0f) * (1.0f / 6.0f);
+    weights[2] = (-3.0f * t3 + 3.0f * t2 + 3.0f * t + 1.0f) * (1.0f / 6.0f);
+    weights[3] = t3 * (1.0f / 6.0f);
+
+    // The knot before the tick's span; counters wrap, so the first note's first knot is fine
+    return static_cast<uint32_t>(tick / knotTicks) - 1;
+}
+
+uint32_t AnalogDrift::getNoteHash(uint32_t noteKey) const
+{
+    return mix(noteKey ^ mix(seed));
+}
+
+} // namespace rosy
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+namespace rosy {
+
+/**
+ * @brief Slow random pitch drift and per-harmonic gain jitter for every note, as pure functions of its age.
+ *
+ * The random numbers come from a counter-based generator: a hash of the seed, the note's key and a counter,
+ * so any point of any note's curve is worked out directly rather than by stepping a generator through every
+ * point before it. Like HarmonicEnvelopes, that leaves no per-voice state to keep in step: a note sounds the
+ * same whatever blocks it's rendered in, alone or alongside others, and a render with the same seed comes out
+ * the same every time.
+ *
+ * Each curve is a uniform cubic B-spline through random knots, which is smooth to the second derivative and
+ * has very little above the knot rate, so the pitch wanders rather than wobbles. The spline's weights sum to 1,
+ * so a curve never goes past its knots' range of -1 to 1.
+ *
+ * The generator works on fixed-width lanes of plain integer arithmetic the compiler vectorises, one lane per
+ * harmonic, so a note's whole jitter at a control tick costs four hashed lane passes.
+ */
+class AnalogDrift
+{
+public:
+    static constexpr size_t numHarmonics { 16 };
+
+    // Pitch is updated every this many control ticks, see MuOscillator::controlInterval
+    static constexpr uint64_t pitchStepTicks { 8 };
+
+    AnalogDrift() = default;
+
+    // The knots are spaced in time, so their spacing in control ticks depends on the sample rate
+    void prepare(double sampleRate);
+
+    // Furthest the pitch drifts either way, 0 turns it off
+    void setPitchDrift(float cents) { pitchDriftCents = std::max(0.0f, cents); }
+
+    // Furthest each harmonic's gain strays either way, 0 turns it off
+    void setGainJitter(float decibels) { gainJitterDecibels = std::max(0.0f, decibels); }
+
+    void setSeed(uint32_t newSeed) { seed = newSeed; }
+
+    bool hasPitchDrift() const { return pitchDriftCents > 0.0f; }
+    bool hasGainJitter() const { return gainJitterDecibels > 0.0f; }
+
+    //==============================================================================
+    // Frequency ratio of a note at a control tick
+    float getPitchRatio(uint32_t noteKey, uint64_t tick) const;
+
+    // Multiplies numHarmonics gains by each harmonic's jitter at a control tick
+    void applyGainJitter(uint32_t noteKey, uint64_t tick, float* gains) const;
+
+    // Uniform in [-1, 1), the same for the same three inputs on any machine
+    static float random(uint32_t seed, uint32_t key, uint32_t counter);
+
+private:
+    // Weights of the four knots around a tick, returning the first of them
+    static uint32_t getSplineWeights(uint64_t tick, uint64_t knotTicks, float* weights);
+
+    // Mixes the seed and a note's key into the value every lane of that note's counters is hashed with
+    uint32_t getNoteHash(uint32_t noteKey) const;
+
+    uint64_t pitchKnotTicks { 1 };
+    uint64_t jitterKnotTicks { 1 };
+
+    float pitchDriftCents { 0.0f };
+    float gainJitterDecibels { 0.0f };
+    uint32_t seed { 1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AnalogDrift)
+};
+
+} // namespace rosy
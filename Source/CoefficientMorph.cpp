@@ -0,0 +1,112 @@
+#include "CoefficientMorph.h"
+#include "HarmonicProfileCalculator.h"
+
+namespace rosy {
+
+template <typename SampleType>
+CoefficientMorph<SampleType>::CoefficientMorph()
+{
+    // Every corner starts as a plain sine
+    for (int index = 0; index < numSnapshots; ++index)
+        setSnapshot(index, { 1.0f });
+
+    updateSnapshots();
+}
+
+template <typename SampleType>
+void CoefficientMorph<SampleType>::setSnapshot(int index, const std::vector<float>& harmonicGains)
+{
+    jassert(juce::isPositiveAndBelow(index, numSnapshots));
+    jassert(harmonicGains.size() < maxCoefficients);
+
+    // Negligible trailing harmonics are left out, so morphs between dull snapshots get a shorter polynomial too
+    const size_t numSignificant = std::min(HarmonicProfileCalculator::countSignificantHarmonics(harmonicGains), harmonicLimit);
+    const std::vector<float> significantGains(harmonicGains.begin(), harmonicGains.begin() + static_cast<std::ptrdiff_t>(numSignificant));
+    const auto newCoefficients = HarmonicProfileCalculator::calculateAllCoefficients<SampleType>(significantGains, harmonicGains);
+    snapshotGains[static_cast<size_t>(index)] = harmonicGains;
+
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+
+    auto& pending = pendingCoefficients[static_cast<size_t>(index)];
+    pending.fill(0);
+    std::copy(newCoefficients.begin(), newCoefficients.end(), pending.begin());
+
+    // Unused high powers are zero, so every snapshot can be evaluated at the longest length
+    pendingSizes[static_cast<size_t>(index)] = newCoefficients.size();
+    pendingNumCoefficients = *std::max_element(pendingSizes.begin(), pendingSizes.end());
+    snapshotsPending.store(true);
+}
+
+template <typename SampleType>
+void CoefficientMorph<SampleType>::setHarmonicLimit(size_t limit)
+{
+    const size_t newLimit = std::max<size_t>(limit, 1);
+    if (newLimit == harmonicLimit)
+        return;
+
+    harmonicLimit = newLimit;
+    for (int index = 0; index < numSnapshots; ++index)
+    {
+        const auto gains = snapshotGains[static_cast<size_t>(index)];
+        setSnapshot(index, gains);
+    }
+}
+
+template <typename SampleType>
+void CoefficientMorph<SampleType>::updateSnapshots()
+{
+    if (! snapshotsPending.load())
+        return;
+
+    const juce::SpinLock::ScopedTryLockType lock(pendingLock);
+    if (! lock.isLocked())
+        return;  // Try again next block
+
+    coefficients = pendingCoefficients;
+    numCoefficients = pendingNumCoefficients;
+    snapshotsPending.store(false);
+}
+
+template <typename SampleType>
+void CoefficientMorph<SampleType>::morph(SampleType x, SampleType y, SampleType* destination) const
+{
+    x = juce::jlimit(SampleType(0), SampleType(1), x);
+    y = juce::jlimit(SampleType(0), SampleType(1), y);
+
+    // Bilinear weights for the four corners
+    const SampleType weights[numSnapshots] = { (1 - x) * (1 - y), x * (1 - y), (1 - x) * y, x * y };
+
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+    constexpr size_t width = Vec::SIMDNumElements;
+    static_assert(maxCoefficients % width == 0, "Coefficient sets must be a whole number of registers");
+
+    // The destination is usually a small stack array, so blend into an aligned one and copy out
+    alignas(32) CoefficientSet result;
+    for (size_t i = 0; i < numCoefficients; i += width)
+    {
+        Vec sum = Vec::fromRawArray(coefficients[0].data() + i) * Vec::expand(weights[0]);
+        for (size_t snapshot = 1; snapshot < numSnapshots; ++snapshot)
+            sum = Vec::multiplyAdd(sum, Vec::expand(weights[snapshot]), Vec::fromRawArray(coefficients[snapshot].data() + i));
+
+        sum.copyToRawArray(result.data() + i);
+    }
+
+    std::copy(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(numCoefficients), destination);
+   #else
+    for (size_t i = 0; i < numCoefficients; ++i)
+    {
+        SampleType sum = 0;
+        for (size_t snapshot = 0; snapshot < numSnapshots; ++snapshot)
+            sum += weights[snapshot] * coefficients[snapshot][i];
+
+        destination[i] = sum;
+    }
+   #endif
+}
+
+//==============================================================================
+template class CoefficientMorph<float>;
+template class CoefficientMorph<double>;
+
+} // namespace rosy
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+namespace rosy {
+
+/**
+ * @brief Four stored harmonic profiles and a bilinear morph between them in coefficient space.
+ *
+ * The shaping polynomial is linear in the harmonic gains, so blending waveshapes doesn't need the gains at
+ * all: the morph is the same weighted sum applied to the four snapshots' coefficient vectors. Snapshots are
+ * converted to coefficients once when they are stored, after which a morph costs four multiply-adds per SIMD
+ * register of coefficients, with no dependency on how the profile was built. Each snapshot is already
+ * normalised to a peak of 1 and the bilinear weights sum to 1, so every morph position stays within [-1, 1].
+ *
+ * The corners sit on an XY pad: snapshot 0 at (0, 0), 1 at (1, 0), 2 at (0, 1) and 3 at (1, 1).
+ *
+ * Snapshots are stored from the message thread and handed over under a SpinLock that the audio thread only
+ * ever tries, so a store can at worst be picked up one block late.
+ */
+template <typename SampleType>
+class CoefficientMorph
+{
+public:
+    static constexpr int numSnapshots { 4 };
+
+    // Room for a 16 harmonic profile plus the constant term, padded to a whole number of SIMD registers
+    static constexpr size_t maxCoefficients { 24 };
+
+    CoefficientMorph();
+
+    //==============================================================================
+    // Message thread
+    void setSnapshot(int index, const std::vector<float>& harmonicGains);
+    const std::vector<float>& getSnapshotGains(int index) const { return snapshotGains[static_cast<size_t>(index)]; }
+
+    // Recalculates every snapshot with at most this many harmonics, see MuOscillator::setHarmonicLimit()
+    void setHarmonicLimit(size_t limit);
+
+    //==============================================================================
+    // Audio thread
+    // Takes over any snapshots stored since the last call, call once per block before morphing
+    void updateSnapshots();
+
+    size_t getNumCoefficients() const { return numCoefficients; }
+
+    // Writes getNumCoefficients() coefficients for the position (x, y), both in [0, 1], into destination
+    void morph(SampleType x, SampleType y, SampleType* destination) const;
+
+private:
+    using CoefficientSet = std::array<SampleType, maxCoefficients>;
+
+    alignas(32) std::array<CoefficientSet, numSnapshots> coefficients {};
+    size_t numCoefficients { 1 };
+
+    // Written by setSnapshot(), copied into coefficients by updateSnapshots()
+    std::array<CoefficientSet, numSnapshots> pendingCoefficients {};
+    std::array<size_t, numSnapshots> pendingSizes {};
+    size_t pendingNumCoefficients { 1 };
+    std::atomic<bool> snapshotsPending { false };
+    juce::SpinLock pendingLock;
+
+    // Kept for display and for saving with the plugin state
+    std::array<std::vector<float>, numSnapshots> snapshotGains;
+    size_t harmonicLimit { maxCoefficients - 1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CoefficientMorph)
+};
+
+/**
+ * @brief Per-sample morph positions for a block, or none if the morph is off.
+ *
+ * Positions are sampled at each control tick, so anything that can fill a buffer can modulate the morph,
+ * up to audio rate.
+ */
+template <typename SampleType>
+struct MorphPositions
+{
+    const CoefficientMorph<SampleType>* morph { nullptr };
+    const SampleType* x { nullptr };
+    const SampleType* y { nullptr };
+
+    bool isActive() const { return morph != nullptr; }
+
+    // The same positions starting numSamples further into the block
+    MorphPositions offsetBy(size_t numSamples) const
+    {
+        return isActive() ? MorphPositions { morph, x + numSamples, y + numSamples } : *this;
+    }
+};
+
+} // namespace rosy
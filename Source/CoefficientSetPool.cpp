@@ -0,0 +1,151 @@
+#include "CoefficientSetPool.h"
+#include "HarmonicProfileCalculator.h"
+
+namespace rosy {
+
+template <typename SampleType>
+CoefficientSetPool<SampleType>::CoefficientSetPool()
+{
+    static_assert(MuOscillator<SampleType>::numHarmonics + 1 == maxCoefficients, "A set holds a whole profile");
+    clear();
+}
+
+template <typename SampleType>
+void CoefficientSetPool<SampleType>::setQuantisationSteps(int steps)
+{
+    jassert(steps > 0);
+    quantisationSteps = std::max(1, steps);
+
+    // Existing keys are on the old grid, so nothing can be reused
+    clear();
+}
+
+template <typename SampleType>
+typename CoefficientSetPool<SampleType>::Key CoefficientSetPool<SampleType>::quantise(float x, float y) const
+{
+    auto step = [this](float value) { return juce::roundToInt(juce::jlimit(0.0f, 1.0f, value) * static_cast<float>(quantisationSteps)); };
+    return { step(x), step(y) };
+}
+
+template <typename SampleType>
+int CoefficientSetPool<SampleType>::acquire(Key key, const Profile& profile)
+{
+    lookups.fetch_add(1, std::memory_order_relaxed);
+
+    int freeEntry = -1;
+    for (int index = 0; index < capacity; ++index)
+    {
+        auto& entry = entries[static_cast<size_t>(index)];
+        if (entry.key == key)
+        {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            ++entry.references;
+            entry.lastUsed = ++useCounter;
+            return index;
+        }
+
+        // Prefer an empty slot, then the set that has gone unused longest
+        if (entry.references == 0
+            && (freeEntry < 0 || entries[static_cast<size_t>(freeEntry)].lastUsed > entry.lastUsed))
+            freeEntry = index;
+    }
+
+    // There are far more slots than voices, so one is always free
+    jassert(freeEntry >= 0);
+    auto& entry = entries[static_cast<size_t>(freeEntry)];
+    entry.key = key;
+    entry.references = 1;
+    entry.lastUsed = ++useCounter;
+    calculate(entry, profile);
+
+    return freeEntry;
+}
+
+template <typename SampleType>
+void CoefficientSetPool<SampleType>::release(int entry)
+{
+    auto& released = entries[static_cast<size_t>(entry)];
+    jassert(released.references > 0);
+    released.references = std::max(0, released.references - 1);
+}
+
+template <typename SampleType>
+void CoefficientSetPool<SampleType>::refresh(const Profile& profile)
+{
+    for (auto& entry : entries)
+    {
+        if (entry.references > 0)
+            calculate(entry, profile);
+        else
+            entry = Entry {};
+    }
+}
+
+template <typename SampleType>
+void CoefficientSetPool<SampleType>::clear()
+{
+    for (auto& entry : entries)
+        entry = Entry {};
+
+    useCounter = 0;
+}
+
+template <typename SampleType>
+void CoefficientSetPool<SampleType>::calculate(Entry& entry, const Profile& profile) const
+{
+    constexpr size_t numHarmonics = maxCoefficients - 1;
+    const float steps = static_cast<float>(quantisationSteps);
+    const float x = static_cast<float>(entry.key.x) / steps;
+    const float y = static_cast<float>(entry.key.y) / steps;
+
+    std::array<float, numHarmonics> gains;
+    MuOscillator<SampleType>::calculateShapeGains(x, y, gains.data());
+
+    // Trimmed and normalised by the unpanned profile, like the oscillator's own shape
+    const size_t numSignificant = std::min(HarmonicProfileCalculator::countSignificantHarmonics(gains.data(), numHarmonics),
+                                           profile.harmonicLimit);
+    double normaliser = 0.0;
+    for (float gain : gains)
+        normaliser += gain;
+
+    // Both channels go through the transform as two columns of one product
+    std::array<float, numHarmonics * 2> gainMatrix {};
+    for (size_t channel = 0; channel < 2; ++channel)
+    {
+        std::array<float, numHarmonics> channelGains(gains);
+        MuOscillator<SampleType>::panHarmonicGains(channelGains.data(), numSignificant, channel, profile.shapeXPan,
+                                                   profile.shapeYPan);
+
+        for (size_t n = 0; n < numSignificant; ++n)
+            gainMatrix[n * 2 + channel] = channelGains[n];
+    }
+
+    std::array<double, maxCoefficients * 2> coefficientMatrix;
+    HarmonicProfileCalculator::calculateCoefficientMatrix(gainMatrix.data(), numSignificant, 2, coefficientMatrix.data());
+
+    const double normalisation = std::abs(normaliser) > 1e-10 ? 1.0 / normaliser : 1.0;
+    entry.numCoefficients = numSignificant + 1;
+    for (size_t channel = 0; channel < 2; ++channel)
+        for (size_t power = 0; power < entry.numCoefficients; ++power)
+            entry.coefficients[channel][power] = static_cast<SampleType>(coefficientMatrix[power * 2 + channel] * normalisation);
+}
+
+template <typename SampleType>
+float CoefficientSetPool<SampleType>::getHitRate() const
+{
+    const auto numLookups = lookups.load(std::memory_order_relaxed);
+    return numLookups > 0 ? static_cast<float>(hits.load(std::memory_order_relaxed)) / static_cast<float>(numLookups) : 0.0f;
+}
+
+template <typename SampleType>
+void CoefficientSetPool<SampleType>::resetStatistics()
+{
+    lookups.store(0, std::memory_order_relaxed);
+    hits.store(0, std::memory_order_relaxed);
+}
+
+//==============================================================================
+template class CoefficientSetPool<float>;
+template class CoefficientSetPool<double>;
+
+} // namespace rosy
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include "MuOscillator.h"
+
+namespace rosy {
+
+/**
+ * @brief Reference counted coefficient sets for per-note shapes, shared between every voice with the same shape.
+ *
+ * Shapes are quantised to a grid, and the set for a grid point is calculated from the grid point itself, so
+ * every voice holding a key sounds identical whichever voice asked first. A lookup that finds its key costs a
+ * scan of the pool, only a new key is calculated. Sets no voice holds any more stay cached until their slot is
+ * needed, least recently used first, so notes returning to a recent shape still hit.
+ *
+ * Everything except the statistics is audio thread only. Coarser quantisation gives more hits but larger
+ * audible steps, the hit rate is there to tune it against.
+ */
+template <typename SampleType>
+class CoefficientSetPool
+{
+public:
+    static constexpr size_t maxCoefficients { 17 };
+
+    // Every voice holds at most one set, so this leaves plenty of room for recently released shapes
+    static constexpr int capacity { 64 };
+
+    struct Key
+    {
+        int x { -1 };
+        int y { -1 };
+
+        bool operator== (const Key& other) const { return x == other.x && y == other.y; }
+        bool operator!= (const Key& other) const { return ! operator== (other); }
+    };
+
+    // The oscillator settings every set is worked out with. The pool only ever sees a copy, taken over by the
+    // audio thread, so the message thread can change the oscillators' own while sets are being calculated.
+    struct Profile
+    {
+        float shapeXPan { 0.5f };
+        float shapeYPan { 0.5f };
+        size_t harmonicLimit { static_cast<size_t>(MuOscillator<SampleType>::numHarmonics) };
+    };
+
+    CoefficientSetPool();
+
+    //==============================================================================
+    // Number of steps across each shape axis, changing it empties the pool
+    void setQuantisationSteps(int steps);
+    int getQuantisationSteps() const { return quantisationSteps; }
+    Key quantise(float x, float y) const;
+
+    //==============================================================================
+    // Returns the entry holding the set for key, calculating it with the profile if it isn't cached. Every
+    // acquire() needs a matching release().
+    int acquire(Key key, const Profile& profile);
+    void release(int entry);
+
+    // Recalculates the sets still held, e.g. after the panning changed, and forgets the rest
+    void refresh(const Profile& profile);
+
+    // Drops every set, held or not, for when all the voices are being reset
+    void clear();
+
+    Key getKey(int entry) const { return entries[static_cast<size_t>(entry)].key; }
+    const SampleType* getCoefficients(int entry, size_t channel) const { return entries[static_cast<size_t>(entry)].coefficients[channel].data(); }
+    size_t getNumCoefficients(int entry) const { return entries[static_cast<size_t>(entry)].numCoefficients; }
+
+    //==============================================================================
+    // Any thread
+    float getHitRate() const;
+    void resetStatistics();
+
+private:
+    struct Entry
+    {
+        Key key;
+        int references { 0 };
+        uint64_t lastUsed { 0 };
+        std::array<std::array<SampleType, maxCoefficients>, 2> coefficients {};
+        size_t numCoefficients { 1 };
+    };
+
+    void calculate(Entry& entry, const Profile& profile) const;
+
+    std::array<Entry, capacity> entries;
+    int quantisationSteps { 64 };
+    uint64_t useCounter { 0 };
+
+    std::atomic<uint64_t> lookups { 0 };
+    std::atomic<uint64_t> hits { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CoefficientSetPool)
+};
+
+} // namespace rosy
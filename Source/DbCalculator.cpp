@@ -2,33 +2,50 @@
 
 namespace rosy {
 
-DbCalculator::DbCalculator()
+template <typename SampleType>
+DbCalculator<SampleType>::DbCalculator()
 {
 }
 
-void DbCalculator::prepare(const juce::dsp::ProcessSpec& spec)
+template <typename SampleType>
+void DbCalculator<SampleType>::prepare(const juce::dsp::ProcessSpec& spec)
 {
     sampleRate = static_cast<float>(spec.sampleRate);
     samplesPerSecond = static_cast<int64_t>(spec.sampleRate);
     reset();
 }
 
-void DbCalculator::process(const juce::dsp::ProcessContextReplacing<float>& context)
+template <typename SampleType>
+void DbCalculator<SampleType>::process(const juce::dsp::ProcessContextReplacing<SampleType>& context)
 {
     auto& inputBlock = context.getInputBlock();
     const int numSamples = static_cast<int>(inputBlock.getNumSamples());
     
     // Find peak level across all channels in this block
-    float blockPeak = 0.0f;
+    SampleType blockPeak = 0;
     for (int channel = 0; channel < static_cast<int>(inputBlock.getNumChannels()); ++channel)
     {
-        const float* channelData = inputBlock.getChannelPointer(channel);
-        for (int sample = 0; sample < numSamples; ++sample)
-        {
-            blockPeak = std::max(blockPeak, std::abs(channelData[sample]));
-        }
+        // FloatVectorOperations has SIMD versions for both float and double
+        const auto range = juce::FloatVectorOperations::findMinAndMax(inputBlock.getChannelPointer(channel), numSamples);
+        blockPeak = std::max(blockPeak, std::max(-range.getStart(), range.getEnd()));
     }
     
+    advance(numSamples, static_cast<float>(blockPeak));
+}
+
+template <typename SampleType>
+void DbCalculator<SampleType>::processSilence(int numSamples)
+{
+    // Nothing left to decay
+    if (peakLevel.load() == 0.0f)
+        return;
+    
+    advance(numSamples, 0.0f);
+}
+
+template <typename SampleType>
+void DbCalculator<SampleType>::advance(int numSamples, float blockPeak)
+{
     // Update sample count
     int64_t currentSampleCount = samplesSincePeak.load();
     currentSampleCount += numSamples;
@@ -37,15 +54,15 @@ void DbCalculator::process(const juce::dsp::ProcessContextReplacing<float>& cont
     int64_t samplesForDelay = static_cast<int64_t>(decayDelay * samplesPerSecond);
     if (currentSampleCount > samplesForDelay)
     {
-        // Check if we need to decay (every decayIntervalSeconds after the delay)
+        // Apply every decay step that fell inside this block at once, so long or skipped blocks decay at the same rate
         int64_t samplesPerDecay = static_cast<int64_t>(decayIntervalSeconds * samplesPerSecond);
         int64_t samplesAfterDelay = currentSampleCount - samplesForDelay;
+        int64_t decaySteps = samplesAfterDelay / samplesPerDecay;
         
-        if (samplesAfterDelay >= samplesPerDecay)
+        if (decaySteps > 0)
         {
-            float currentPeak = peakLevel.load();
-            float decayedPeak = currentPeak * decayFactor;
-            peakLevel.store(decayedPeak);
+            float decayedPeak = peakLevel.load() * std::pow(decayFactor, static_cast<float>(decaySteps));
+            peakLevel.store(decayedPeak < 1e-10f ? 0.0f : decayedPeak);
             // Reset to just after delay so we maintain proper decay timing
             currentSampleCount = samplesForDelay + (samplesAfterDelay % samplesPerDecay);
         }
@@ -62,13 +79,15 @@ void DbCalculator::process(const juce::dsp::ProcessContextReplacing<float>& cont
     samplesSincePeak.store(currentSampleCount);
 }
 
-void DbCalculator::reset()
+template <typename SampleType>
+void DbCalculator<SampleType>::reset()
 {
     resetPeak();
     samplesSincePeak.store(0);
 }
 
-float DbCalculator::getPeakDb() const
+template <typename SampleType>
+float DbCalculator<SampleType>::getPeakDb() const
 {
     float peak = peakLevel.load();
     if (peak < 1e-10f) // -200 dB
@@ -76,10 +95,15 @@ float DbCalculator::getPeakDb() const
     return 20.0f * std::log10(peak);
 }
 
-void DbCalculator::resetPeak()
+template <typename SampleType>
+void DbCalculator<SampleType>::resetPeak()
 {
     peakLevel.store(0.0f);
     samplesSincePeak.store(0);
 }
 
+//==============================================================================
+template class DbCalculator<float>;
+template class DbCalculator<double>;
+
 } // namespace rosy 
\ No newline at end of file
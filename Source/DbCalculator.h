@@ -3,14 +3,18 @@
 
 namespace rosy {
 
-class DbCalculator : public juce::dsp::ProcessorBase
+template <typename SampleType>
+class DbCalculator
 {
 public:
     DbCalculator();
     
-    void prepare(const juce::dsp::ProcessSpec& spec) override;
-    void process(const juce::dsp::ProcessContextReplacing<float>& context) override;
-    void reset() override;
+    void prepare(const juce::dsp::ProcessSpec& spec);
+    void process(const juce::dsp::ProcessContextReplacing<SampleType>& context);
+    void reset();
+    
+    // Same as processing a block of zeros, without looking at any samples
+    void processSilence(int numSamples);
     
     // Get the peak level in dBFS since last reset
     float getPeakDb() const;
@@ -19,6 +23,10 @@ public:
     void resetPeak();
     
 private:
+    // Ages the held peak by numSamples and takes blockPeak if it's higher
+    void advance(int numSamples, float blockPeak);
+    
+    // Stored as float whatever the sample type, it's only ever displayed
     std::atomic<float> peakLevel{0.0f};
     float sampleRate{44100.0f};
     
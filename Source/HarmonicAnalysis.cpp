@@ -0,0 +1,120 @@
+#include "HarmonicAnalysis.h"
+#include <cmath>
+#include <numeric>
+
+namespace rosy {
+
+std::vector<double> HarmonicAnalysis::renderAdditiveReference(const std::vector<float>& harmonicGains,
+                                                              double frequency, double sampleRate, int numSamples)
+{
+    std::vector<double> output(static_cast<size_t>(std::max(numSamples, 0)), 0.0);
+
+    // Matches the polynomial's normalisation: every T_n is 1 at x = 1, so the peak is the sum of the gains
+    double peakValue = std::accumulate(harmonicGains.begin(), harmonicGains.end(), 0.0);
+    double normFactor = std::abs(peakValue) > 1e-10 ? 1.0 / peakValue : 1.0;
+
+    const double twoPi = juce::MathConstants<double>::twoPi;
+    const double halfPi = juce::MathConstants<double>::halfPi;
+
+    for (int sample = 0; sample < numSamples; ++sample)
+    {
+        // Same phase convention as MuOscillator, which starts its sine at phase 0
+        double theta = twoPi * std::fmod(frequency * sample / sampleRate, 1.0);
+        double value = 0.0;
+
+        for (size_t n = 1; n <= harmonicGains.size(); ++n)
+        {
+            value += harmonicGains[n - 1] * std::cos(static_cast<double>(n) * (theta - halfPi));
+        }
+
+        output[static_cast<size_t>(sample)] = value * normFactor;
+    }
+
+    return output;
+}
+
+std::vector<double> HarmonicAnalysis::measureHarmonicLevels(const float* samples, int numSamples,
+                                                            double frequency, double sampleRate, int numHarmonics)
+{
+    std::vector<double> levels(static_cast<size_t>(std::max(numHarmonics, 0)), 0.0);
+    if (numSamples < 2)
+        return levels;
+
+    // 4-term Blackman-Harris keeps leakage from neighbouring harmonics well below the float noise floor
+    std::vector<double> window(static_cast<size_t>(numSamples));
+    const double twoPi = juce::MathConstants<double>::twoPi;
+    const double span = static_cast<double>(numSamples - 1);
+    for (int i = 0; i < numSamples; ++i)
+    {
+        double t = twoPi * i / span;
+        window[static_cast<size_t>(i)] = 0.35875 - 0.48829 * std::cos(t) + 0.14128 * std::cos(2.0 * t)
+                                       - 0.01168 * std::cos(3.0 * t);
+    }
+    double windowSum = std::accumulate(window.begin(), window.end(), 0.0);
+
+    for (int h = 0; h < numHarmonics; ++h)
+    {
+        double harmonicFrequency = frequency * (h + 1);
+        if (harmonicFrequency >= sampleRate * 0.5)
+            break;  // Above Nyquist the level is meaningless, leave it at 0
+
+        double omega = twoPi * harmonicFrequency / sampleRate;
+        double re = 0.0;
+        double im = 0.0;
+        for (int i = 0; i < numSamples; ++i)
+        {
+            double weighted = window[static_cast<size_t>(i)] * samples[i];
+            re += weighted * std::cos(omega * i);
+            im -= weighted * std::sin(omega * i);
+        }
+
+        levels[static_cast<size_t>(h)] = 2.0 * std::sqrt(re * re + im * im) / windowSum;
+    }
+
+    return levels;
+}
+
+double HarmonicAnalysis::measureResidualDb(const float* samples, const double* reference, int numSamples)
+{
+    double residualPower = 0.0;
+    double referencePower = 0.0;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        double error = static_cast<double>(samples[i]) - reference[i];
+        residualPower += error * error;
+        referencePower += reference[i] * reference[i];
+    }
+
+    if (referencePower <= 0.0)
+        return -200.0;
+
+    return gainToDb(std::sqrt(residualPower / referencePower));
+}
+
+std::vector<double> HarmonicAnalysis::calculateLevelErrorsDb(const std::vector<double>& measuredLevels,
+                                                             const std::vector<float>& harmonicGains)
+{
+    size_t numHarmonics = std::min(measuredLevels.size(), harmonicGains.size());
+    std::vector<double> errors(numHarmonics, 0.0);
+    if (numHarmonics == 0 || measuredLevels[0] <= 0.0 || harmonicGains[0] <= 0.0f)
+        return errors;
+
+    for (size_t h = 0; h < numHarmonics; ++h)
+    {
+        double measured = measuredLevels[h] / measuredLevels[0];
+        double target = harmonicGains[h] / static_cast<double>(harmonicGains[0]);
+        errors[h] = gainToDb(measured) - gainToDb(target);
+    }
+
+    return errors;
+}
+
+double HarmonicAnalysis::gainToDb(double gain)
+{
+    if (gain < 1e-10) // -200 dB
+        return -200.0;
+    return 20.0 * std::log10(gain);
+}
+
+} // namespace rosy
\ No newline at end of file
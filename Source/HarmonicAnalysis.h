@@ -0,0 +1,74 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+namespace rosy {
+
+/**
+ * @brief Static utility class for measuring how closely rendered output matches an ideal harmonic spectrum.
+ *
+ * MuOscillator builds its spectrum by evaluating a float polynomial on a sine, so the levels that come out
+ * drift from the requested harmonic gains as the coefficients grow. This class provides the double-precision
+ * reference and the measurements needed to put numbers on that drift:
+ * 1. An additive reference rendered directly from the harmonic gains
+ * 2. Per-harmonic level measurement by single-bin DFT at known multiples of the fundamental
+ * 3. A THD+N style residual of the rendered signal against the reference
+ *
+ * Like HarmonicProfileCalculator it is a pure static utility with no state. It allocates, so it is meant
+ * for offline analysis and accuracy checks rather than the audio thread.
+ */
+class HarmonicAnalysis
+{
+public:
+    /**
+     * @brief Renders the spectrum MuOscillator is aiming for, using additive synthesis in double precision.
+     *
+     * Shaping a sine with T_n gives cos(n * (theta - pi/2)), so each harmonic is rendered with that phase and
+     * the sum is normalised the same way calculateAllCoefficients normalises the polynomial (peak at x = 1).
+     *
+     * @param harmonicGains Gains for each harmonic, where index 0 is the fundamental
+     * @param frequency Fundamental frequency in Hz
+     * @param sampleRate Sample rate in Hz
+     * @param numSamples Number of samples to render, starting from phase 0
+     */
+    static std::vector<double> renderAdditiveReference(const std::vector<float>& harmonicGains,
+                                                       double frequency, double sampleRate, int numSamples);
+
+    /**
+     * @brief Measures the amplitude of each harmonic of a known fundamental.
+     *
+     * Uses a Blackman-Harris windowed single-bin DFT at each multiple of the fundamental, so the result is
+     * accurate without the signal containing a whole number of cycles.
+     *
+     * @return Linear amplitude of each harmonic, where index 0 is the fundamental
+     */
+    static std::vector<double> measureHarmonicLevels(const float* samples, int numSamples,
+                                                     double frequency, double sampleRate, int numHarmonics);
+
+    /**
+     * @brief Measures everything in the signal that isn't in the reference, relative to the reference.
+     *
+     * @return Residual power over reference power in dB, or -200 dB for a perfect match
+     */
+    static double measureResidualDb(const float* samples, const double* reference, int numSamples);
+
+    /**
+     * @brief Converts measured amplitudes into per-harmonic errors against the gains that produced them.
+     *
+     * Both sides are normalised to their own fundamental first, so the overall level (which MuOscillator
+     * sets by peak normalisation) doesn't count as an error.
+     *
+     * @return Error of each harmonic in dB, where index 0 is the fundamental (always 0 dB)
+     */
+    static std::vector<double> calculateLevelErrorsDb(const std::vector<double>& measuredLevels,
+                                                      const std::vector<float>& harmonicGains);
+
+private:
+    // Prevent instantiation of this utility class
+    HarmonicAnalysis() = delete;
+
+    static double gainToDb(double gain);
+};
+
+} // namespace rosy
\ No newline at end of file
@@ -0,0 +1,186 @@
+#include "HarmonicEnvelopes.h"
+#include "HarmonicProfileCalculator.h"
+#include "MuOscillator.h"
+
+namespace rosy {
+
+template <typename SampleType>
+HarmonicEnvelopes<SampleType>::HarmonicEnvelopes()
+{
+    // A plain sine until the voices' profile arrives
+    profile.gains[0] = 1.0f;
+    profile.channelGains[0] = profile.gains;
+    profile.channelGains[1] = profile.gains;
+    pendingProfile = profile;
+}
+
+template <typename SampleType>
+void HarmonicEnvelopes<SampleType>::prepare(double newSampleRate, int maxVoices, int maximumBlockSize)
+{
+    sampleRate = newSampleRate;
+
+    // A segment can hold the tick already in effect plus one every controlInterval samples after it
+    constexpr size_t interval = MuOscillator<SampleType>::controlInterval;
+    const size_t maxTicks = (static_cast<size_t>(std::max(maximumBlockSize, 1)) - 1) / interval + 2;
+    maxColumns = static_cast<size_t>(maxVoices) * maxTicks * 2;
+
+    voiceTicks.assign(static_cast<size_t>(maxVoices), {});
+    gainMatrix.assign(numHarmonics * maxColumns, 0.0f);
+    coefficientMatrix.assign(maxCoefficients * maxColumns, 0.0);
+    normalisers.assign(maxColumns, 1.0);
+    coefficientSets.assign(maxCoefficients * maxColumns, 0);
+    setSizes.assign(maxColumns, 1);
+    clearVoices();
+}
+
+template <typename SampleType>
+void HarmonicEnvelopes<SampleType>::setProfile(const std::vector<float>& gains, const std::vector<float>& leftGains,
+                                               const std::vector<float>& rightGains, bool stereo)
+{
+    auto copyGains = [](const std::vector<float>& source, std::array<float, numHarmonics>& destination)
+    {
+        destination.fill(0.0f);
+        std::copy(source.begin(), source.begin() + static_cast<std::ptrdiff_t>(std::min(source.size(), numHarmonics)), destination.begin());
+    };
+
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+    copyGains(gains, pendingProfile.gains);
+    copyGains(stereo ? leftGains : gains, pendingProfile.channelGains[0]);
+    copyGains(stereo ? rightGains : gains, pendingProfile.channelGains[1]);
+    pendingProfile.numChannels = stereo ? 2 : 1;
+    profilePending.store(true);
+}
+
+template <typename SampleType>
+void HarmonicEnvelopes<SampleType>::setHarmonicLimit(size_t limit)
+{
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+    pendingProfile.harmonicLimit = juce::jlimit<size_t>(1, numHarmonics, limit);
+    profilePending.store(true);
+}
+
+template <typename SampleType>
+void HarmonicEnvelopes<SampleType>::updateProfile()
+{
+    if (! profilePending.load())
+        return;
+
+    const juce::SpinLock::ScopedTryLockType lock(pendingLock);
+    if (! lock.isLocked())
+        return;  // Try again next segment
+
+    profile = pendingProfile;
+    profilePending.store(false);
+}
+
+template <typename SampleType>
+void HarmonicEnvelopes<SampleType>::clearVoices()
+{
+    for (auto& ticks : voiceTicks)
+        ticks = {};
+
+    numColumns = 0;
+}
+
+template <typename SampleType>
+void HarmonicEnvelopes<SampleType>::addVoice(int voiceIndex, uint64_t nextTick, size_t samplesUntilTick, size_t numSamples,
+                                             uint32_t noteKey)
+{
+    jassert(juce::isPositiveAndBelow(voiceIndex, static_cast<int>(voiceTicks.size())));
+    constexpr size_t interval = MuOscillator<SampleType>::controlInterval;
+
+    // Between ticks the voice is still on the previous tick's set, so that one is needed too
+    VoiceTicks ticks;
+    const bool midTick = samplesUntilTick != 0 && nextTick > 0;
+    ticks.firstTick = midTick ? nextTick - 1 : nextTick;
+    ticks.numTicks = (midTick ? 1 : 0) + (numSamples > samplesUntilTick ? (numSamples - samplesUntilTick - 1) / interval + 1 : 0);
+    ticks.firstColumn = numColumns;
+    ticks.noteKey = noteKey;
+
+    const size_t columns = ticks.numTicks * profile.numChannels;
+    if (numColumns + columns > maxColumns)
+    {
+        jassertfalse;  // More voices or a longer segment than prepare() was told about
+        return;
+    }
+
+    voiceTicks[static_cast<size_t>(voiceIndex)] = ticks;
+    numColumns += columns;
+}
+
+template <typename SampleType>
+void HarmonicEnvelopes<SampleType>::calculate()
+{
+    if (numColumns == 0)
+        return;
+
+    constexpr size_t interval = MuOscillator<SampleType>::controlInterval;
+    const double samplesPerDecay = static_cast<double>(decaySeconds) * sampleRate;
+    const bool jittered = analogDrift != nullptr && analogDrift->hasGainJitter();
+
+    // Fill the gain matrix one column at a time
+    for (const auto& ticks : voiceTicks)
+    {
+        for (size_t tick = 0; tick < ticks.numTicks; ++tick)
+        {
+            // Harmonic n + 1 has decayed by ratio^n relative to the fundamental, with no decay when only jittering
+            const double age = static_cast<double>((ticks.firstTick + tick) * interval);
+            const float ratio = samplesPerDecay > 0.0 ? static_cast<float>(std::exp(-age / samplesPerDecay)) : 1.0f;
+
+            std::array<float, numHarmonics> envelope;
+            float level = 1.0f;
+            for (size_t n = 0; n < numHarmonics; ++n, level *= ratio)
+                envelope[n] = level;
+
+            if (jittered)
+                analogDrift->applyGainJitter(ticks.noteKey, ticks.firstTick + tick, envelope.data());
+
+            // Trim and normalise by the whole decayed profile, so panned channels keep their share of it
+            std::array<float, numHarmonics> decayedProfile;
+            double normaliser = 0.0;
+            for (size_t n = 0; n < numHarmonics; ++n)
+            {
+                decayedProfile[n] = profile.gains[n] * envelope[n];
+                normaliser += decayedProfile[n];
+            }
+
+            const size_t numSignificant = std::min(HarmonicProfileCalculator::countSignificantHarmonics(decayedProfile.data(), numHarmonics),
+                                                   profile.harmonicLimit);
+
+            for (size_t channel = 0; channel < profile.numChannels; ++channel)
+            {
+                const size_t column = ticks.firstColumn + tick * profile.numChannels + channel;
+                for (size_t n = 0; n < numHarmonics; ++n)
+                    gainMatrix[n * numColumns + column] = n < numSignificant ? profile.channelGains[channel][n] * envelope[n] : 0.0f;
+
+                normalisers[column] = std::abs(normaliser) > 1e-10 ? normaliser : 1.0;
+                setSizes[column] = numSignificant + 1;
+            }
+        }
+    }
+
+    HarmonicProfileCalculator::calculateCoefficientMatrix(gainMatrix.data(), numHarmonics, numColumns, coefficientMatrix.data());
+
+    // Transpose into one contiguous set per column for the oscillators to pick up
+    for (size_t column = 0; column < numColumns; ++column)
+    {
+        SampleType* set = coefficientSets.data() + column * maxCoefficients;
+        const double normalisation = 1.0 / normalisers[column];
+        for (size_t power = 0; power < setSizes[column]; ++power)
+            set[power] = static_cast<SampleType>(coefficientMatrix[power * numColumns + column] * normalisation);
+    }
+}
+
+template <typename SampleType>
+EnvelopeCoefficients<SampleType> HarmonicEnvelopes<SampleType>::getCoefficients(int voiceIndex) const
+{
+    const auto& ticks = voiceTicks[static_cast<size_t>(voiceIndex)];
+    return { coefficientSets.data() + ticks.firstColumn * maxCoefficients, setSizes.data() + ticks.firstColumn,
+             ticks.firstTick, ticks.numTicks, profile.numChannels, maxCoefficients };
+}
+
+//==============================================================================
+template class HarmonicEnvelopes<float>;
+template class HarmonicEnvelopes<double>;
+
+} // namespace rosy
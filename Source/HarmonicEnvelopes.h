@@ -0,0 +1,143 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+#include "AnalogDrift.h"
+
+namespace rosy {
+
+/**
+ * @brief One voice's coefficient sets for the control ticks of a segment, worked out by HarmonicEnvelopes.
+ *
+ * Sets are looked up by the oscillator's control tick number rather than by position in the block, so they
+ * land on the same samples however the voice's output gets split up.
+ */
+template <typename SampleType>
+struct EnvelopeCoefficients
+{
+    const SampleType* coefficients { nullptr };
+    const size_t* sizes { nullptr };
+    uint64_t firstTick { 0 };
+    size_t numTicks { 0 };
+    size_t numChannels { 1 };
+    size_t stride { 0 };
+
+    bool isActive() const { return coefficients != nullptr; }
+
+    // The set for a tick and channel (0 is left, or the only channel), or nullptr if it wasn't worked out
+    const SampleType* getSet(uint64_t tick, size_t channel, size_t& size) const
+    {
+        if (tick < firstTick || tick - firstTick >= numTicks)
+            return nullptr;
+
+        const size_t index = static_cast<size_t>(tick - firstTick) * numChannels + std::min(channel, numChannels - 1);
+        size = sizes[index];
+        return coefficients + index * stride;
+    }
+};
+
+/**
+ * @brief Per-harmonic envelopes for every voice, turned into shaping coefficients in one batch.
+ *
+ * Each harmonic decays relative to the fundamental at a rate proportional to its distance from it, so the
+ * upper partials die away first like a plucked string's. Every set is normalised like a static profile, so
+ * only the timbre moves and the amp envelope still sets the level. The envelope is a pure function of the
+ * time since the note started, read off the oscillator's control tick count, so there's no per-voice state
+ * to keep in step and a voice sounds the same rendered alone as alongside others.
+ *
+ * Once per rendered segment, the upcoming control ticks of every active voice become the columns of one
+ * gain matrix, stored contiguously, and the whole batch goes through a single
+ * HarmonicProfileCalculator::calculateCoefficientMatrix() instead of a calculateAllCoefficients() per voice
+ * per tick. As the upper partials decay below audibility they're trimmed, so the polynomials get shorter
+ * as notes ring on.
+ *
+ * Given an AnalogDrift with gain jitter on, each column's harmonics are also jittered by the note's own
+ * curves before the batch goes through, so the jitter costs no extra coefficient transforms. Jitter alone
+ * makes the envelopes active, with the spectrum otherwise static.
+ */
+template <typename SampleType>
+class HarmonicEnvelopes
+{
+public:
+    static constexpr size_t numHarmonics { 16 };
+    static constexpr size_t maxCoefficients { numHarmonics + 1 };
+    static_assert(AnalogDrift::numHarmonics == numHarmonics, "The jitter covers every harmonic");
+
+    HarmonicEnvelopes();
+
+    // Sizes the batch for this many voices rendering up to maximumBlockSize samples at a time
+    void prepare(double newSampleRate, int maxVoices, int maximumBlockSize);
+
+    // Time for the second harmonic to fall by 1/e relative to the fundamental, 0 for a static spectrum
+    void setDecay(float seconds) { decaySeconds = std::max(0.0f, seconds); }
+    bool isActive() const { return decaySeconds > 0.0f || (analogDrift != nullptr && analogDrift->hasGainJitter()); }
+
+    // Jitters the harmonics with this drift's curves until it's set to nullptr, it has to outlive its use here
+    void setAnalogDrift(const AnalogDrift* driftToFollow) { analogDrift = driftToFollow; }
+
+    //==============================================================================
+    // Message thread, both are picked up by the audio thread's next updateProfile()
+    // Most harmonics any set is worked out with, see MuOscillator::setHarmonicLimit()
+    void setHarmonicLimit(size_t limit);
+
+    // The voices' harmonic gains, plus the left and right gains when the harmonic groups are panned
+    void setProfile(const std::vector<float>& gains, const std::vector<float>& leftGains,
+                    const std::vector<float>& rightGains, bool stereo);
+
+    //==============================================================================
+    // Audio thread, once per segment: take over any new profile, add the voices about to render, calculate,
+    // then give each its sets. noteKey picks the note's jitter curves, see MuVoice::getNoteKey().
+    void updateProfile();
+    void clearVoices();
+    void addVoice(int voiceIndex, uint64_t nextTick, size_t samplesUntilTick, size_t numSamples, uint32_t noteKey = 0);
+    void calculate();
+
+    EnvelopeCoefficients<SampleType> getCoefficients(int voiceIndex) const;
+
+private:
+    struct VoiceTicks
+    {
+        uint64_t firstTick { 0 };
+        size_t numTicks { 0 };
+        size_t firstColumn { 0 };
+        uint32_t noteKey { 0 };
+    };
+
+    double sampleRate { 44100.0 };
+    float decaySeconds { 0.0f };
+    const AnalogDrift* analogDrift { nullptr };
+
+    struct Profile
+    {
+        std::array<float, numHarmonics> gains {};
+        std::array<std::array<float, numHarmonics>, 2> channelGains {};
+        size_t numChannels { 1 };
+        size_t harmonicLimit { numHarmonics };
+    };
+
+    // What the batch is worked out with, and what the message thread last set. The pending one is handed
+    // over under a SpinLock the audio thread only ever tries, so a mono/stereo flip never lands mid-batch.
+    Profile profile;
+    Profile pendingProfile;
+    std::atomic<bool> profilePending { false };
+    juce::SpinLock pendingLock;
+
+    std::vector<VoiceTicks> voiceTicks;
+    size_t numColumns { 0 };
+    size_t maxColumns { 0 };
+
+    // One column per voice, tick and channel: harmonics by columns in, powers by columns out
+    std::vector<float> gainMatrix;
+    std::vector<double> coefficientMatrix;
+    std::vector<double> normalisers;
+
+    // The columns transposed and normalised, one set of maxCoefficients per column
+    std::vector<SampleType> coefficientSets;
+    std::vector<size_t> setSizes;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HarmonicEnvelopes)
+};
+
+} // namespace rosy
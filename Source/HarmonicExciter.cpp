@@ -0,0 +1,141 @@
+#include "HarmonicExciter.h"
+
+namespace rosy {
+
+template <typename SampleType>
+HarmonicExciter<SampleType>::HarmonicExciter()
+{
+    // Sized for the longest shape up front, so taking new coefficients never allocates on the audio thread
+    const std::vector<SampleType> longestShape(maxCoefficients, 0);
+    evaluator.setCoefficients(longestShape);
+    evaluator.setCoefficients(nullptr, 0);
+}
+
+template <typename SampleType>
+void HarmonicExciter<SampleType>::prepare(const juce::dsp::ProcessSpec& spec, ScratchArena& arena)
+{
+    numChannels = std::min(static_cast<size_t>(spec.numChannels), maxChannels);
+    maximumBlockSize = spec.maximumBlockSize;
+
+    // Padded at the front like the oscillator's anti-aliasing input, so the block itself starts on a cache line
+    constexpr size_t padding = ScratchArena::alignment / sizeof(SampleType);
+    static_assert(history <= padding, "The history has to fit in the padding");
+    for (size_t channel = 0; channel < numChannels; ++channel)
+        channels[channel].input = arena.allocate<SampleType>(padding + maximumBlockSize) + padding;
+
+    // Every channel is shaped into the same buffer in turn
+    wet = arena.allocate<SampleType>(maximumBlockSize);
+
+    // One pole high pass, y[n] = x[n] - x[n - 1] + R y[n - 1]
+    dcCoefficient = static_cast<SampleType>(1.0 - juce::MathConstants<double>::twoPi * dcBlockerFrequency / spec.sampleRate);
+    reset();
+}
+
+template <typename SampleType>
+void HarmonicExciter<SampleType>::reset()
+{
+    for (size_t channel = 0; channel < numChannels; ++channel)
+    {
+        auto& state = channels[channel];
+        std::fill(state.input - history, state.input + maximumBlockSize, SampleType(0));
+        state.lastDry = state.dcInput = state.dcOutput = 0;
+    }
+}
+
+template <typename SampleType>
+void HarmonicExciter<SampleType>::setHarmonicGains(const std::vector<float>& harmonicGains)
+{
+    const size_t numSignificant = HarmonicProfileCalculator::countSignificantHarmonics(harmonicGains);
+    const std::vector<float> significantGains(harmonicGains.begin(), harmonicGains.begin() + static_cast<std::ptrdiff_t>(numSignificant));
+    auto coefficients = HarmonicProfileCalculator::calculateAllCoefficients<SampleType>(significantGains, harmonicGains);
+
+    // The even harmonics' constant terms would turn silence into an offset
+    if (! coefficients.empty())
+        coefficients[0] = 0;
+
+    jassert(coefficients.size() <= maxCoefficients);
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+    numPendingCoefficients = std::min(coefficients.size(), maxCoefficients);
+    std::copy(coefficients.begin(), coefficients.begin() + static_cast<std::ptrdiff_t>(numPendingCoefficients),
+              pendingCoefficients.begin());
+    coefficientsPending.store(true);
+}
+
+template <typename SampleType>
+void HarmonicExciter<SampleType>::updateCoefficients()
+{
+    if (! coefficientsPending.load())
+        return;
+
+    const juce::SpinLock::ScopedTryLockType lock(pendingLock);
+    if (! lock.isLocked())
+        return;  // Try again next block
+
+    evaluator.setCoefficients(pendingCoefficients.data(), numPendingCoefficients);
+    coefficientsPending.store(false);
+}
+
+template <typename SampleType>
+void HarmonicExciter<SampleType>::process(const juce::dsp::AudioBlock<SampleType>& block)
+{
+    const size_t numSamples = block.getNumSamples();
+    jassert(numSamples <= maximumBlockSize);
+    updateCoefficients();
+    if (numSamples == 0)
+        return;
+
+    // Read once, so a parameter change lands on a block boundary
+    const Antialiasing blockAntialiasing = antialiasing.load();
+    const SampleType blockDrive = drive.load();
+    const SampleType blockMix = mix.load();
+
+    const int order = static_cast<int>(blockAntialiasing);
+    const bool delayDry = blockAntialiasing == Antialiasing::secondOrder;
+    const SampleType wetGain = blockMix / blockDrive;
+    const SampleType dryGain = 1 - blockMix;
+
+    for (size_t channel = 0; channel < std::min(numChannels, block.getNumChannels()); ++channel)
+    {
+        auto& state = channels[channel];
+        SampleType* samples = block.getChannelPointer(channel);
+
+        // Gain staging into the polynomial's range
+        for (size_t i = 0; i < numSamples; ++i)
+            state.input[i] = juce::jlimit(SampleType(-1), SampleType(1), samples[i] * blockDrive);
+
+        if (order > 0)
+        {
+            evaluator.processAntiderivative(order, state.input, wet, numSamples);
+        }
+        else
+        {
+            std::copy(state.input, state.input + numSamples, wet);
+            evaluator.process(wet, numSamples);
+        }
+
+        // The anti-aliasing reads the last two staged samples as the next block's history
+        std::copy(state.input + numSamples - history, state.input + numSamples, state.input - history);
+
+        // DC blocker on the wet signal, then the mix, with the dry signal lined up with the wet one
+        SampleType previousDry = state.lastDry;
+        for (size_t i = 0; i < numSamples; ++i)
+        {
+            const SampleType input = samples[i];
+            const SampleType dry = delayDry ? previousDry : input;
+            previousDry = input;
+
+            const SampleType blocked = wet[i] - state.dcInput + dcCoefficient * state.dcOutput;
+            state.dcInput = wet[i];
+            state.dcOutput = blocked;
+
+            samples[i] = wetGain * blocked + dryGain * dry;
+        }
+
+        state.lastDry = previousDry;
+    }
+}
+
+template class HarmonicExciter<float>;
+template class HarmonicExciter<double>;
+
+} // namespace rosy
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include "MuOscillator.h"
+#include "ScratchArena.h"
+
+namespace rosy {
+
+/**
+ * @brief The effect mode: shapes incoming audio with the same harmonic profile polynomial the oscillators use.
+ *
+ * A sine at full scale through the polynomial comes out with exactly the shape's harmonics; quieter or more
+ * complex signals pick up a level dependent mix of them, which makes it a harmonic exciter. Each channel is
+ * staged into [-1, 1] by the drive gain and a hard clip, since the Chebyshev sums grow quickly outside it, then
+ * shaped with the oscillator's PolyEvaluator, so it gets the same SIMD kernels and antiderivative anti-aliasing.
+ * The kernel is picked once per coefficient set and every channel goes through the same one in a plain loop,
+ * so wide layouts cost one indirect call per channel per block and nothing per sample.
+ *
+ * The polynomial's constant term is dropped so silence stays silent, and a DC blocker takes out the offset
+ * the even harmonics leave on real signals. The wet signal is scaled back down by the drive so the drive
+ * changes the colour rather than the level.
+ *
+ * Second order anti-aliasing delays the wet signal by one sample, which getLatencySamples() reports and the
+ * dry signal is delayed to match. First order delays it by half a sample, which is left unreported.
+ */
+template <typename SampleType>
+class HarmonicExciter
+{
+public:
+    using Antialiasing = typename MuOscillator<SampleType>::Antialiasing;
+
+    // Enough for 7.1.4
+    static constexpr size_t maxChannels { 12 };
+
+    HarmonicExciter();
+
+    //==============================================================================
+    // The staging buffers come from the arena, sized for spec.maximumBlockSize samples per process() call
+    void prepare(const juce::dsp::ProcessSpec& spec, ScratchArena& arena);
+    void reset();
+
+    //==============================================================================
+    // Message thread, or wherever the parameters change. Shapes with the first harmonic gains, normalised
+    // the same way as the oscillators' mono polynomial. The coefficients are handed over to the audio thread
+    // at the start of the next process() call, like the oscillators' shapes.
+    void setHarmonicGains(const std::vector<float>& harmonicGains);
+
+    // Any thread, read once per process() call
+    void setDrive(float decibels) { drive.store(static_cast<SampleType>(juce::Decibels::decibelsToGain(decibels))); }
+    void setMix(float newMix) { mix.store(static_cast<SampleType>(juce::jlimit(0.0f, 1.0f, newMix))); }
+    void setAntialiasing(Antialiasing newAntialiasing) { antialiasing.store(newAntialiasing); }
+
+    int getLatencySamples() const { return antialiasing.load() == Antialiasing::secondOrder ? 1 : 0; }
+
+    //==============================================================================
+    // Shapes the block in place, channels past maxChannels are passed through
+    void process(const juce::dsp::AudioBlock<SampleType>& block);
+
+private:
+    static constexpr size_t history { 2 };
+    static constexpr size_t maxCoefficients { static_cast<size_t>(MuOscillator<SampleType>::numHarmonics) + 1 };
+    static constexpr double dcBlockerFrequency { 10.0 };
+
+    struct Channel
+    {
+        // Staged input, with the last history samples of the previous block just before it
+        SampleType* input { nullptr };
+        SampleType lastDry { 0 };
+        SampleType dcInput { 0 };
+        SampleType dcOutput { 0 };
+    };
+
+    // Takes the pending coefficients if setHarmonicGains() has published any and the lock is free
+    void updateCoefficients();
+
+    typename MuOscillator<SampleType>::PolyEvaluator evaluator;
+    std::array<SampleType, maxCoefficients> pendingCoefficients {};
+    size_t numPendingCoefficients { 0 };
+    std::atomic<bool> coefficientsPending { false };
+    juce::SpinLock pendingLock;
+
+    std::array<Channel, maxChannels> channels;
+    SampleType* wet { nullptr };
+    size_t numChannels { 0 };
+    size_t maximumBlockSize { 0 };
+    SampleType dcCoefficient { 0 };
+
+    std::atomic<SampleType> drive { 1 };
+    std::atomic<SampleType> mix { 1 };
+    std::atomic<Antialiasing> antialiasing { Antialiasing::off };
+};
+
+} // namespace rosy
@@ -0,0 +1,139 @@
+#include "HarmonicMeter.h"
+
+namespace rosy {
+
+template <typename SampleType>
+HarmonicMeter<SampleType>::HarmonicMeter()
+{
+    for (auto& level : levels)
+        level.store(0.0f);
+}
+
+template <typename SampleType>
+void HarmonicMeter<SampleType>::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    setFrequency(0.0);
+}
+
+template <typename SampleType>
+void HarmonicMeter<SampleType>::setFrequency(double frequency)
+{
+    coefficients.fill(0.0);
+    numActiveHarmonics = 0;
+    measurementLength = 0;
+
+    if (frequency > 0.0)
+    {
+        // Whole periods, so every harmonic completes a whole number of cycles in the measurement
+        const double periods = std::ceil(minimumSeconds * frequency);
+        measurementLength = static_cast<size_t>(std::max(1.0, std::round(periods * sampleRate / frequency)));
+
+        const double twoPi = juce::MathConstants<double>::twoPi;
+        for (size_t h = 0; h < numHarmonics && frequency * static_cast<double>(h + 1) < sampleRate * 0.5; ++h)
+        {
+            coefficients[h] = 2.0 * std::cos(twoPi * frequency * static_cast<double>(h + 1) / sampleRate);
+            numActiveHarmonics = h + 1;
+        }
+    }
+
+    for (auto& level : levels)
+        level.store(0.0f, std::memory_order_relaxed);
+
+    measured.store(false, std::memory_order_relaxed);
+    restart();
+}
+
+template <typename SampleType>
+void HarmonicMeter<SampleType>::restart()
+{
+    previous.fill(0.0);
+    beforePrevious.fill(0.0);
+    samplesMeasured = 0;
+}
+
+template <typename SampleType>
+void HarmonicMeter<SampleType>::process(const SampleType* samples, size_t numSamples)
+{
+    if (measurementLength == 0)
+        return;
+
+    size_t position = 0;
+    while (position < numSamples)
+    {
+        const size_t length = std::min(numSamples - position, measurementLength - samplesMeasured);
+        const SampleType* input = samples + position;
+
+       #if JUCE_USE_SIMD
+        // The whole bank lives in registers for the length of the run
+        using Vec = juce::dsp::SIMDRegister<double>;
+        constexpr size_t width = Vec::SIMDNumElements;
+        constexpr size_t numRegisters = numHarmonics / width;
+        static_assert(numHarmonics % width == 0, "The bank must be a whole number of registers");
+
+        Vec coefficient[numRegisters], state[numRegisters], lastState[numRegisters];
+        for (size_t r = 0; r < numRegisters; ++r)
+        {
+            coefficient[r] = Vec::fromRawArray(coefficients.data() + r * width);
+            state[r] = Vec::fromRawArray(previous.data() + r * width);
+            lastState[r] = Vec::fromRawArray(beforePrevious.data() + r * width);
+        }
+
+        for (size_t sample = 0; sample < length; ++sample)
+        {
+            const Vec x = Vec::expand(static_cast<double>(input[sample]));
+            for (size_t r = 0; r < numRegisters; ++r)
+            {
+                const Vec next = Vec::multiplyAdd(x - lastState[r], coefficient[r], state[r]);
+                lastState[r] = state[r];
+                state[r] = next;
+            }
+        }
+
+        for (size_t r = 0; r < numRegisters; ++r)
+        {
+            state[r].copyToRawArray(previous.data() + r * width);
+            lastState[r].copyToRawArray(beforePrevious.data() + r * width);
+        }
+       #else
+        for (size_t sample = 0; sample < length; ++sample)
+        {
+            const double x = static_cast<double>(input[sample]);
+            for (size_t h = 0; h < numHarmonics; ++h)
+            {
+                const double next = x + coefficients[h] * previous[h] - beforePrevious[h];
+                beforePrevious[h] = previous[h];
+                previous[h] = next;
+            }
+        }
+       #endif
+
+        position += length;
+        samplesMeasured += length;
+        if (samplesMeasured == measurementLength)
+            finishMeasurement();
+    }
+}
+
+template <typename SampleType>
+void HarmonicMeter<SampleType>::finishMeasurement()
+{
+    // |X|^2 = s1^2 + s2^2 - 2 cos(omega) s1 s2, and a sine of amplitude A gives |X| = A N / 2
+    const double scale = 2.0 / static_cast<double>(measurementLength);
+    for (size_t h = 0; h < numHarmonics; ++h)
+    {
+        const double power = previous[h] * previous[h] + beforePrevious[h] * beforePrevious[h]
+                           - coefficients[h] * previous[h] * beforePrevious[h];
+        const float level = h < numActiveHarmonics ? static_cast<float>(scale * std::sqrt(std::max(power, 0.0))) : 0.0f;
+        levels[h].store(level, std::memory_order_relaxed);
+    }
+
+    measured.store(true, std::memory_order_relaxed);
+    restart();
+}
+
+//==============================================================================
+template class HarmonicMeter<float>;
+template class HarmonicMeter<double>;
+
+} // namespace rosy
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+namespace rosy {
+
+/**
+ * @brief Measures the level of each harmonic of a known fundamental with a bank of Goertzel filters.
+ *
+ * The partials only ever sit at whole multiples of the oscillator's frequency, so one Goertzel filter per
+ * harmonic gives their levels without an FFT. All the filters step through the input together, a SIMD
+ * register of harmonics at a time, which costs a couple of multiply-adds per harmonic per sample and is
+ * cheap enough to leave running on the audio thread.
+ *
+ * Each measurement covers a whole number of the fundamental's periods, so the harmonics fall exactly on
+ * their filters and don't leak into each other without needing a window. The filters run in double
+ * precision whatever the sample type, since their state grows with the length of the measurement.
+ *
+ * Only the audio thread calls process(); the levels of the last finished measurement can be read from any
+ * thread.
+ */
+template <typename SampleType>
+class HarmonicMeter
+{
+public:
+    static constexpr size_t numHarmonics { 16 };
+
+    // A measurement lasts at least this long, rounded up to whole periods of the fundamental
+    static constexpr double minimumSeconds { 0.05 };
+
+    HarmonicMeter();
+
+    //==============================================================================
+    // Audio thread
+    void prepare(double sampleRate);
+
+    // Retunes the filters and starts a new measurement, levels above Nyquist read 0
+    void setFrequency(double frequency);
+
+    // Drops the measurement in progress, e.g. when the input skipped some samples
+    void restart();
+
+    void process(const SampleType* samples, size_t numSamples);
+
+    //==============================================================================
+    // Any thread
+    // Linear amplitude of each harmonic in the last finished measurement, index 0 is the fundamental
+    float getLevel(size_t harmonic) const { return levels[harmonic].load(std::memory_order_relaxed); }
+
+    // False until a measurement has finished since the last setFrequency()
+    bool hasMeasurement() const { return measured.load(std::memory_order_relaxed); }
+
+private:
+    void finishMeasurement();
+
+    double sampleRate { 44100.0 };
+    size_t measurementLength { 0 };
+    size_t samplesMeasured { 0 };
+    size_t numActiveHarmonics { 0 };
+
+    // 2 cos(omega) per harmonic, and the two previous filter outputs
+    alignas(32) std::array<double, numHarmonics> coefficients {};
+    alignas(32) std::array<double, numHarmonics> previous {};
+    alignas(32) std::array<double, numHarmonics> beforePrevious {};
+
+    std::array<std::atomic<float>, numHarmonics> levels {};
+    std::atomic<bool> measured { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(HarmonicMeter)
+};
+
+} // namespace rosy
@@ -21,11 +21,19 @@ HarmonicProfileCalculator::LookupTables::LookupTables()
     binomialCoeffs.reserve((maxN * (maxN + 1)) / 2);
     for (int n = 0; n < maxN; ++n)
     {
-        for (int k = 0; k <= n/2; ++k)
+        // Store whole rows so getBinomial can index them as n(n+1)/2 + k
+        for (int k = 0; k <= n; ++k)
         {
             binomialCoeffs.push_back(calculateBinomial(n, k));
         }
     }
+    
+    // Built from the binomials above, passing this table in since getInstance() isn't ready until we return
+    chebyshevMatrix.resize(maxChebyshevOrder * maxChebyshevOrder);
+    for (int n = 0; n < maxChebyshevOrder; ++n)
+        for (int i = 0; i < maxChebyshevOrder; ++i)
+            chebyshevMatrix[static_cast<size_t>(n * maxChebyshevOrder + i)] = n == 0 ? (i == 0 ? 1.0 : 0.0)
+                                                                                     : chebyshevCoefficient(n, i, *this);
 }
 
 int64_t HarmonicProfileCalculator::LookupTables::calculateBinomial(int n, int k)
@@ -57,29 +65,39 @@ int64_t HarmonicProfileCalculator::LookupTables::getBinomial(int n, int k) const
 // HarmonicProfileCalculator Implementation
 //==============================================================================
 
-float HarmonicProfileCalculator::chebyshevCoefficient(int n, int i)
+double HarmonicProfileCalculator::chebyshevCoefficient(int n, int i)
+{
+    return chebyshevCoefficient(n, i, LookupTables::getInstance());
+}
+
+double HarmonicProfileCalculator::chebyshevCoefficient(int n, int i, const LookupTables& lookupTables)
 {
     // Early exit if i > n or parity doesn't match
-    if (i > n || ((n - i) % 2 != 0)) return 0.0f;
+    if (i > n || ((n - i) % 2 != 0)) return 0.0;
     
-    float coeff = 0.0f;
-    int maxJ = (n - i) / 2;
-    const auto& lookupTables = LookupTables::getInstance();
+    // Only one term of T_n(x) = (n/2) * sum_j (-1)^j * (n-j-1)! / (j! (n-2j)!) * (2x)^(n-2j) has power i,
+    // and n/(n-j) * C(n-j, j) is the same factorial ratio written with a cached binomial
+    const int j = (n - i) / 2;
     
-    for (int j = 0; j <= maxJ; ++j)
-    {
-        float term = std::powf(-1.0f, static_cast<float>(j)) * 
-                    lookupTables.getBinomial(n - j - 1, j) * 
-                    std::powf(2.0f, static_cast<float>(n - 2 * j - i));
-        coeff += term;
-    }
+    return std::pow(-1.0, static_cast<double>(j)) *
+           std::pow(2.0, static_cast<double>(n - 2 * j - 1)) *
+           static_cast<double>(n) / static_cast<double>(n - j) *
+           static_cast<double>(lookupTables.getBinomial(n - j, j));
+}
+
+double HarmonicProfileCalculator::chebyshevSecondKindCoefficient(int n, int i, const LookupTables& lookupTables)
+{
+    if (i > n || ((n - i) % 2 != 0)) return 0.0;
     
-    return static_cast<float>(n) * coeff;
+    const int j = (n - i) / 2;
+    return std::pow(-1.0, static_cast<double>(j)) *
+           std::pow(2.0, static_cast<double>(i)) *
+           static_cast<double>(lookupTables.getBinomial(n - j, j));
 }
 
-float HarmonicProfileCalculator::calculateCoefficient(int i, const std::vector<float>& harmonicGains)
+double HarmonicProfileCalculator::calculateCoefficient(int i, const std::vector<float>& harmonicGains)
 {
-    float coeff = 0.0f;
+    double coeff = 0.0;
     for (size_t n = 1; n <= harmonicGains.size(); ++n)
     {
         coeff += harmonicGains[n-1] * chebyshevCoefficient(static_cast<int>(n), i);
@@ -87,10 +105,62 @@ float HarmonicProfileCalculator::calculateCoefficient(int i, const std::vector<f
     return coeff;
 }
 
-std::vector<float> HarmonicProfileCalculator::calculateAllCoefficients(const std::vector<float>& harmonicGains)
+size_t HarmonicProfileCalculator::countSignificantHarmonics(const std::vector<float>& harmonicGains, float thresholdDb)
+{
+    return countSignificantHarmonics(harmonicGains.data(), harmonicGains.size(), thresholdDb);
+}
+
+size_t HarmonicProfileCalculator::countSignificantHarmonics(const float* harmonicGains, size_t numHarmonics, float thresholdDb)
+{
+    double totalGain = 0.0;
+    for (size_t n = 0; n < numHarmonics; ++n)
+        totalGain += std::abs(harmonicGains[n]);
+    
+    const double threshold = totalGain * std::pow(10.0, thresholdDb / 20.0);
+    
+    size_t count = numHarmonics;
+    while (count > 0 && std::abs(harmonicGains[count - 1]) <= threshold)
+        --count;
+    
+    return count;
+}
+
+void HarmonicProfileCalculator::calculateCoefficientMatrix(const float* harmonicGains, size_t numHarmonics, size_t numProfiles,
+                                                           double* coefficients)
+{
+    jassert(numHarmonics < LookupTables::maxChebyshevOrder);
+    const auto& lookupTables = LookupTables::getInstance();
+    
+    for (size_t i = 0; i <= numHarmonics; ++i)
+    {
+        double* row = coefficients + i * numProfiles;
+        std::fill(row, row + numProfiles, 0.0);
+        
+        // x^i only appears in T_n for n >= i with the same parity, so half the matrix is skipped outright
+        // (there's no T_0 harmonic, so the constant term starts from T_2). The innermost loop runs along a
+        // row of profiles, contiguous on both sides, so it vectorises.
+        for (size_t n = (i == 0 ? 2 : i); n <= numHarmonics; n += 2)
+        {
+            const double weight = lookupTables.getChebyshev(static_cast<int>(n), static_cast<int>(i));
+            const float* gains = harmonicGains + (n - 1) * numProfiles;
+            for (size_t profile = 0; profile < numProfiles; ++profile)
+                row[profile] += weight * static_cast<double>(gains[profile]);
+        }
+    }
+}
+
+template <typename SampleType>
+std::vector<SampleType> HarmonicProfileCalculator::calculateAllCoefficients(const std::vector<float>& harmonicGains)
+{
+    return calculateAllCoefficients<SampleType>(harmonicGains, harmonicGains);
+}
+
+template <typename SampleType>
+std::vector<SampleType> HarmonicProfileCalculator::calculateAllCoefficients(const std::vector<float>& harmonicGains,
+                                                                            const std::vector<float>& normalisationGains)
 {
     // Size needs to be highest harmonic + 1 to include all powers
-    std::vector<float> coeffs(harmonicGains.size() + 1, 0.0f);
+    std::vector<double> coeffs(harmonicGains.size() + 1, 0.0);
     
     for (size_t i = 0; i <= harmonicGains.size(); ++i)
     {
@@ -98,20 +168,64 @@ std::vector<float> HarmonicProfileCalculator::calculateAllCoefficients(const std
     }
     
     // Calculate the peak value by evaluating at x = 1
-    // (which simplifies to just summing the coefficients)
-    float peakValue = std::accumulate(coeffs.begin(), coeffs.end(), 0.0f);
+    // (T_n(1) = 1 for every n, so this simplifies to just summing the gains)
+    double peakValue = std::accumulate(normalisationGains.begin(), normalisationGains.end(), 0.0);
     
     // Normalize coefficients to make peak value = 1
-    if (std::abs(peakValue) > 1e-10f)  // Avoid division by zero
+    if (std::abs(peakValue) > 1e-10)  // Avoid division by zero
     {
-        float normFactor = 1.0f / peakValue;
-        for (float& coeff : coeffs)
+        double normFactor = 1.0 / peakValue;
+        for (double& coeff : coeffs)
         {
             coeff *= normFactor;
         }
     }
     
-    return coeffs;
+    return std::vector<SampleType>(coeffs.begin(), coeffs.end());
 }
 
+template <typename SampleType>
+void HarmonicProfileCalculator::calculateQuadratureCoefficients(const std::vector<float>& harmonicGains,
+                                                                const std::vector<float>& harmonicPhases,
+                                                                const std::vector<float>& normalisationGains,
+                                                                std::vector<SampleType>& inPhaseCoefficients,
+                                                                std::vector<SampleType>& quadratureCoefficients)
+{
+    const auto& lookupTables = LookupTables::getInstance();
+    const size_t numHarmonics = harmonicGains.size();
+    std::vector<float> inPhaseGains(numHarmonics);
+    std::vector<double> quadrature(numHarmonics + 1, 0.0);
+    
+    for (size_t n = 1; n <= numHarmonics; ++n)
+    {
+        const double phase = n <= harmonicPhases.size() ? static_cast<double>(harmonicPhases[n - 1]) : 0.0;
+        inPhaseGains[n - 1] = static_cast<float>(harmonicGains[n - 1] * std::cos(phase));
+        
+        // sin φ_n sin(nψ) = sin φ_n y U_{n-1}(x), and U_{n-1} only reaches x^(n-1)
+        const double quadratureGain = harmonicGains[n - 1] * std::sin(phase);
+        for (size_t i = 0; i < n; ++i)
+            quadrature[i] += quadratureGain * chebyshevSecondKindCoefficient(static_cast<int>(n - 1), static_cast<int>(i), lookupTables);
+    }
+    
+    inPhaseCoefficients = calculateAllCoefficients<SampleType>(inPhaseGains, normalisationGains);
+    
+    // The same normalisation as the in-phase part
+    const double peakValue = std::accumulate(normalisationGains.begin(), normalisationGains.end(), 0.0);
+    const double normFactor = std::abs(peakValue) > 1e-10 ? 1.0 / peakValue : 1.0;
+    quadratureCoefficients.resize(numHarmonics + 1);
+    for (size_t i = 0; i <= numHarmonics; ++i)
+        quadratureCoefficients[i] = static_cast<SampleType>(quadrature[i] * normFactor);
+}
+
+template std::vector<float> HarmonicProfileCalculator::calculateAllCoefficients<float>(const std::vector<float>&);
+template std::vector<double> HarmonicProfileCalculator::calculateAllCoefficients<double>(const std::vector<float>&);
+template std::vector<float> HarmonicProfileCalculator::calculateAllCoefficients<float>(const std::vector<float>&, const std::vector<float>&);
+template std::vector<double> HarmonicProfileCalculator::calculateAllCoefficients<double>(const std::vector<float>&, const std::vector<float>&);
+template void HarmonicProfileCalculator::calculateQuadratureCoefficients<float>(const std::vector<float>&, const std::vector<float>&,
+                                                                                const std::vector<float>&, std::vector<float>&,
+                                                                                std::vector<float>&);
+template void HarmonicProfileCalculator::calculateQuadratureCoefficients<double>(const std::vector<float>&, const std::vector<float>&,
+                                                                                 const std::vector<float>&, std::vector<double>&,
+                                                                                 std::vector<double>&);
+
 } // namespace rosy 
\ No newline at end of file
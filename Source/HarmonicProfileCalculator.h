@@ -28,10 +28,57 @@ public:
     /** 
      * @brief Calculates all polynomial coefficients for the given harmonic gains.
      * 
+     * The calculation and normalisation are done in double precision and only converted to SampleType at
+     * the end. The high-order coefficients are large and alternate in sign, so float intermediates would
+     * lose precision to cancellation.
+     * 
      * @param harmonicGains Vector of gains for each harmonic, where index 0 is the fundamental
      * @return Vector of polynomial coefficients, where index is the power of x
      */
-    static std::vector<float> calculateAllCoefficients(const std::vector<float>& harmonicGains);
+    template <typename SampleType>
+    static std::vector<SampleType> calculateAllCoefficients(const std::vector<float>& harmonicGains);
+    
+    /**
+     * @brief Calculates the coefficients for harmonicGains, scaled by the normalisation of another profile.
+     * 
+     * Used to split one profile across several outputs (e.g. stereo) so that each part keeps exactly the level
+     * it has in the whole, instead of every part being normalised to a peak of 1 on its own.
+     * 
+     * @param harmonicGains Gains to calculate the coefficients for
+     * @param normalisationGains The profile whose peak sets the normalisation
+     */
+    template <typename SampleType>
+    static std::vector<SampleType> calculateAllCoefficients(const std::vector<float>& harmonicGains,
+                                                            const std::vector<float>& normalisationGains);
+    
+    /**
+     * @brief Counts the harmonics up to the last one that is audible relative to the whole profile.
+     * 
+     * Trailing harmonics quieter than thresholdDb below the sum of the gains (the level the coefficients get
+     * normalised to) can be dropped, and each one dropped takes a power of x out of the shaping polynomial.
+     * 
+     * @param harmonicGains Vector of gains for each harmonic, where index 0 is the fundamental
+     * @param thresholdDb Level below which a trailing harmonic counts as negligible
+     * @return The number of leading harmonics to keep
+     */
+    static size_t countSignificantHarmonics(const std::vector<float>& harmonicGains, float thresholdDb = -120.0f);
+    static size_t countSignificantHarmonics(const float* harmonicGains, size_t numHarmonics, float thresholdDb = -120.0f);
+    
+    /**
+     * @brief Calculates the unnormalised coefficients for many harmonic profiles at once.
+     * 
+     * The gains to coefficients transform is linear, so a batch of profiles is one matrix product with a
+     * cached Chebyshev matrix instead of a calculateAllCoefficients() call per profile. The profiles are
+     * stored side by side so every step of the product runs across all of them. Nothing is allocated and
+     * the product is accumulated in double, so it's safe and accurate on the audio thread.
+     * 
+     * Each profile's coefficients still need dividing by the sum of its normalisation gains.
+     * 
+     * @param harmonicGains numHarmonics rows of numProfiles gains, harmonic n of profile p at [n * numProfiles + p]
+     * @param coefficients numHarmonics + 1 rows of numProfiles coefficients, laid out the same way
+     */
+    static void calculateCoefficientMatrix(const float* harmonicGains, size_t numHarmonics, size_t numProfiles,
+                                           double* coefficients);
     
     /**
      * @brief Calculates a single polynomial coefficient given all harmonic gains.
@@ -40,7 +87,30 @@ public:
      * @param harmonicGains Vector of gains for each harmonic
      * @return The coefficient for x^i in the polynomial
      */
-    static float calculateCoefficient(int i, const std::vector<float>& harmonicGains);
+    static double calculateCoefficient(int i, const std::vector<float>& harmonicGains);
+    
+    /**
+     * @brief Calculates a pair of polynomials that give each harmonic its own phase.
+     * 
+     * Shaping a sine x = cos ψ only ever produces harmonics in cosine phase with each other, T_n(cos ψ) =
+     * cos(nψ), which is what makes the waveforms so peaky. Adding a second polynomial in U_{n-1}, multiplied
+     * by the quadrature sine y = sin ψ, gives y U_{n-1}(x) = sin(nψ), so
+     * 
+     *     P(x) + y Q(x) = sum_n g_n cos(nψ - φ_n)
+     * 
+     * with P built from g_n cos φ_n and T_n, and Q from g_n sin φ_n and U_{n-1}. Both are normalised by the
+     * sum of normalisationGains like calculateAllCoefficients(), so each harmonic keeps the level it has there
+     * and phases that lower the peak leave headroom instead of making the shape louder.
+     * 
+     * @param harmonicPhases Phase φ_n of each harmonic in radians, missing ones are 0 (cosine phase)
+     * @param inPhaseCoefficients Receives the coefficients of P, harmonicGains.size() + 1 of them
+     * @param quadratureCoefficients Receives the coefficients of Q, padded with a 0 to the same length as P
+     */
+    template <typename SampleType>
+    static void calculateQuadratureCoefficients(const std::vector<float>& harmonicGains, const std::vector<float>& harmonicPhases,
+                                                const std::vector<float>& normalisationGains,
+                                                std::vector<SampleType>& inPhaseCoefficients,
+                                                std::vector<SampleType>& quadratureCoefficients);
 
 private:
     // Prevent instantiation of this utility class
@@ -62,10 +132,15 @@ private:
         static const LookupTables& getInstance();
         int64_t getBinomial(int n, int k) const;
 
+        // Coefficient of x^i in T_n, for n and i below maxChebyshevOrder
+        static constexpr int maxChebyshevOrder = 32;
+        double getChebyshev(int n, int i) const { return chebyshevMatrix[static_cast<size_t>(n * maxChebyshevOrder + i)]; }
+
     private:
         LookupTables();
         static int64_t calculateBinomial(int n, int k);
         std::vector<int64_t> binomialCoeffs;
+        std::vector<double> chebyshevMatrix;
     };
 
     /**
@@ -73,44 +148,16 @@ private:
      * 
      * Uses the cached binomial coefficients from LookupTables for efficiency.
      */
-    static float chebyshevCoefficient(int n, int i);
+    static double chebyshevCoefficient(int n, int i);
+    static double chebyshevCoefficient(int n, int i, const LookupTables& lookupTables);
 
-    /*
-    // Alternative implementation using Chebyshev polynomials of the second kind (U_n)
-    // Currently unused but preserved for future experimentation
-    // 
-    // Key differences from first kind (T_n):
-    // - U_n polynomials are based on sine relationships: U_n(cos θ) = sin((n+1)θ)/sin(θ)
-    // - Values at x=1 alternate between n+1 and -(n+1) instead of all being 1
-    // - This leads to better peak/RMS ratio in the output waveform
-    // - Same computational cost as T_n when implemented as polynomials
-    //
-    // The coefficient calculation follows the recurrence relation:
-    // U_0(x) = 1
-    // U_1(x) = 2x
-    // U_n(x) = 2xU_{n-1}(x) - U_{n-2}(x)
-    static float chebyshevSecondKindCoefficient(int n, int i)
-    {
-        // Early exit if i > n or parity doesn't match
-        if (i > n || ((n - i) % 2 != 0)) return 0.0f;
-        
-        float coeff = 0.0f;
-        int maxJ = (n - i) / 2;
-        const auto& lookupTables = LookupTables::getInstance();
-        
-        for (int j = 0; j <= maxJ; ++j)
-        {
-            // The main difference from T_n is in how the binomial terms combine
-            // This generates coefficients for U_n instead of T_n
-            float term = std::powf(-1.0f, static_cast<float>(j)) * 
-                        lookupTables.getBinomial(n + 1, j) * 
-                        std::powf(2.0f, static_cast<float>(n - 2 * j - i));
-            coeff += term;
-        }
-        
-        return coeff;
-    }
-    */
+    /**
+     * @brief Calculates the coefficient of x^i in the Chebyshev polynomial of the second kind U_n.
+     *
+     * U_n(cos θ) = sin((n + 1)θ) / sin(θ), so sin(θ) U_{n-1}(cos θ) = sin(nθ) is harmonic n in quadrature
+     * with T_n. Only one term of U_n(x) = sum_j (-1)^j C(n-j, j) (2x)^(n-2j) has power i.
+     */
+    static double chebyshevSecondKindCoefficient(int n, int i, const LookupTables& lookupTables);
 };
 
 } // namespace rosy 
\ No newline at end of file
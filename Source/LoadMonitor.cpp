@@ -0,0 +1,171 @@
+#include "LoadMonitor.h"
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+namespace rosy {
+
+void LoadMonitor::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    ticksPerSecond = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+    reset();
+}
+
+void LoadMonitor::reset()
+{
+    smoothedLoad.store(0.0f);
+    peakLoad.store(0.0f);
+    peakResetRequested.store(false);
+    xrunCount.store(0);
+
+    for (auto& load : stageLoads)
+        load.store(0.0f);
+
+    for (auto& histogram : stageHistograms)
+        for (auto& count : histogram)
+            count.store(0);
+
+    for (auto& count : blockHistogram)
+        count.store(0);
+
+    stageCycles.fill(0);
+}
+
+void LoadMonitor::beginBlock(int numSamples)
+{
+    blockNumSamples = numSamples;
+    stageCycles.fill(0);
+    blockStartTicks = juce::Time::getHighResolutionTicks();
+    blockStartCycles = readCycleCounter();
+    lastMarkCycles = blockStartCycles;
+}
+
+void LoadMonitor::endStage(Stage stage)
+{
+    // Stages can be marked more than once per block (e.g. the two meters), so accumulate
+    const uint64_t now = readCycleCounter();
+    stageCycles[stage] += now - lastMarkCycles;
+    lastMarkCycles = now;
+}
+
+float LoadMonitor::endBlock()
+{
+    const uint64_t endCycles = readCycleCounter();
+    const int64_t endTicks = juce::Time::getHighResolutionTicks();
+
+    if (blockNumSamples <= 0)
+        return 0.0f;
+
+    const double deadlineSeconds = blockNumSamples / sampleRate;
+    const double blockSeconds = (endTicks - blockStartTicks) / ticksPerSecond;
+    const float load = static_cast<float>(blockSeconds / deadlineSeconds);
+
+    if (load > 1.0f)
+        increment(xrunCount);
+
+    increment(blockHistogram[static_cast<size_t>(getBucketIndex(load))]);
+
+    const float previousLoad = smoothedLoad.load(std::memory_order_relaxed);
+    smoothedLoad.store(previousLoad + loadSmoothing * (load - previousLoad), std::memory_order_relaxed);
+
+    // The peak is only ever written here, so a reset can't be lost between the check and the store
+    if (peakResetRequested.load(std::memory_order_relaxed))
+    {
+        peakResetRequested.store(false, std::memory_order_relaxed);
+        peakLoad.store(load, std::memory_order_relaxed);
+    }
+    else if (load > peakLoad.load(std::memory_order_relaxed))
+    {
+        peakLoad.store(load, std::memory_order_relaxed);
+    }
+
+    // Share the block's load out between stages by their share of the block's cycles
+    const uint64_t blockCycles = endCycles - blockStartCycles;
+    if (blockCycles == 0)
+        return load;
+
+    for (int stage = 0; stage < numStages; ++stage)
+    {
+        const float stageLoad = load * static_cast<float>(static_cast<double>(stageCycles[static_cast<size_t>(stage)])
+                                                          / static_cast<double>(blockCycles));
+        increment(stageHistograms[static_cast<size_t>(stage)][static_cast<size_t>(getBucketIndex(stageLoad))]);
+
+        auto& published = stageLoads[static_cast<size_t>(stage)];
+        const float previous = published.load(std::memory_order_relaxed);
+        published.store(previous + loadSmoothing * (stageLoad - previous), std::memory_order_relaxed);
+    }
+
+    return load;
+}
+
+uint32_t LoadMonitor::getHistogramCount(Stage stage, int bucket) const
+{
+    if (! juce::isPositiveAndBelow(bucket, numHistogramBuckets))
+        return 0;
+    return stageHistograms[static_cast<size_t>(stage)][static_cast<size_t>(bucket)].load(std::memory_order_relaxed);
+}
+
+uint32_t LoadMonitor::getBlockHistogramCount(int bucket) const
+{
+    if (! juce::isPositiveAndBelow(bucket, numHistogramBuckets))
+        return 0;
+    return blockHistogram[static_cast<size_t>(bucket)].load(std::memory_order_relaxed);
+}
+
+float LoadMonitor::getPercentile(const Histogram& histogram, float fraction)
+{
+    uint64_t total = 0;
+    for (const auto& count : histogram)
+        total += count.load(std::memory_order_relaxed);
+
+    if (total == 0)
+        return 0.0f;
+
+    // Counts keep moving while this reads them, which only shifts the answer by a block or two
+    const auto target = static_cast<uint64_t>(std::ceil(static_cast<double>(juce::jlimit(0.0f, 1.0f, fraction)) * static_cast<double>(total)));
+    uint64_t cumulative = 0;
+    for (int bucket = 0; bucket < numHistogramBuckets - 1; ++bucket)
+    {
+        cumulative += histogram[static_cast<size_t>(bucket)].load(std::memory_order_relaxed);
+        if (cumulative >= target)
+            return static_cast<float>(bucket + 1) * histogramBucketWidth;
+    }
+
+    return std::numeric_limits<float>::infinity();
+}
+
+const char* LoadMonitor::getStageName(Stage stage)
+{
+    switch (stage)
+    {
+        case oscillator: return "Oscillator";
+        case meters:     return "Meters";
+        case gain:       return "Gain";
+        case numStages:  break;
+    }
+    return "";
+}
+
+uint64_t LoadMonitor::readCycleCounter() noexcept
+{
+   #if JUCE_INTEL
+    return static_cast<uint64_t>(__rdtsc());
+   #else
+    // No user-readable cycle counter everywhere, but the high resolution clock is cheap on these platforms
+    return static_cast<uint64_t>(juce::Time::getHighResolutionTicks());
+   #endif
+}
+
+int LoadMonitor::getBucketIndex(float load) noexcept
+{
+    const int index = static_cast<int>(load / histogramBucketWidth);
+    return juce::jlimit(0, numHistogramBuckets - 1, index);
+}
+
+} // namespace rosy
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace rosy {
+
+/**
+ * @brief Measures how much of the real-time deadline each stage of processBlock uses.
+ *
+ * The audio thread brackets the block with beginBlock()/endBlock() and marks the end of each stage with
+ * endStage(). The whole block is timed with the high resolution clock and compared against the deadline
+ * (numSamples / sampleRate); stages are timed with the CPU cycle counter where one is available and
+ * converted by their share of the block's cycles, so no calibration of the counter's rate is needed.
+ *
+ * Results are aggregated into per-stage histograms of deadline usage plus a smoothed and peak load and an
+ * xrun count (blocks that took longer than their deadline). Everything is published through relaxed atomics
+ * written only by the audio thread, so any thread can read it without locking; other threads only ever ask
+ * for the peak to be reset, and the audio thread does it at the end of its next block. The cost is a handful of
+ * counter reads per block, which is small enough to leave running in release builds.
+ */
+class LoadMonitor
+{
+public:
+    enum Stage
+    {
+        oscillator = 0,  // Sine generation and waveshaping
+        meters,          // Both peak level calculators
+        gain,            // Volume and panning
+        numStages
+    };
+
+    // Each bucket covers 10% of the deadline, the last one collects everything from 150% upwards
+    static constexpr int numHistogramBuckets = 16;
+    static constexpr float histogramBucketWidth = 0.1f;
+
+    LoadMonitor() = default;
+
+    void prepare(double sampleRate);
+    void reset();
+
+    //==============================================================================
+    // Audio thread
+    void beginBlock(int numSamples);
+    void endStage(Stage stage);
+
+    // Returns the block's load, the fraction of its deadline it took
+    float endBlock();
+
+    //==============================================================================
+    // Any thread
+    float getLoad() const { return smoothedLoad.load(std::memory_order_relaxed); }
+    float getPeakLoad() const { return peakLoad.load(std::memory_order_relaxed); }
+    float getStageLoad(Stage stage) const { return stageLoads[stage].load(std::memory_order_relaxed); }
+    uint32_t getXrunCount() const { return xrunCount.load(std::memory_order_relaxed); }
+    uint32_t getHistogramCount(Stage stage, int bucket) const;
+    uint32_t getBlockHistogramCount(int bucket) const;
+
+    // The load the given fraction of blocks stayed within since prepare(), e.g. 0.99 for the 99th percentile,
+    // to the histogram's resolution. 0 before the first block, infinity if it's past the last bucket's start.
+    float getPercentileLoad(float fraction) const { return getPercentile(blockHistogram, fraction); }
+    float getStagePercentileLoad(Stage stage, float fraction) const { return getPercentile(stageHistograms[stage], fraction); }
+
+    // Restart the peak load from the next block, e.g. after the display has shown it
+    void requestPeakLoadReset() { peakResetRequested.store(true, std::memory_order_relaxed); }
+
+    static const char* getStageName(Stage stage);
+
+private:
+    using Histogram = std::array<std::atomic<uint32_t>, numHistogramBuckets>;
+
+    static uint64_t readCycleCounter() noexcept;
+    static int getBucketIndex(float load) noexcept;
+    static float getPercentile(const Histogram& histogram, float fraction);
+
+    // Single writer, so a plain load and store is enough and avoids a locked instruction
+    static void increment(std::atomic<uint32_t>& counter) noexcept
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    double sampleRate { 44100.0 };
+    double ticksPerSecond { 1.0 };
+
+    // Audio thread only
+    int64_t blockStartTicks { 0 };
+    uint64_t blockStartCycles { 0 };
+    uint64_t lastMarkCycles { 0 };
+    int blockNumSamples { 0 };
+    std::array<uint64_t, numStages> stageCycles {};
+
+    // Published results
+    std::atomic<float> smoothedLoad { 0.0f };
+    std::atomic<float> peakLoad { 0.0f };
+    std::atomic<bool> peakResetRequested { false };
+    std::array<std::atomic<float>, numStages> stageLoads {};
+    std::atomic<uint32_t> xrunCount { 0 };
+    std::array<Histogram, numStages> stageHistograms {};
+    Histogram blockHistogram {};
+
+    // Roughly a third of a second at typical block sizes
+    static constexpr float loadSmoothing = 0.05f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoadMonitor)
+};
+
+} // namespace rosy
\ No newline at end of file
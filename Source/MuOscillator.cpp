@@ -1,74 +1,712 @@
 #include "MuOscillator.h"
+#include "TraceRecorder.h"
 
 namespace rosy {
 
-MuOscillator::MuOscillator()
+template <typename SampleType>
+MuOscillator<SampleType>::MuOscillator()
 {
     // Initialize with first harmonic only (fundamental frequency)
     currentHarmonicGains.resize(numHarmonics, 0.0f);
     currentHarmonicGains[0] = 1.0f;
+
+    // Give every evaluator all the room it will ever need, so updating one on the audio thread never allocates
+    const std::vector<SampleType> longestShape(maxShapeCoefficients, 0);
+    for (auto* evaluator : { &polyEvaluator, &rightEvaluator, &quadratureEvaluator, &quadratureRightEvaluator })
+        evaluator->setCoefficients(longestShape);
+
+    morphEvaluator.setCoefficients(std::vector<SampleType>(CoefficientMorph<SampleType>::maxCoefficients, 0));
+    envelopeEvaluator.setCoefficients(std::vector<SampleType>(HarmonicEnvelopes<SampleType>::maxCoefficients, 0));
+    envelopeRightEvaluator.setCoefficients(std::vector<SampleType>(HarmonicEnvelopes<SampleType>::maxCoefficients, 0));
+    overrideEvaluator.setCoefficients(std::vector<SampleType>(numHarmonics + 1, 0));
+    overrideRightEvaluator.setCoefficients(std::vector<SampleType>(numHarmonics + 1, 0));
+
+    // Nothing is rendering yet, so the first shape can be taken over straight away
     updatePolyEvalGains(currentHarmonicGains);
+    updateShape();
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::updateShape()
+{
+    if (! shapePending.load())
+        return;
+
+    const juce::SpinLock::ScopedTryLockType lock(pendingLock);
+    if (! lock.isLocked())
+        return;  // Try again next block
+
+    const size_t numCoefficients = pendingShape.numCoefficients;
+    polyEvaluator.setCoefficients(pendingShape.left.data(), numCoefficients);
+    rightEvaluator.setCoefficients(pendingShape.right.data(), numCoefficients);
+    quadratureEvaluator.setCoefficients(pendingShape.quadratureLeft.data(), numCoefficients);
+    quadratureRightEvaluator.setCoefficients(pendingShape.quadratureRight.data(), numCoefficients);
+    renderingStereo = pendingShape.stereo;
+    renderingQuadrature = pendingShape.quadrature;
+    shapePending.store(false);
 }
 
-void MuOscillator::prepare(const juce::dsp::ProcessSpec& spec)
+template <typename SampleType>
+void MuOscillator<SampleType>::prepare(const juce::dsp::ProcessSpec& spec, ScratchArena& arena)
 {
     sampleRate = spec.sampleRate;
-    currentPhase.store(0.0f);
-    waveshaper.prepare(spec);
-    
-    // Bind the polyEvaluator to the waveshaper
-    waveshaper.functionToUse = [this](float x) { return polyEvaluator(x); };
-    
+    currentPhase.store(0);
+
     // Clamp frequency now that we have a valid sample rate
-    float nyquist = static_cast<float>(sampleRate) * 0.5f;
+    SampleType nyquist = static_cast<SampleType>(sampleRate * 0.5);
     frequency = std::min(frequency, nyquist);
+
+    // Padded at the front so the sine itself starts on a cache line, with the history just before it
+    constexpr size_t padding = ScratchArena::alignment / sizeof(SampleType);
+    static_assert(antialiasingHistory <= padding, "The history has to fit in the padding");
+    antialiasingSize = antialiasingHistory + spec.maximumBlockSize;
+    antialiasingInput = arena.allocate<SampleType>(padding + spec.maximumBlockSize) + padding - antialiasingHistory;
+    quadratureSize = spec.maximumBlockSize;
+    quadratureInput = arena.allocate<SampleType>(quadratureSize);
+
+    fmSmoothingSamples = static_cast<size_t>(juce::roundToInt(sampleRate * fmSmoothingSeconds));
 }
 
-void MuOscillator::reset()
+template <typename SampleType>
+void MuOscillator<SampleType>::reset()
 {
-    currentPhase.store(0.0f);
-    waveshaper.reset();
+    currentPhase.store(0);
+    samplesUntilControlTick = 0;
+    nextControlTick = 0;
+    std::fill(antialiasingInput, antialiasingInput + antialiasingSize, SampleType(0));
+
+    // Every note starts at the index it's set to rather than gliding there
+    fmIndex = fmTargetIndex;
+    fmRampRemaining = 0;
+    carrierGroupPhase = modulatorGroupPhase = 0;
+    fmSampleInGroup = 0;
+    modulatorLanesIncrement = -1;
+    modulating = isModulating();
 }
 
-void MuOscillator::process(const juce::dsp::ProcessContextReplacing<float>& context)
+template <typename SampleType>
+void MuOscillator<SampleType>::process(const juce::dsp::ProcessContextReplacing<SampleType>& context,
+                                       MorphPositions<SampleType> morphPositions,
+                                       EnvelopeCoefficients<SampleType> envelopeCoefficients)
 {
     auto& outputBlock = context.getOutputBlock();
-    const float phaseIncrement = frequency / static_cast<float>(sampleRate);
+    const size_t numSamples = outputBlock.getNumSamples();
+    if (outputBlock.getNumChannels() == 0 || numSamples == 0)
+        return;
+
+    updateShape();
+    SampleType* firstChannel = outputBlock.getChannelPointer(0);
+
+    // Phased harmonics need the quadrature sine as well, and only apply to the shape X/Y gains
+    const bool quadrature = renderingQuadrature && ! morphPositions.isActive() && ! envelopeCoefficients.isActive()
+                          && ! coefficientOverride && numSamples <= quadratureSize;
+
+    // Anti-aliasing needs the unshaped sine and the samples before it, so it renders into its own buffer
+    const bool antialiased = antialiasing != Antialiasing::off && ! quadrature && numSamples + antialiasingHistory <= antialiasingSize;
+    SampleType* sine = antialiased ? antialiasingInput + antialiasingHistory : firstChannel;
+    renderSine(sine, quadrature ? quadratureInput : nullptr, numSamples);
+
+    auto shape = [&](const PolyEvaluator& evaluator, SampleType* output, size_t start, size_t length)
+    {
+        if (antialiased)
+            evaluator.processAntiderivative(antialiasing == Antialiasing::firstOrder ? 1 : 2, sine + start, output + start, length);
+        else
+            evaluator.process(output + start, length);
+    };
+
+    // Each channel has its own polynomial, evaluated in one shared pass over the sine when possible
+    auto shapePair = [&](const PolyEvaluator& left, const PolyEvaluator& right, size_t start, size_t length)
+    {
+        SampleType* secondChannel = outputBlock.getChannelPointer(1);
+        if (antialiased)
+        {
+            shape(left, firstChannel, start, length);
+            shape(right, secondChannel, start, length);
+        }
+        else
+        {
+            left.processPair(right, firstChannel + start, secondChannel + start, length);
+        }
+    };
+
+    // Picks up the envelope sets for a tick, keeping the previous ones if the tick wasn't worked out
+    auto loadEnvelopeTick = [&](uint64_t tick)
+    {
+        size_t size = 0;
+        if (const SampleType* set = envelopeCoefficients.getSet(tick, 0, size))
+            envelopeEvaluator.setCoefficients(set, size);
+        if (const SampleType* set = envelopeCoefficients.getSet(tick, 1, size))
+            envelopeRightEvaluator.setCoefficients(set, size);
+    };
+
+    const bool twoChannels = outputBlock.getNumChannels() == 2;
+    bool rendersBothChannels = false;
+    if (morphPositions.isActive() || envelopeCoefficients.isActive())
+    {
+        // Shape a control tick at a time, re-reading the morph position or envelope set at the start of each
+        // tick. The tick counter carries across blocks, so the output doesn't depend on how the blocks are split.
+        const bool morphing = morphPositions.isActive();
+        rendersBothChannels = ! morphing && envelopeCoefficients.numChannels == 2 && twoChannels;
+
+        // Partway through a tick, carry on with that tick's envelope
+        if (! morphing && samplesUntilControlTick != 0 && nextControlTick > 0)
+            loadEnvelopeTick(nextControlTick - 1);
+
+        alignas(32) SampleType morphedCoefficients[CoefficientMorph<SampleType>::maxCoefficients];
+        size_t position = 0;
+        while (position < numSamples)
+        {
+            if (samplesUntilControlTick == 0)
+            {
+                if (morphing)
+                {
+                    morphPositions.morph->morph(morphPositions.x[position], morphPositions.y[position], morphedCoefficients);
+                    morphEvaluator.setCoefficients(morphedCoefficients, morphPositions.morph->getNumCoefficients());
+                }
+                else
+                {
+                    loadEnvelopeTick(nextControlTick);
+                }
+
+                samplesUntilControlTick = controlInterval;
+                ++nextControlTick;
+            }
+
+            const size_t tickSamples = std::min(samplesUntilControlTick, numSamples - position);
+            if (morphing)
+                shape(morphEvaluator, firstChannel, position, tickSamples);
+            else if (rendersBothChannels)
+                shapePair(envelopeEvaluator, envelopeRightEvaluator, position, tickSamples);
+            else
+                shape(envelopeEvaluator, firstChannel, position, tickSamples);
+
+            samplesUntilControlTick -= tickSamples;
+            position += tickSamples;
+        }
+    }
+    else if (quadrature)
+    {
+        // The right channel first, while channel 0 still holds the sine
+        rendersBothChannels = renderingStereo && twoChannels;
+        if (rendersBothChannels)
+            rightEvaluator.processQuadrature(quadratureRightEvaluator, firstChannel, quadratureInput,
+                                             outputBlock.getChannelPointer(1), numSamples);
+
+        polyEvaluator.processQuadrature(quadratureEvaluator, firstChannel, quadratureInput, firstChannel, numSamples);
+        advanceControlTicks(numSamples);
+    }
+    else
+    {
+        const PolyEvaluator& left = coefficientOverride ? overrideEvaluator : polyEvaluator;
+        const PolyEvaluator& right = coefficientOverride ? overrideRightEvaluator : rightEvaluator;
+
+        rendersBothChannels = renderingStereo && twoChannels;
+        if (rendersBothChannels)
+            shapePair(left, right, 0, numSamples);
+        else
+            shape(left, firstChannel, 0, numSamples);
+
+        // The ticks keep counting, so a morph or envelope switched on later lands on the same grid
+        advanceControlTicks(numSamples);
+    }
+
+    // The last input samples become the history for the next block
+    if (antialiased)
+        std::copy(antialiasingInput + numSamples, antialiasingInput + numSamples + antialiasingHistory, antialiasingInput);
+
+    // Every channel gets the same signal, unless the stereo path already wrote both
+    if (! rendersBothChannels)
+        for (size_t channel = 1; channel < outputBlock.getNumChannels(); ++channel)
+            std::copy(firstChannel, firstChannel + numSamples, outputBlock.getChannelPointer(channel));
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::renderSine(SampleType* output, SampleType* quadratureOutput, size_t numSamples)
+{
+    updateModulationState();
+    if (modulating)
+    {
+        renderModulatedSine(output, quadratureOutput, numSamples);
+        return;
+    }
+
+    const SampleType phaseIncrement = frequency / static_cast<SampleType>(sampleRate);
+    SampleType phase = currentPhase.load();
 
     // Generate phase-based sine wave
-    for (size_t sample = 0; sample < outputBlock.getNumSamples(); ++sample)
-    {
-        float phase = currentPhase.load();
-        
-        // Generate sine wave using JUCE's fast approximation
-        const float sineValue = juce::dsp::FastMathApproximations::sin(2.0f * juce::MathConstants<float>::pi * phase);
-        
-        // Write to all channels
-        for (int channel = 0; channel < static_cast<int>(outputBlock.getNumChannels()); ++channel)
-            outputBlock.setSample(channel, sample, sineValue);
-        
+    for (size_t sample = 0; sample < numSamples; ++sample)
+    {
+        output[sample] = sineAt(phase);
+
+        // With the sine as cos ψ, this is sin ψ = -cos θ
+        if (quadratureOutput != nullptr)
+            quadratureOutput[sample] = sineAt(phase >= SampleType(0.25) ? phase - SampleType(0.25) : phase + SampleType(0.75));
+
         // Update phase
         phase += phaseIncrement;
-        if (phase >= 1.0f)
-            phase -= 1.0f;
-            
-        currentPhase.store(phase);
+        if (phase >= 1)
+            phase -= 1;
     }
 
-    // Apply waveshaping
-    waveshaper.process(context);
+    currentPhase.store(phase);
+
+    // The modulator keeps turning, so FM switched on later starts where it would have been
+    advanceModulation(numSamples);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::setFrequencyModulation(SampleType ratio, SampleType index)
+{
+    fmRatio = std::max(ratio, SampleType(0));
+    index = std::max(index, SampleType(0));
+    if (index == fmTargetIndex)
+        return;
+
+    fmTargetIndex = index;
+    fmRampRemaining = fmSmoothingSamples;
+    if (fmRampRemaining == 0)
+        fmIndex = fmTargetIndex;
+    else
+        fmIndexStep = (fmTargetIndex - fmIndex) / static_cast<SampleType>(fmRampRemaining);
+}
+
+template <typename SampleType>
+SampleType MuOscillator<SampleType>::nextModulationIndex()
+{
+    if (fmRampRemaining > 0)
+        fmIndex = --fmRampRemaining == 0 ? fmTargetIndex : fmIndex + fmIndexStep;
+
+    return fmIndex;
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::updateModulationState()
+{
+    const bool modulatingNow = isModulating();
+    if (modulatingNow == modulating)
+        return;
+
+    // Hand the carrier's phase over between currentPhase and the group phase, from wherever the group has got to
+    const SampleType phaseIncrement = frequency / static_cast<SampleType>(sampleRate);
+    const SampleType groupOffset = static_cast<SampleType>(fmSampleInGroup) * phaseIncrement;
+    if (modulatingNow)
+    {
+        const SampleType groupPhase = currentPhase.load() - groupOffset;
+        carrierGroupPhase = groupPhase - std::floor(groupPhase);
+    }
+    else
+    {
+        const SampleType phase = carrierGroupPhase + groupOffset;
+        currentPhase.store(phase - std::floor(phase));
+    }
+
+    modulating = modulatingNow;
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::renderModulatedSine(SampleType* output, SampleType* quadratureOutput, size_t numSamples)
+{
+    const SampleType carrierIncrement = frequency / static_cast<SampleType>(sampleRate);
+    const SampleType modulatorIncrement = carrierIncrement * fmRatio;
+    const SampleType groupCarrierIncrement = static_cast<SampleType>(fmLanes) * carrierIncrement;
+
+    if (modulatorLanesIncrement != modulatorIncrement)
+        resyncModulator(modulatorIncrement);
+
+    // The phase deviation is index / 2 pi cycles at the modulator's peak
+    const SampleType deviationScale = 1 / juce::MathConstants<SampleType>::twoPi;
+
+    alignas(32) SampleType laneOffsets[fmLanes];
+    for (size_t lane = 0; lane < fmLanes; ++lane)
+        laneOffsets[lane] = static_cast<SampleType>(lane);
+
+    size_t position = 0;
+    while (position < numSamples)
+    {
+        // A block that starts partway through a group only takes that group's remaining lanes
+        const size_t firstLane = fmSampleInGroup;
+        const size_t count = std::min(fmLanes - firstLane, numSamples - position);
+
+        // The index is only worked out sample by sample while it's gliding
+        const bool gliding = fmRampRemaining > 0;
+        alignas(32) SampleType indices[fmLanes];
+        std::fill(indices, indices + fmLanes, fmIndex);
+        if (gliding)
+            for (size_t lane = firstLane; lane < firstLane + count; ++lane)
+                indices[lane] = nextModulationIndex();
+
+        alignas(32) SampleType sines[fmLanes];
+        alignas(32) SampleType quadratureSines[fmLanes];
+       #if JUCE_USE_SIMD
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+        const Vec offsets = Vec::fromRawArray(laneOffsets);
+        const Vec index = gliding ? Vec::fromRawArray(indices) : Vec::expand(fmIndex);
+        const Vec modulator = Vec::fromRawArray(modulatorSines.data());
+        const Vec carrier = Vec::multiplyAdd(Vec::expand(carrierGroupPhase), offsets, Vec::expand(carrierIncrement));
+        const Vec phase = Vec::multiplyAdd(carrier, index * Vec::expand(deviationScale), modulator);
+
+        // Whole aligned groups are written straight to the output
+        const bool direct = count == fmLanes && Vec::isSIMDAligned(output + position)
+                         && (quadratureOutput == nullptr || Vec::isSIMDAligned(quadratureOutput + position));
+        sineOfCycles(phase).copyToRawArray(direct ? output + position : sines);
+        if (quadratureOutput != nullptr)
+            sineOfCycles(phase - Vec::expand(SampleType(0.25))).copyToRawArray(direct ? quadratureOutput + position : quadratureSines);
+       #else
+        const bool direct = false;
+        for (size_t lane = firstLane; lane < firstLane + count; ++lane)
+        {
+            const SampleType phase = (carrierGroupPhase + laneOffsets[lane] * carrierIncrement) + indices[lane] * deviationScale * modulatorSines[lane];
+            sines[lane] = sineOfCycles(phase);
+            if (quadratureOutput != nullptr)
+                quadratureSines[lane] = sineOfCycles(phase - SampleType(0.25));
+        }
+       #endif
+
+        if (! direct)
+        {
+            std::copy(sines + firstLane, sines + firstLane + count, output + position);
+            if (quadratureOutput != nullptr)
+                std::copy(quadratureSines + firstLane, quadratureSines + firstLane + count, quadratureOutput + position);
+        }
+
+        position += count;
+        fmSampleInGroup += count;
+        if (fmSampleInGroup == fmLanes)
+        {
+            fmSampleInGroup = 0;
+            nextModulationGroup(groupCarrierIncrement, modulatorIncrement);
+        }
+    }
+}
+
+template <typename SampleType>
+SampleType MuOscillator<SampleType>::nextGroupPhase(SampleType phase, SampleType increment)
+{
+    // Group phases only ever move forwards from [0, 1), so truncating is std::floor() without the library call
+    // it turns into on x86 builds without SSE4.1, which came to one call per sample in double
+    phase += increment;
+    return phase - static_cast<SampleType>(static_cast<int64_t>(phase));
 }
 
-void MuOscillator::updatePolyEvalGains(const std::vector<float>& gains)
+template <typename SampleType>
+void MuOscillator<SampleType>::advanceModulation(size_t numSamples)
 {
-    polyEvaluator.setCoefficients(HarmonicProfileCalculator::calculateAllCoefficients(gains));
+    // Same group steps as renderModulatedSine(), so skipping leaves the lanes exactly where rendering would
+    for (size_t sample = 0; sample < std::min(numSamples, fmRampRemaining); ++sample)
+        nextModulationIndex();
+
+    const SampleType carrierIncrement = frequency / static_cast<SampleType>(sampleRate);
+    const SampleType modulatorIncrement = carrierIncrement * fmRatio;
+    const SampleType groupCarrierIncrement = static_cast<SampleType>(fmLanes) * carrierIncrement;
+
+    // The modulator's lanes are only kept up while FM is on, and picked up from the group phase when it comes on
+    if (! modulating)
+        modulatorLanesIncrement = -1;
+    else if (modulatorLanesIncrement != modulatorIncrement)
+        resyncModulator(modulatorIncrement);
+
+    const size_t groupsPassed = (fmSampleInGroup + numSamples) / fmLanes;
+    fmSampleInGroup = (fmSampleInGroup + numSamples) % fmLanes;
+    for (size_t group = 0; group < groupsPassed; ++group)
+        nextModulationGroup(groupCarrierIncrement, modulatorIncrement);
 }
 
-void MuOscillator::setFrequency(float freq)
+template <typename SampleType>
+void MuOscillator<SampleType>::nextModulationGroup(SampleType groupCarrierIncrement, SampleType modulatorIncrement)
+{
+    carrierGroupPhase = nextGroupPhase(carrierGroupPhase, groupCarrierIncrement);
+    modulatorGroupPhase = nextGroupPhase(modulatorGroupPhase, static_cast<SampleType>(fmLanes) * modulatorIncrement);
+
+    if (modulatorLanesIncrement < 0)
+        return;
+
+    if (--modulatorGroupsUntilResync == 0)
+    {
+        resyncModulator(modulatorIncrement);
+        return;
+    }
+
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+    const Vec sines = Vec::fromRawArray(modulatorSines.data());
+    const Vec cosines = Vec::fromRawArray(modulatorCosines.data());
+    const Vec rotationSin = Vec::expand(modulatorRotationSin);
+    const Vec rotationCos = Vec::expand(modulatorRotationCos);
+    (sines * rotationCos + cosines * rotationSin).copyToRawArray(modulatorSines.data());
+    (cosines * rotationCos - sines * rotationSin).copyToRawArray(modulatorCosines.data());
+   #else
+    for (size_t lane = 0; lane < fmLanes; ++lane)
+    {
+        const SampleType sine = modulatorSines[lane];
+        modulatorSines[lane] = sine * modulatorRotationCos + modulatorCosines[lane] * modulatorRotationSin;
+        modulatorCosines[lane] = modulatorCosines[lane] * modulatorRotationCos - sine * modulatorRotationSin;
+    }
+   #endif
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::resyncModulator(SampleType modulatorIncrement)
+{
+    for (size_t lane = 0; lane < fmLanes; ++lane)
+    {
+        const SampleType phase = modulatorGroupPhase + static_cast<SampleType>(lane) * modulatorIncrement;
+        modulatorSines[lane] = sineOfCycles(phase);
+        modulatorCosines[lane] = sineOfCycles(phase + SampleType(0.25));
+    }
+
+    const SampleType groupIncrement = static_cast<SampleType>(fmLanes) * modulatorIncrement;
+    modulatorRotationSin = sineOfCycles(groupIncrement);
+    modulatorRotationCos = sineOfCycles(groupIncrement + SampleType(0.25));
+    modulatorLanesIncrement = modulatorIncrement;
+    modulatorGroupsUntilResync = modulatorResyncGroups;
+}
+
+template <typename SampleType>
+template <typename Value>
+Value MuOscillator<SampleType>::sineOfCycles(Value phase)
+{
+    // Take off the nearest whole number of cycles by adding and subtracting 1.5 * 2^(mantissa bits), which
+    // rounds to the nearest integer without a conversion, so it works the same in a SIMD register
+    const SampleType rounding = std::is_same_v<SampleType, float> ? SampleType(12582912.0) : SampleType(6755399441055744.0);
+    const Value r = phase - ((phase + Value(rounding)) - Value(rounding));
+
+    // Taylor series of sin(2 pi r) to r^17, within 3e-8 of the sine over r in [-0.5, 0.5]
+    auto multiplyAdd = [](Value a, Value b, Value c)
+    {
+        if constexpr (std::is_same_v<Value, SampleType>)
+            return a + b * c;
+        else
+            return Value::multiplyAdd(a, b, c);
+    };
+
+    const Value r2 = r * r;
+    Value sum = Value(SampleType(0.10422916220813978));
+    sum = multiplyAdd(Value(SampleType(-0.7181223017785001)), sum, r2);
+    sum = multiplyAdd(Value(SampleType(3.8199525848482803)), sum, r2);
+    sum = multiplyAdd(Value(SampleType(-15.094642576822984)), sum, r2);
+    sum = multiplyAdd(Value(SampleType(42.058693944897634)), sum, r2);
+    sum = multiplyAdd(Value(SampleType(-76.70585975306136)), sum, r2);
+    sum = multiplyAdd(Value(SampleType(81.60524927607504)), sum, r2);
+    sum = multiplyAdd(Value(SampleType(-41.341702240399755)), sum, r2);
+    sum = multiplyAdd(Value(SampleType(6.283185307179586)), sum, r2);
+    return sum * r;
+}
+
+template <typename SampleType>
+SampleType MuOscillator<SampleType>::sineAt(SampleType phase)
+{
+    // JUCE's fast approximation is only accurate between -pi and pi, so use sin(x) = -sin(x - pi)
+    const SampleType pi = juce::MathConstants<SampleType>::pi;
+    return -juce::dsp::FastMathApproximations::sin(2 * pi * phase - pi);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::advance(size_t numSamples)
+{
+    updateShape();
+    updateModulationState();
+    if (modulating)
+    {
+        // Only the last samples are rendered, for the anti-aliasing history
+        const size_t rendered = std::min(numSamples, antialiasingHistory);
+        advanceModulation(numSamples - rendered);
+
+        SampleType lastSamples[antialiasingHistory];
+        renderModulatedSine(lastSamples, nullptr, rendered);
+        if (antialiasingInput != nullptr)
+        {
+            std::copy(antialiasingInput + rendered, antialiasingInput + antialiasingHistory, antialiasingInput);
+            std::copy(lastSamples, lastSamples + rendered, antialiasingInput + antialiasingHistory - rendered);
+        }
+
+        advanceControlTicks(numSamples);
+        return;
+    }
+
+    // Same accumulation as process(), so a skipped stretch leaves the phase exactly where rendering would have
+    const SampleType phaseIncrement = frequency / static_cast<SampleType>(sampleRate);
+    SampleType phase = currentPhase.load();
+
+    for (size_t sample = 0; sample < numSamples; ++sample)
+    {
+        // The anti-aliasing history is the sine at the last two skipped samples
+        if (numSamples - sample <= antialiasingHistory && antialiasingInput != nullptr)
+        {
+            std::copy(antialiasingInput + 1, antialiasingInput + antialiasingHistory, antialiasingInput);
+            antialiasingInput[antialiasingHistory - 1] = sineAt(phase);
+        }
+
+        phase += phaseIncrement;
+        if (phase >= 1)
+            phase -= 1;
+    }
+
+    currentPhase.store(phase);
+    advanceModulation(numSamples);
+
+    // Keep the control ticks where rendering would have left them
+    advanceControlTicks(numSamples);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::advanceControlTicks(size_t numSamples)
+{
+    // Ticks fall at samplesUntilControlTick and every controlInterval after it
+    if (numSamples <= samplesUntilControlTick)
+    {
+        samplesUntilControlTick -= numSamples;
+        return;
+    }
+
+    const size_t ticksPassed = (numSamples - samplesUntilControlTick - 1) / controlInterval + 1;
+    samplesUntilControlTick = samplesUntilControlTick + ticksPassed * controlInterval - numSamples;
+    nextControlTick += ticksPassed;
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::updatePolyEvalGains(const std::vector<float>& gains)
+{
+    ROSY_TRACE_SCOPE("updatePolyEvalGains");
+
+    // Leave out trailing harmonics too quiet to hear, each one dropped takes a power off the polynomial and
+    // the evaluator switches to the shorter kernel. Normalising by the full profile keeps the level unchanged.
+    const size_t numSignificant = std::min(HarmonicProfileCalculator::countSignificantHarmonics(gains), harmonicLimit);
+    const std::vector<float> significantGains(gains.begin(), gains.begin() + static_cast<std::ptrdiff_t>(numSignificant));
+
+    if (! harmonicPhases.empty())
+    {
+        // Both channels get both polynomials, at the same length so either can be switched to at any time
+        std::vector<float> leftGains(significantGains), rightGains(significantGains);
+        if (stereo)
+        {
+            panHarmonicGains(leftGains.data(), leftGains.size(), 0);
+            panHarmonicGains(rightGains.data(), rightGains.size(), 1);
+        }
+
+        std::vector<SampleType> inPhase, quadrature, rightInPhase, rightQuadrature;
+        HarmonicProfileCalculator::calculateQuadratureCoefficients(leftGains, harmonicPhases, gains, inPhase, quadrature);
+        HarmonicProfileCalculator::calculateQuadratureCoefficients(rightGains, harmonicPhases, gains, rightInPhase, rightQuadrature);
+        publishShape(inPhase, rightInPhase, quadrature, rightQuadrature);
+        return;
+    }
+
+    // Every polynomial of a set has the same length, so the audio thread can switch between them at any time
+    const std::vector<SampleType> noQuadrature(numSignificant + 1, 0);
+    if (! stereo)
+    {
+        const auto coefficients = HarmonicProfileCalculator::calculateAllCoefficients<SampleType>(significantGains, gains);
+        publishShape(coefficients, coefficients, noQuadrature, noQuadrature);
+        return;
+    }
+
+    // Both sides use the mono normalisation, so each channel still peaks within [-1, 1]
+    std::vector<float> leftGains(significantGains), rightGains(significantGains);
+    panHarmonicGains(leftGains.data(), leftGains.size(), 0);
+    panHarmonicGains(rightGains.data(), rightGains.size(), 1);
+
+    publishShape(HarmonicProfileCalculator::calculateAllCoefficients<SampleType>(leftGains, gains),
+                 HarmonicProfileCalculator::calculateAllCoefficients<SampleType>(rightGains, gains), noQuadrature, noQuadrature);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::publishShape(const std::vector<SampleType>& left, const std::vector<SampleType>& right,
+                                            const std::vector<SampleType>& quadratureLeft,
+                                            const std::vector<SampleType>& quadratureRight)
+{
+    jassert(left.size() <= maxShapeCoefficients && right.size() == left.size());
+    jassert(quadratureLeft.size() == left.size() && quadratureRight.size() == left.size());
+
+    auto copySet = [](const std::vector<SampleType>& source, std::array<SampleType, maxShapeCoefficients>& destination)
+    {
+        destination.fill(0);
+        std::copy(source.begin(), source.begin() + static_cast<std::ptrdiff_t>(std::min(source.size(), maxShapeCoefficients)),
+                  destination.begin());
+    };
+
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+    copySet(left, pendingShape.left);
+    copySet(right, pendingShape.right);
+    copySet(quadratureLeft, pendingShape.quadratureLeft);
+    copySet(quadratureRight, pendingShape.quadratureRight);
+    pendingShape.numCoefficients = juce::jlimit<size_t>(1, maxShapeCoefficients, left.size());
+    pendingShape.stereo = stereo;
+    pendingShape.quadrature = ! harmonicPhases.empty();
+    shapePending.store(true);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::setHarmonicPhases(const std::vector<float>& phases)
+{
+    harmonicPhases = phases;
+    updatePolyEvalGains(currentHarmonicGains);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::setHarmonicLimit(size_t limit)
+{
+    const size_t newLimit = juce::jlimit<size_t>(1, static_cast<size_t>(numHarmonics), limit);
+    if (newLimit == harmonicLimit)
+        return;
+
+    harmonicLimit = newLimit;
+    updatePolyEvalGains(currentHarmonicGains);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::panHarmonicGains(float* gains, size_t numGains, size_t channel) const
+{
+    panHarmonicGains(gains, numGains, channel, shapeXPan, shapeYPan);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::panHarmonicGains(float* gains, size_t numGains, size_t channel, float xPan, float yPan)
+{
+    // Balance law: the centre is unity on both sides and a group only ever gets quieter on the side it moves
+    // away from
+    auto channelGain = [channel](float pan) { return std::min(1.0f, 2.0f * (channel == 0 ? 1.0f - pan : pan)); };
+
+    for (size_t i = 1; i < numGains; ++i)
+    {
+        // Odd indices are the shape X group, even indices the shape Y group (see setShapeX/setShapeY)
+        gains[i] *= channelGain((i % 2 == 1) ? xPan : yPan);
+    }
+}
+
+template <typename SampleType>
+std::vector<float> MuOscillator<SampleType>::getChannelHarmonicGains(size_t channel) const
+{
+    std::vector<float> gains(currentHarmonicGains);
+    if (stereo)
+        panHarmonicGains(gains.data(), gains.size(), channel);
+
+    return gains;
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::calculateShapeGains(float x, float y, float* gains)
+{
+    // The same groups as setShapeX() and setShapeY(), around a fixed fundamental
+    gains[0] = 1.0f;
+    for (int i = 1; i < numHarmonics; ++i)
+        gains[i] = calculateHarmonicGain(i, (i % 2 == 1) ? x : y);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::setCoefficientOverride(const SampleType* coefficients, const SampleType* rightCoefficients,
+                                                      size_t numCoefficients)
+{
+    jassert(numCoefficients <= static_cast<size_t>(numHarmonics) + 1);
+    overrideEvaluator.setCoefficients(coefficients, numCoefficients);
+    overrideRightEvaluator.setCoefficients(rightCoefficients, numCoefficients);
+    coefficientOverride = true;
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::setFrequency(SampleType freq)
 {
     if (sampleRate > 0.0)
     {
-        float nyquist = static_cast<float>(sampleRate) * 0.5f;
+        SampleType nyquist = static_cast<SampleType>(sampleRate * 0.5);
         frequency = std::min(freq, nyquist);
     }
     else
@@ -77,18 +715,20 @@ void MuOscillator::setFrequency(float freq)
     }
 }
 
-float MuOscillator::calculateHarmonicGain(int harmonicIndex, float shape) const
+template <typename SampleType>
+float MuOscillator<SampleType>::calculateHarmonicGain(int harmonicIndex, float shape)
 {
     // Clamp shape between 0 and 1
     shape = std::max(0.0f, std::min(1.0f, shape));
-    
+
     // When shape is 0, gain is 0
     // When shape is 1, gain is 1/(i+1)
     // In between, we get a sharper rolloff controlled by rolloffSharpness
     return std::pow(shape, (harmonicIndex + 1) * rolloffSharpness / 2.0f) / (harmonicIndex + 1);
 }
 
-void MuOscillator::setShapeX(float x)
+template <typename SampleType>
+void MuOscillator<SampleType>::setShapeX(float x)
 {
     // Shape even harmonics (indices 1, 3, 5, ...)
     for (int i = 1; i < numHarmonics; i += 2)
@@ -98,7 +738,8 @@ void MuOscillator::setShapeX(float x)
     updatePolyEvalGains(currentHarmonicGains);
 }
 
-void MuOscillator::setShapeY(float y)
+template <typename SampleType>
+void MuOscillator<SampleType>::setShapeY(float y)
 {
     // Shape odd harmonics (indices 2, 4, 6, ...)
     // Note: We skip index 0 (fundamental) as it stays at 1.0
@@ -109,4 +750,24 @@ void MuOscillator::setShapeY(float y)
     updatePolyEvalGains(currentHarmonicGains);
 }
 
-} // namespace rosy 
\ No newline at end of file
+template <typename SampleType>
+void MuOscillator<SampleType>::setShapeXPan(float pan)
+{
+    shapeXPan = juce::jlimit(0.0f, 1.0f, pan);
+    stereo = shapeXPan != 0.5f || shapeYPan != 0.5f;
+    updatePolyEvalGains(currentHarmonicGains);
+}
+
+template <typename SampleType>
+void MuOscillator<SampleType>::setShapeYPan(float pan)
+{
+    shapeYPan = juce::jlimit(0.0f, 1.0f, pan);
+    stereo = shapeXPan != 0.5f || shapeYPan != 0.5f;
+    updatePolyEvalGains(currentHarmonicGains);
+}
+
+//==============================================================================
+template class MuOscillator<float>;
+template class MuOscillator<double>;
+
+} // namespace rosy
\ No newline at end of file
@@ -1,75 +1,596 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
 #include "HarmonicProfileCalculator.h"
+#include "CoefficientMorph.h"
+#include "HarmonicEnvelopes.h"
+#include "ScratchArena.h"
 
 namespace rosy {
 
-class MuOscillator : public juce::dsp::ProcessorBase
+template <typename SampleType>
+class MuOscillator
 {
 public:
     class PolyEvaluator
     {
     public:
+        // Polynomials up to this many coefficients get a fully unrolled kernel, longer ones a generic loop
+        static constexpr size_t maxUnrolledCoefficients { 24 };
+
         PolyEvaluator() = default;
-        
-        void setCoefficients(const std::vector<float>& newCoeffs) {
-            coefficients = newCoeffs;
-        }
-        
-        float operator()(float x) const {
-            float result = 0.0f;
-            float xPow = 1.0f;  // x^0
-            
-            for (float coeff : coefficients) {
-                result += coeff * xPow;
-                xPow *= x;
+
+        void setCoefficients(const std::vector<SampleType>& newCoeffs) {
+            setCoefficients(newCoeffs.data(), newCoeffs.size());
+        }
+
+        // Doesn't allocate once the evaluator has held this many coefficients, so it's safe on the audio thread.
+        // The kernel is picked by the number of coefficients, so trimming negligible high powers makes it cheaper.
+        void setCoefficients(const SampleType* newCoeffs, size_t numCoeffs) {
+            coefficients.assign(newCoeffs, newCoeffs + numCoeffs);
+            if (coefficients.empty())
+                coefficients.push_back(0);
+
+            // Weights for the antiderivative kernels: c_k / (k + 1) and 2 c_k / ((k + 1)(k + 2))
+            firstOrderWeights.resize(coefficients.size());
+            secondOrderWeights.resize(coefficients.size());
+            for (size_t k = 0; k < coefficients.size(); ++k) {
+                firstOrderWeights[k] = coefficients[k] / static_cast<SampleType>(k + 1);
+                secondOrderWeights[k] = 2 * coefficients[k] / static_cast<SampleType>((k + 1) * (k + 2));
             }
-            
+
+           #if JUCE_USE_SIMD
+            const auto& kernels = getKernels(std::make_index_sequence<maxUnrolledCoefficients + 1>());
+            const size_t numCoefficients = coefficients.size();
+            kernel = numCoefficients <= maxUnrolledCoefficients ? kernels.first[numCoefficients] : &processBlock<0>;
+            pairKernel = numCoefficients <= maxUnrolledCoefficients ? kernels.second[numCoefficients] : &processPairBlock<0>;
+            const auto& quadratureKernels = getQuadratureKernels(std::make_index_sequence<maxUnrolledCoefficients + 1>());
+            quadratureKernel = numCoefficients <= maxUnrolledCoefficients ? quadratureKernels[numCoefficients] : &processQuadratureBlock<0>;
+           #endif
+        }
+
+        size_t getNumCoefficients() const { return coefficients.size(); }
+
+        SampleType operator()(SampleType x) const {
+            // Horner's scheme, highest power first
+            SampleType result = 0;
+            for (auto it = coefficients.rbegin(); it != coefficients.rend(); ++it) {
+                result = *it + result * x;
+            }
+
             return result;
         }
-        
+
+        // Evaluates the polynomial in place over a block, a SIMD register's worth of samples at a time
+        void process(SampleType* samples, size_t numSamples) const {
+           #if JUCE_USE_SIMD
+            kernel(*this, samples, numSamples);
+           #else
+            for (size_t i = 0; i < numSamples; ++i)
+                samples[i] = (*this)(samples[i]);
+           #endif
+        }
+
+        // Evaluates this polynomial in place and a second one into secondOutput, from the same input samples.
+        // Both share the loads of x and the loop, so the pair costs little more than one polynomial.
+        void processPair(const PolyEvaluator& second, SampleType* samples, SampleType* secondOutput, size_t numSamples) const {
+            jassert(second.coefficients.size() == coefficients.size());
+
+           #if JUCE_USE_SIMD
+            pairKernel(*this, second, samples, secondOutput, numSamples);
+           #else
+            for (size_t i = 0; i < numSamples; ++i)
+            {
+                secondOutput[i] = second(samples[i]);
+                samples[i] = (*this)(samples[i]);
+            }
+           #endif
+        }
+
+        // Writes P(x) + y Q(x), with this polynomial as P and quadrature as Q, see
+        // HarmonicProfileCalculator::calculateQuadratureCoefficients(). The two Horner chains step through the
+        // powers of x together, so they share every load of x and hide each other's latency. output may be x.
+        void processQuadrature(const PolyEvaluator& quadrature, const SampleType* x, const SampleType* y,
+                               SampleType* output, size_t numSamples) const {
+            jassert(quadrature.coefficients.size() == coefficients.size());
+
+           #if JUCE_USE_SIMD
+            quadratureKernel(*this, quadrature, x, y, output, numSamples);
+           #else
+            for (size_t i = 0; i < numSamples; ++i)
+                output[i] = (*this)(x[i]) + y[i] * quadrature(x[i]);
+           #endif
+        }
+
+        /**
+         * Antiderivative anti-aliasing: writes the polynomial's antiderivative differenced over the last
+         * order + 1 input samples, which suppresses aliasing from the shaping at the cost of a gentle high
+         * frequency roll-off and order / 2 samples of delay.
+         *
+         * The divided differences are evaluated as the symmetric polynomials they reduce to for a polynomial,
+         * F[a, b] = sum c_k h_k(a, b) / (k + 1) and so on, rather than as (F(a) - F(b)) / (a - b). There is
+         * no division and no cancellation, so the result stays exact when neighbouring inputs are equal or
+         * nearly so, where it becomes the polynomial itself. Each output only depends on its own inputs, so
+         * the result doesn't depend on block boundaries.
+         *
+         * input[-1] and input[-2] must be readable and hold the previous block's last input samples.
+         */
+        void processAntiderivative(int order, const SampleType* input, SampleType* output, size_t numSamples) const {
+            jassert(order == 1 || order == 2);
+            const SampleType* weights = (order == 1 ? firstOrderWeights : secondOrderWeights).data();
+            const size_t size = coefficients.size();
+
+           #if JUCE_USE_SIMD
+            constexpr size_t width = Vec::SIMDNumElements;
+            alignas(Vec::SIMDRegisterSize) SampleType a[width] = {}, b[width] = {}, c[width] = {}, y[width] = {};
+
+            for (size_t i = 0; i < numSamples; i += width)
+            {
+                // The shifted inputs never line up with each other, so they always go through aligned lanes
+                const size_t count = std::min(width, numSamples - i);
+                std::copy(input + i, input + i + count, a);
+                std::copy(input + i - 1, input + i - 1 + count, b);
+                std::copy(input + i - 2, input + i - 2 + count, c);
+
+                const Vec result = order == 1 ? antiderivativeFirstOrder(weights, size, Vec::fromRawArray(a), Vec::fromRawArray(b))
+                                              : antiderivativeSecondOrder(weights, size, Vec::fromRawArray(a), Vec::fromRawArray(b),
+                                                                          Vec::fromRawArray(c));
+                result.copyToRawArray(y);
+                std::copy(y, y + count, output + i);
+            }
+           #else
+            for (size_t i = 0; i < numSamples; ++i)
+                output[i] = order == 1 ? antiderivativeFirstOrder(weights, size, input[i], input[i - 1])
+                                       : antiderivativeSecondOrder(weights, size, input[i], input[i - 1], input[i - 2]);
+           #endif
+        }
+
     private:
-        std::vector<float> coefficients;
+        // h_k(a, b) = a h_{k-1}(a, b) + b^k, the sum of every degree k monomial in a and b
+        template <typename Value>
+        static Value antiderivativeFirstOrder(const SampleType* weights, size_t size, Value a, Value b) {
+            Value power = Value(1), h = Value(1), sum = Value(weights[0]);
+            for (size_t k = 1; k < size; ++k) {
+                power = power * b;
+                h = multiplyAdd(power, h, a);
+                sum = multiplyAdd(sum, Value(weights[k]), h);
+            }
+
+            return sum;
+        }
+
+        // h_k(a, b, c) = c h_{k-1}(a, b, c) + h_k(a, b)
+        template <typename Value>
+        static Value antiderivativeSecondOrder(const SampleType* weights, size_t size, Value a, Value b, Value c) {
+            Value power = Value(1), hab = Value(1), habc = Value(1), sum = Value(weights[0]);
+            for (size_t k = 1; k < size; ++k) {
+                power = power * b;
+                hab = multiplyAdd(power, hab, a);
+                habc = multiplyAdd(hab, habc, c);
+                sum = multiplyAdd(sum, Value(weights[k]), habc);
+            }
+
+            return sum;
+        }
+
+        static SampleType multiplyAdd(SampleType a, SampleType b, SampleType c) { return a + b * c; }
+
+       #if JUCE_USE_SIMD
+        using Vec = juce::dsp::SIMDRegister<SampleType>;
+
+        static Vec multiplyAdd(Vec a, Vec b, Vec c) { return Vec::multiplyAdd(a, b, c); }
+        using Kernel = void (*)(const PolyEvaluator&, SampleType*, size_t);
+        using PairKernel = void (*)(const PolyEvaluator&, const PolyEvaluator&, SampleType*, SampleType*, size_t);
+        using QuadratureKernel = void (*)(const PolyEvaluator&, const PolyEvaluator&, const SampleType*, const SampleType*,
+                                          SampleType*, size_t);
+
+        // Horner's scheme, fully unrolled for a compile-time coefficient count. NumCoefficients == 0 is the
+        // generic kernel, which loops over however many coefficients there are at runtime.
+        template <size_t NumCoefficients>
+        static Vec evaluate(const SampleType* c, size_t runtimeSize, Vec x) {
+            if constexpr (NumCoefficients > 0) {
+                juce::ignoreUnused(runtimeSize);
+                return evaluateUnrolled<NumCoefficients>(c, x, std::make_index_sequence<NumCoefficients - 1>());
+            } else {
+                Vec result = Vec::expand(c[runtimeSize - 1]);
+                for (size_t k = runtimeSize - 1; k-- > 0;) {
+                    result = Vec::multiplyAdd(Vec::expand(c[k]), result, x);
+                }
+
+                return result;
+            }
+        }
+
+        template <size_t NumCoefficients, size_t... Steps>
+        static Vec evaluateUnrolled(const SampleType* c, Vec x, std::index_sequence<Steps...>) {
+            Vec result = Vec::expand(c[NumCoefficients - 1]);
+            ((result = Vec::multiplyAdd(Vec::expand(c[NumCoefficients - 2 - Steps]), result, x)), ...);
+            juce::ignoreUnused(x);  // A constant has nothing to multiply
+            return result;
+        }
+
+        // P(x) + y Q(x) with both Horner chains interleaved, unrolled the same way as evaluate()
+        template <size_t NumCoefficients>
+        static Vec evaluateQuadrature(const SampleType* p, const SampleType* q, size_t runtimeSize, Vec x, Vec y) {
+            if constexpr (NumCoefficients > 0) {
+                juce::ignoreUnused(runtimeSize);
+                return evaluateQuadratureUnrolled<NumCoefficients>(p, q, x, y, std::make_index_sequence<NumCoefficients - 1>());
+            } else {
+                Vec inPhase = Vec::expand(p[runtimeSize - 1]), quadrature = Vec::expand(q[runtimeSize - 1]);
+                for (size_t k = runtimeSize - 1; k-- > 0;) {
+                    inPhase = Vec::multiplyAdd(Vec::expand(p[k]), inPhase, x);
+                    quadrature = Vec::multiplyAdd(Vec::expand(q[k]), quadrature, x);
+                }
+
+                return Vec::multiplyAdd(inPhase, quadrature, y);
+            }
+        }
+
+        template <size_t NumCoefficients, size_t... Steps>
+        static Vec evaluateQuadratureUnrolled(const SampleType* p, const SampleType* q, Vec x, Vec y, std::index_sequence<Steps...>) {
+            Vec inPhase = Vec::expand(p[NumCoefficients - 1]), quadrature = Vec::expand(q[NumCoefficients - 1]);
+            ((inPhase = Vec::multiplyAdd(Vec::expand(p[NumCoefficients - 2 - Steps]), inPhase, x),
+              quadrature = Vec::multiplyAdd(Vec::expand(q[NumCoefficients - 2 - Steps]), quadrature, x)), ...);
+            juce::ignoreUnused(x);
+            return Vec::multiplyAdd(inPhase, quadrature, y);
+        }
+
+        template <size_t NumCoefficients>
+        static void processBlock(const PolyEvaluator& poly, SampleType* samples, size_t numSamples) {
+            constexpr size_t width = Vec::SIMDNumElements;
+            const SampleType* c = poly.coefficients.data();
+            const size_t size = poly.coefficients.size();
+
+            size_t i = 0;
+            while (i < numSamples)
+            {
+                if (Vec::isSIMDAligned(samples + i) && i + width <= numSamples)
+                {
+                    evaluate<NumCoefficients>(c, size, Vec::fromRawArray(samples + i)).copyToRawArray(samples + i);
+                    i += width;
+                }
+                else
+                {
+                    // Unaligned head or partial tail: go through an aligned copy rather than a scalar path,
+                    // so every sample sees exactly the same arithmetic wherever the block boundaries fall
+                    alignas(Vec::SIMDRegisterSize) SampleType lanes[width] = {};
+                    const size_t count = std::min(numSamples - i, width - alignmentOffset(samples + i));
+                    std::copy(samples + i, samples + i + count, lanes);
+                    evaluate<NumCoefficients>(c, size, Vec::fromRawArray(lanes)).copyToRawArray(lanes);
+                    std::copy(lanes, lanes + count, samples + i);
+                    i += count;
+                }
+            }
+        }
+
+        template <size_t NumCoefficients>
+        static void processPairBlock(const PolyEvaluator& first, const PolyEvaluator& second,
+                                     SampleType* samples, SampleType* secondOutput, size_t numSamples) {
+            constexpr size_t width = Vec::SIMDNumElements;
+            const SampleType* a = first.coefficients.data();
+            const SampleType* b = second.coefficients.data();
+            const size_t size = first.coefficients.size();
+
+            size_t i = 0;
+            while (i < numSamples)
+            {
+                if (Vec::isSIMDAligned(samples + i) && Vec::isSIMDAligned(secondOutput + i) && i + width <= numSamples)
+                {
+                    const Vec x = Vec::fromRawArray(samples + i);
+                    evaluate<NumCoefficients>(a, size, x).copyToRawArray(samples + i);
+                    evaluate<NumCoefficients>(b, size, x).copyToRawArray(secondOutput + i);
+                    i += width;
+                }
+                else
+                {
+                    // Same aligned lane copy as processBlock(), for heads, tails and outputs that don't line up
+                    alignas(Vec::SIMDRegisterSize) SampleType lanes[width] = {};
+                    alignas(Vec::SIMDRegisterSize) SampleType secondLanes[width] = {};
+                    const size_t count = std::min(numSamples - i, width - std::max(alignmentOffset(samples + i),
+                                                                                   alignmentOffset(secondOutput + i)));
+                    std::copy(samples + i, samples + i + count, lanes);
+
+                    const Vec x = Vec::fromRawArray(lanes);
+                    evaluate<NumCoefficients>(a, size, x).copyToRawArray(lanes);
+                    evaluate<NumCoefficients>(b, size, x).copyToRawArray(secondLanes);
+
+                    std::copy(lanes, lanes + count, samples + i);
+                    std::copy(secondLanes, secondLanes + count, secondOutput + i);
+                    i += count;
+                }
+            }
+        }
+
+        template <size_t NumCoefficients>
+        static void processQuadratureBlock(const PolyEvaluator& inPhase, const PolyEvaluator& quadrature,
+                                           const SampleType* x, const SampleType* y, SampleType* output, size_t numSamples) {
+            constexpr size_t width = Vec::SIMDNumElements;
+            const SampleType* p = inPhase.coefficients.data();
+            const SampleType* q = quadrature.coefficients.data();
+            const size_t size = inPhase.coefficients.size();
+
+            size_t i = 0;
+            while (i < numSamples)
+            {
+                if (Vec::isSIMDAligned(x + i) && Vec::isSIMDAligned(y + i) && Vec::isSIMDAligned(output + i) && i + width <= numSamples)
+                {
+                    evaluateQuadrature<NumCoefficients>(p, q, size, Vec::fromRawArray(x + i), Vec::fromRawArray(y + i))
+                        .copyToRawArray(output + i);
+                    i += width;
+                }
+                else
+                {
+                    // Same aligned lane copy as processBlock()
+                    alignas(Vec::SIMDRegisterSize) SampleType xLanes[width] = {};
+                    alignas(Vec::SIMDRegisterSize) SampleType yLanes[width] = {};
+                    const size_t count = std::min(numSamples - i, width - std::max({ alignmentOffset(x + i), alignmentOffset(y + i),
+                                                                                     alignmentOffset(output + i) }));
+                    std::copy(x + i, x + i + count, xLanes);
+                    std::copy(y + i, y + i + count, yLanes);
+                    evaluateQuadrature<NumCoefficients>(p, q, size, Vec::fromRawArray(xLanes), Vec::fromRawArray(yLanes))
+                        .copyToRawArray(xLanes);
+                    std::copy(xLanes, xLanes + count, output + i);
+                    i += count;
+                }
+            }
+        }
+
+        // One kernel per coefficient count, built once
+        template <size_t... Sizes>
+        static const std::pair<std::array<Kernel, sizeof...(Sizes)>, std::array<PairKernel, sizeof...(Sizes)>>&
+        getKernels(std::index_sequence<Sizes...>) {
+            static const std::pair<std::array<Kernel, sizeof...(Sizes)>, std::array<PairKernel, sizeof...(Sizes)>> kernels {
+                { { &processBlock<Sizes>... } }, { { &processPairBlock<Sizes>... } }
+            };
+            return kernels;
+        }
+
+        template <size_t... Sizes>
+        static const std::array<QuadratureKernel, sizeof...(Sizes)>& getQuadratureKernels(std::index_sequence<Sizes...>) {
+            static const std::array<QuadratureKernel, sizeof...(Sizes)> kernels { { &processQuadratureBlock<Sizes>... } };
+            return kernels;
+        }
+
+        // How many samples ptr sits past the previous SIMD alignment boundary
+        static size_t alignmentOffset(const SampleType* ptr) {
+            constexpr auto registerSize = Vec::SIMDRegisterSize;
+            return (reinterpret_cast<uintptr_t>(ptr) % registerSize) / sizeof(SampleType);
+        }
+
+        Kernel kernel { &processBlock<0> };
+        PairKernel pairKernel { &processPairBlock<0> };
+        QuadratureKernel quadratureKernel { &processQuadratureBlock<0> };
+       #endif
+
+        std::vector<SampleType> coefficients { 0 };
+        std::vector<SampleType> firstOrderWeights { 0 };
+        std::vector<SampleType> secondOrderWeights { 0 };
+    };
+
+    // Antiderivative anti-aliasing of the shaping, see PolyEvaluator::processAntiderivative
+    enum class Antialiasing
+    {
+        off = 0,
+        firstOrder,
+        secondOrder
     };
 
     MuOscillator();
 
     //==============================================================================
-    void prepare(const juce::dsp::ProcessSpec& spec) override;
-    void reset() override;
-    void process(const juce::dsp::ProcessContextReplacing<float>& context) override;
+    // The anti-aliasing buffer comes from the arena, so it has to outlive the oscillator's use of it
+    void prepare(const juce::dsp::ProcessSpec& spec, ScratchArena& arena);
+    void reset();
+    // With a morph, the shape follows the morph positions instead of the shape X/Y gains. Otherwise, with
+    // envelope coefficients, it follows the sets worked out for each control tick.
+    void process(const juce::dsp::ProcessContextReplacing<SampleType>& context,
+                 MorphPositions<SampleType> morphPositions = {},
+                 EnvelopeCoefficients<SampleType> envelopeCoefficients = {});
+
+    // Moves the phase on as if numSamples had been rendered, without rendering them
+    void advance(size_t numSamples);
+
+    // Takes over a shape worked out on the message thread since the last call. process() and advance() do this
+    // themselves, so it's only needed before asking rendersStereo() ahead of rendering.
+    void updateShape();
 
     //==============================================================================
-    void setFrequency(float freq);
+    void setFrequency(SampleType freq);
     void setShapeX(float x);
     void setShapeY(float y);
-    
+
+    // Shapes with these coefficients instead of the shape X/Y gains until cleared. The coefficients are copied,
+    // so a set can be shared by any number of voices. rightCoefficients is only used while the groups are panned.
+    void setCoefficientOverride(const SampleType* coefficients, const SampleType* rightCoefficients, size_t numCoefficients);
+    void clearCoefficientOverride() { coefficientOverride = false; }
+
+    void setAntialiasing(Antialiasing newAntialiasing) { antialiasing = newAntialiasing; }
+
+    // Through-zero FM of the phasor by a sine at ratio times the oscillator's frequency. index is the peak
+    // frequency deviation over the modulator's frequency, so once index * ratio passes 1 the instantaneous
+    // frequency swings through zero and the phase runs backwards instead of stalling. The modulated sine goes
+    // into the shaping like the plain one, so every shaping path and the anti-aliasing work with it. Changes of
+    // index are smoothed per sample over fmSmoothingSeconds; at an index of 0 the plain sine is rendered.
+    void setFrequencyModulation(SampleType ratio, SampleType index);
+    static constexpr double fmSmoothingSeconds { 0.02 };
+
+    // Gives each harmonic of the shape X/Y gains its own phase in radians, see
+    // HarmonicProfileCalculator::calculateQuadratureCoefficients(). An empty vector goes back to cosine phase.
+    // Morphs, envelopes and coefficient overrides still shape in cosine phase, and anti-aliasing is skipped
+    // while the phases are in use since the quadrature term isn't a function of the sine alone. Message thread,
+    // the audio thread switches to the quadrature polynomials when it takes over the next shape.
+    void setHarmonicPhases(const std::vector<float>& phases);
+    const std::vector<float>& getHarmonicPhases() const { return harmonicPhases; }
+
+    // Shapes with at most this many of the harmonics, the rest are left out of the polynomial like negligible ones
+    void setHarmonicLimit(size_t limit);
+    size_t getHarmonicLimit() const { return harmonicLimit; }
+
+    // Balance of the shape X and shape Y harmonic groups between left (0) and right (1), the fundamental stays
+    // centred. Anywhere off centre makes the oscillator render stereo when it's given two channels.
+    void setShapeXPan(float pan);
+    void setShapeYPan(float pan);
+    bool isStereo() const { return stereo; }
+
+    // Audio thread: whether the shape being rendered is panned, which trails isStereo() until updateShape()
+    bool rendersStereo() const { return renderingStereo; }
+
+    // How often a morph re-reads its position or the envelopes move on, in samples
+    static constexpr size_t controlInterval { 32 };
+
+    // Control ticks fall every controlInterval samples from the last reset(), numbered from 0
+    uint64_t getNextControlTick() const { return nextControlTick; }
+    size_t getSamplesUntilControlTick() const { return samplesUntilControlTick; }
+
     // Get current harmonic gains for display/debugging
     const std::vector<float>& getCurrentHarmonicGains() const { return currentHarmonicGains; }
 
+    // The gains channel 0 (left) or 1 (right) is rendered with, the same as the current gains unless panned
+    std::vector<float> getChannelHarmonicGains(size_t channel) const;
+
+    // Fills numHarmonics gains for any shape, without reading the oscillator's own
+    static constexpr int numHarmonics { 16 };
+    static void calculateShapeGains(float x, float y, float* gains);
+
+    // Applies this oscillator's panning for channel 0 (left) or 1 (right) to a set of gains
+    void panHarmonicGains(float* gains, size_t numGains, size_t channel) const;
+
+    // The same for any pair of pans, so a copy of the panning can be worked with away from the oscillator
+    static void panHarmonicGains(float* gains, size_t numGains, size_t channel, float xPan, float yPan);
+
 protected:
-    float calculateHarmonicGain(int harmonicIndex, float shape) const;
-    
+    static float calculateHarmonicGain(int harmonicIndex, float shape);
+
 private:
     void updatePolyEvalGains(const std::vector<float>& gains);
-    
-    std::atomic<float> currentPhase { 0.0f };
-    float frequency { 440.0f };
+    void advanceControlTicks(size_t numSamples);
+    // Renders the sine, and with quadratureOutput the sine a quarter cycle behind it
+    void renderSine(SampleType* output, SampleType* quadratureOutput, size_t numSamples);
+    static SampleType sineAt(SampleType phase);
+
+    // The frequency modulated sine is worked out a group of fmLanes samples at a time: the carrier phases of every
+    // lane come from its phase at the start of the group, offset by the modulator's lanes, the sine is evaluated
+    // across the lanes together and the result goes straight to the output. Groups are counted from the last reset(), so
+    // the lanes don't depend on block boundaries.
+   #if JUCE_USE_SIMD
+    static constexpr size_t fmLanes { juce::dsp::SIMDRegister<SampleType>::SIMDNumElements };
+   #else
+    static constexpr size_t fmLanes { 4 };
+   #endif
+    bool isModulating() const { return fmIndex != 0 || fmRampRemaining > 0; }
+    void updateModulationState();
+    void renderModulatedSine(SampleType* output, SampleType* quadratureOutput, size_t numSamples);
+    // Moves the groups and the index smoothing on by numSamples, the same way rendering would
+    void advanceModulation(size_t numSamples);
+    SampleType nextModulationIndex();
+    static SampleType nextGroupPhase(SampleType phase, SampleType increment);
+
+    // The modulator is a sine at a steady rate, so rather than being evaluated for every group like the carrier
+    // its lanes are turned on from the last group's by a rotation. They're worked out afresh from the group
+    // phase whenever the rate changes and every modulatorResyncGroups groups, so the rotation's rounding never
+    // builds up. Rendering and skipping step through the groups the same way, so they stay bit identical.
+    static constexpr size_t modulatorResyncGroups { 32 };
+    void resyncModulator(SampleType modulatorIncrement);
+    void nextModulationGroup(SampleType groupCarrierIncrement, SampleType modulatorIncrement);
+
+    // sin(2 pi phase) for phases within a few million cycles of 0, in a SIMD register or a plain value
+    template <typename Value>
+    static Value sineOfCycles(Value phase);
+
+    std::atomic<SampleType> currentPhase { 0 };
+    SampleType frequency { 440 };
     double sampleRate { 0.0 };
-    
-    static constexpr int numHarmonics { 16 };
+
+    // Frequency modulation, the carrier's group phase takes over from currentPhase while it's on
+    SampleType fmRatio { 1 };
+    SampleType fmIndex { 0 };
+    SampleType fmTargetIndex { 0 };
+    SampleType fmIndexStep { 0 };
+    size_t fmRampRemaining { 0 };
+    size_t fmSmoothingSamples { 0 };
+    SampleType carrierGroupPhase { 0 };
+    SampleType modulatorGroupPhase { 0 };
+    size_t fmSampleInGroup { 0 };
+    bool modulating { false };
+
+    // The modulator's sine and cosine in each lane of the current group, and the rotation to the next group
+    alignas(32) std::array<SampleType, fmLanes> modulatorSines {};
+    alignas(32) std::array<SampleType, fmLanes> modulatorCosines {};
+    SampleType modulatorRotationSin { 0 };
+    SampleType modulatorRotationCos { 1 };
+    SampleType modulatorLanesIncrement { -1 };  // The rate the lanes were worked out for, negative while they aren't kept up
+    size_t modulatorGroupsUntilResync { 0 };
+
     std::vector<float> currentHarmonicGains;
-    
+    size_t harmonicLimit { static_cast<size_t>(numHarmonics) };
+
     // Controls how quickly harmonics roll off when shape parameter is < 1.0
     // Has no effect when shape = 1.0 (pure reciprocal rolloff)
     // Higher values = sharper rolloff
-    float rolloffSharpness { 1.2f };
-    
+    static constexpr float rolloffSharpness { 1.2f };
+
     PolyEvaluator polyEvaluator;
-    juce::dsp::WaveShaper<float, std::function<float(float)>> waveshaper;
-    
+
+    // Right channel polynomial while the harmonic groups are panned, polyEvaluator is then the left one
+    PolyEvaluator rightEvaluator;
+    float shapeXPan { 0.5f };
+    float shapeYPan { 0.5f };
+    bool stereo { false };
+    bool renderingStereo { false };
+    bool renderingQuadrature { false };
+
+    // The shape's polynomials, worked out by updatePolyEvalGains() on the message thread and handed over
+    // under a SpinLock that updateShape() only ever tries, like CoefficientMorph's snapshots. The evaluators
+    // are sized for the longest set up front, so taking a set over never allocates.
+    static constexpr size_t maxShapeCoefficients { static_cast<size_t>(numHarmonics) + 1 };
+
+    struct ShapeSet
+    {
+        std::array<SampleType, maxShapeCoefficients> left {};
+        std::array<SampleType, maxShapeCoefficients> right {};
+        std::array<SampleType, maxShapeCoefficients> quadratureLeft {};
+        std::array<SampleType, maxShapeCoefficients> quadratureRight {};
+        size_t numCoefficients { 1 };
+        bool stereo { false };
+        bool quadrature { false };
+    };
+
+    void publishShape(const std::vector<SampleType>& left, const std::vector<SampleType>& right,
+                      const std::vector<SampleType>& quadratureLeft, const std::vector<SampleType>& quadratureRight);
+
+    ShapeSet pendingShape;
+    std::atomic<bool> shapePending { false };
+    juce::SpinLock pendingLock;
+
+    // With anti-aliasing on, the sine is rendered here after the last two samples of the previous block
+    static constexpr size_t antialiasingHistory { 2 };
+    Antialiasing antialiasing { Antialiasing::off };
+    SampleType* antialiasingInput { nullptr };
+    size_t antialiasingSize { 0 };
+
+    // Second polynomials for the quadrature sine while the harmonics have phases, one per channel. The phases
+    // themselves stay on the message thread, the audio thread goes by renderingQuadrature.
+    std::vector<float> harmonicPhases;
+    PolyEvaluator quadratureEvaluator;
+    PolyEvaluator quadratureRightEvaluator;
+    SampleType* quadratureInput { nullptr };
+    size_t quadratureSize { 0 };
+
+    // Morphed and enveloped coefficients get their own evaluators, so turning either off goes straight back
+    // to the shape gains
+    PolyEvaluator morphEvaluator;
+    PolyEvaluator envelopeEvaluator;
+    PolyEvaluator envelopeRightEvaluator;
+
+    // Coefficients set from outside, e.g. a shared per-note shape, taking the place of the shape X/Y gains
+    PolyEvaluator overrideEvaluator;
+    PolyEvaluator overrideRightEvaluator;
+    bool coefficientOverride { false };
+    size_t samplesUntilControlTick { 0 };
+    uint64_t nextControlTick { 0 };
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MuOscillator)
 };
 
-} // namespace rosy 
\ No newline at end of file
+} // namespace rosy
\ No newline at end of file
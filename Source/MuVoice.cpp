@@ -0,0 +1,174 @@
+#include "MuVoice.h"
+
+namespace rosy {
+
+template <typename SampleType>
+MuVoice<SampleType>::MuVoice()
+{
+    envelope.setParameters({ attackSeconds, 0.0f, 1.0f, releaseSeconds });
+}
+
+template <typename SampleType>
+void MuVoice<SampleType>::prepare(const juce::dsp::ProcessSpec& spec, ScratchArena& arena)
+{
+    // The oscillator renders one channel, or two when its harmonics are panned, and that's spread over the outputs
+    numVoiceChannels = std::min(static_cast<size_t>(spec.numChannels), voiceChannels.size());
+    oscillator.prepare({ spec.sampleRate, spec.maximumBlockSize, static_cast<juce::uint32>(numVoiceChannels) }, arena);
+
+    voiceBufferSize = spec.maximumBlockSize;
+    for (size_t channel = 0; channel < numVoiceChannels; ++channel)
+        voiceChannels[channel] = arena.allocate<SampleType>(voiceBufferSize);
+    envelope.setSampleRate(spec.sampleRate);
+    reset();
+}
+
+template <typename SampleType>
+void MuVoice<SampleType>::reset()
+{
+    oscillator.reset();
+    envelope.reset();
+    noteNumber = -1;
+}
+
+template <typename SampleType>
+void MuVoice<SampleType>::startNote(int midiNoteNumber, float velocity, uint32_t newNoteKey)
+{
+    noteNumber = midiNoteNumber;
+    noteKey = newNoteKey;
+    velocityGain = static_cast<SampleType>(velocity);
+
+    // Restart from phase 0 so every note starts the same way, no matter what the voice played before
+    oscillator.reset();
+    noteFrequency = static_cast<SampleType>(juce::MidiMessage::getMidiNoteInHertz(midiNoteNumber));
+    bendRatio = 1;
+    oscillator.setFrequency(noteFrequency);
+    pitchStepSet = false;
+
+    envelope.reset();
+    envelope.noteOn();
+}
+
+template <typename SampleType>
+void MuVoice<SampleType>::stopNote(bool allowTailOff)
+{
+    if (allowTailOff)
+    {
+        envelope.noteOff();
+    }
+    else
+    {
+        envelope.reset();
+        noteNumber = -1;
+    }
+}
+
+template <typename SampleType>
+void MuVoice<SampleType>::setPitchBend(float semitones)
+{
+    bendRatio = static_cast<SampleType>(std::exp2(semitones / 12.0f));
+    oscillator.setFrequency(getBentFrequency());
+
+    // With drift on, the next render sets the drifted frequency for the step it's in again
+    pitchStepSet = false;
+}
+
+template <typename SampleType>
+void MuVoice<SampleType>::renderNextBlock(const juce::dsp::AudioBlock<SampleType>& outputBlock, MorphPositions<SampleType> morphPositions,
+                                          EnvelopeCoefficients<SampleType> envelopeCoefficients)
+{
+    const size_t numChannels = outputBlock.getNumChannels();
+    oscillator.updateShape();
+    const size_t renderChannels = oscillator.rendersStereo() && numChannels == 2 && numVoiceChannels == 2 ? 2 : 1;
+    size_t position = 0;
+
+    while (position < outputBlock.getNumSamples() && isActive())
+    {
+        const size_t numSamples = applyPitchDrift(std::min(voiceBufferSize, outputBlock.getNumSamples() - position));
+
+        juce::dsp::AudioBlock<SampleType> voiceBlock(voiceChannels.data(), renderChannels, numSamples);
+        juce::dsp::ProcessContextReplacing<SampleType> context(voiceBlock);
+        oscillator.process(context, morphPositions.offsetBy(position), envelopeCoefficients);
+
+        if (harmonicMeter != nullptr)
+            harmonicMeter->process(voiceBlock.getChannelPointer(0), numSamples);
+
+        for (size_t sample = 0; sample < numSamples; ++sample)
+        {
+            const SampleType gain = static_cast<SampleType>(envelope.getNextSample()) * velocityGain;
+            for (size_t channel = 0; channel < numChannels; ++channel)
+                outputBlock.getChannelPointer(channel)[position + sample]
+                    += voiceBlock.getChannelPointer(std::min(channel, renderChannels - 1))[sample] * gain;
+        }
+
+        position += numSamples;
+    }
+
+    if (! isActive())
+        noteNumber = -1;
+}
+
+template <typename SampleType>
+void MuVoice<SampleType>::skipSamples(size_t numSamples)
+{
+    if (! isActive())
+        return;
+
+    // Same pitch steps as rendering, so the phase ends up in the same place
+    for (size_t position = 0; position < numSamples;)
+    {
+        const size_t stepSamples = applyPitchDrift(numSamples - position);
+        oscillator.advance(stepSamples);
+        position += stepSamples;
+    }
+
+    // The meter's measurement has a gap in it now
+    if (harmonicMeter != nullptr)
+        harmonicMeter->restart();
+
+    for (size_t sample = 0; sample < numSamples && isActive(); ++sample)
+        envelope.getNextSample();
+
+    if (! isActive())
+        noteNumber = -1;
+}
+
+template <typename SampleType>
+size_t MuVoice<SampleType>::applyPitchDrift(size_t maxSamples)
+{
+    if (analogDrift == nullptr || ! analogDrift->hasPitchDrift())
+    {
+        // Back to the note's own pitch if the drift was just switched off
+        if (pitchStepSet)
+        {
+            oscillator.setFrequency(getBentFrequency());
+            pitchStepSet = false;
+        }
+
+        return maxSamples;
+    }
+
+    // The tick the next sample is in, and how far it is to the first tick of the following step
+    constexpr size_t interval = MuOscillator<SampleType>::controlInterval;
+    constexpr uint64_t stepTicks = AnalogDrift::pitchStepTicks;
+    const uint64_t nextTick = oscillator.getNextControlTick();
+    const size_t samplesUntilTick = oscillator.getSamplesUntilControlTick();
+    const uint64_t currentTick = samplesUntilTick == 0 || nextTick == 0 ? nextTick : nextTick - 1;
+    const uint64_t step = currentTick / stepTicks;
+    const uint64_t nextStepTick = (step + 1) * stepTicks;
+    const size_t samplesUntilStep = samplesUntilTick + static_cast<size_t>(nextStepTick - nextTick) * interval;
+
+    if (! pitchStepSet || step != pitchStep)
+    {
+        oscillator.setFrequency(getBentFrequency() * static_cast<SampleType>(analogDrift->getPitchRatio(noteKey, step * stepTicks)));
+        pitchStep = step;
+        pitchStepSet = true;
+    }
+
+    return std::min(maxSamples, samplesUntilStep);
+}
+
+//==============================================================================
+template class MuVoice<float>;
+template class MuVoice<double>;
+
+} // namespace rosy
\ No newline at end of file
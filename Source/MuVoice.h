@@ -0,0 +1,112 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "MuOscillator.h"
+#include "HarmonicMeter.h"
+#include "AnalogDrift.h"
+
+namespace rosy {
+
+/**
+ * @brief A single note: a MuOscillator with an amplitude envelope and velocity.
+ *
+ * Voices are rendered sample by sample with no per-block state, so a note renders identically whatever
+ * block sizes it is split into. That is what lets the offline renderer render notes independently and
+ * still match the plugin. Pitch drift keeps to that too: the frequency only changes on the oscillator's control
+ * tick grid, every AnalogDrift::pitchStepTicks ticks, to the drift curve's value for the note's key there.
+ */
+template <typename SampleType>
+class MuVoice
+{
+public:
+    MuVoice();
+
+    //==============================================================================
+    // Render buffers come from the arena, so it has to outlive the voice's use of them
+    void prepare(const juce::dsp::ProcessSpec& spec, ScratchArena& arena);
+    void reset();
+
+    //==============================================================================
+    // noteKey picks the note's drift and jitter curves, so giving a note the same key gives it the same wander
+    void startNote(int midiNoteNumber, float velocity, uint32_t noteKey = 0);
+    void stopNote(bool allowTailOff);
+
+    bool isActive() const { return envelope.isActive(); }
+    int getNoteNumber() const { return noteNumber; }
+    uint32_t getNoteKey() const { return noteKey; }
+
+    //==============================================================================
+    void setShapeX(float x) { oscillator.setShapeX(x); }
+    void setShapeY(float y) { oscillator.setShapeY(y); }
+    void setShapeXPan(float pan) { oscillator.setShapeXPan(pan); }
+    void setShapeYPan(float pan) { oscillator.setShapeYPan(pan); }
+    void setAntialiasing(typename MuOscillator<SampleType>::Antialiasing antialiasing) { oscillator.setAntialiasing(antialiasing); }
+    void setHarmonicLimit(size_t limit) { oscillator.setHarmonicLimit(limit); }
+    void setHarmonicPhases(const std::vector<float>& phases) { oscillator.setHarmonicPhases(phases); }
+    void setFrequencyModulation(SampleType ratio, SampleType index) { oscillator.setFrequencyModulation(ratio, index); }
+    void setCoefficientOverride(const SampleType* coefficients, const SampleType* rightCoefficients, size_t numCoefficients)
+    {
+        oscillator.setCoefficientOverride(coefficients, rightCoefficients, numCoefficients);
+    }
+    void clearCoefficientOverride() { oscillator.clearCoefficientOverride(); }
+
+    // Bends the note from its MIDI pitch from here on, on top of any drift. startNote() sets it back to none.
+    void setPitchBend(float semitones);
+    SampleType getBentFrequency() const { return noteFrequency * bendRatio; }
+
+    // The note's pitch follows this drift's curves until it's set to nullptr, it has to outlive its use here
+    void setAnalogDrift(const AnalogDrift* driftToFollow) { analogDrift = driftToFollow; }
+
+    // The oscillator's output (the left channel when it renders stereo) is fed to this meter until it's set to nullptr
+    void setHarmonicMeter(HarmonicMeter<SampleType>* meterToFeed) { harmonicMeter = meterToFeed; }
+
+    const MuOscillator<SampleType>& getOscillator() const { return oscillator; }
+    const std::vector<float>& getCurrentHarmonicGains() const { return oscillator.getCurrentHarmonicGains(); }
+    const std::vector<float>& getHarmonicPhases() const { return oscillator.getHarmonicPhases(); }
+    std::vector<float> getChannelHarmonicGains(size_t channel) const { return oscillator.getChannelHarmonicGains(channel); }
+    bool isStereo() const { return oscillator.isStereo(); }
+
+    // Where the oscillator's control ticks are, for working out the voice's envelope sets ahead of rendering
+    uint64_t getNextControlTick() const { return oscillator.getNextControlTick(); }
+    size_t getSamplesUntilControlTick() const { return oscillator.getSamplesUntilControlTick(); }
+
+    // Adds the voice's output to every channel of the block, morphing the shape if positions are given or
+    // following the harmonic envelopes if their coefficients are
+    void renderNextBlock(const juce::dsp::AudioBlock<SampleType>& outputBlock, MorphPositions<SampleType> morphPositions = {},
+                         EnvelopeCoefficients<SampleType> envelopeCoefficients = {});
+
+    // Runs the oscillator phase and envelope on by numSamples without producing any output
+    void skipSamples(size_t numSamples);
+
+    // Envelope times shared with anything that needs to know how long a released note rings on
+    static constexpr float attackSeconds = 0.005f;
+    static constexpr float releaseSeconds = 0.05f;
+
+private:
+    // Samples the oscillator can run before the next pitch step, setting the frequency for the step it's in
+    size_t applyPitchDrift(size_t maxSamples);
+
+    MuOscillator<SampleType> oscillator;
+    juce::ADSR envelope;
+
+    // Mono or stereo render target for the oscillator, taken from the arena in prepare()
+    std::array<SampleType*, 2> voiceChannels {};
+    size_t numVoiceChannels { 0 };
+    size_t voiceBufferSize { 0 };
+
+    HarmonicMeter<SampleType>* harmonicMeter { nullptr };
+
+    const AnalogDrift* analogDrift { nullptr };
+    uint64_t pitchStep { 0 };
+    bool pitchStepSet { false };
+
+    int noteNumber { -1 };
+    uint32_t noteKey { 0 };
+    SampleType noteFrequency { 0 };
+    SampleType bendRatio { 1 };
+    SampleType velocityGain { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MuVoice)
+};
+
+} // namespace rosy
\ No newline at end of file
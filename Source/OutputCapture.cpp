@@ -0,0 +1,164 @@
+#include "OutputCapture.h"
+
+namespace rosy {
+
+OutputCapture::OutputCapture() : juce::Thread("Rosemary capture")
+{
+}
+
+OutputCapture::~OutputCapture()
+{
+    stop();
+}
+
+void OutputCapture::prepare(double newSampleRate, int numChannels)
+{
+    const juce::ScopedLock scopedLock(lock);
+
+    // Whatever is queued was recorded with the old format, so it goes in the old file
+    if (capturing.load())
+        drain();
+
+    closeFile();
+
+    sampleRate = newSampleRate;
+    const int fifoSize = juce::jmax(1, juce::roundToInt(sampleRate * fifoSeconds));
+    fifoBuffer.setSize(juce::jmax(1, numChannels), fifoSize);
+
+    // Written through once here, so a capture started later doesn't fault the pages in on the audio thread
+    for (int channel = 0; channel < fifoBuffer.getNumChannels(); ++channel)
+        juce::FloatVectorOperations::clear(fifoBuffer.getWritePointer(channel), fifoSize);
+
+    fifo.setTotalSize(fifoSize);
+    fifo.reset();
+    readPointers.assign(static_cast<size_t>(fifoBuffer.getNumChannels()), nullptr);
+}
+
+void OutputCapture::start(const juce::File& folder, juce::int64 maxFileBytes)
+{
+    // Neither thread runs while capture is off. Either is left alone if capture is already running.
+    writerThread.startThread();
+    startThread();
+
+    const juce::ScopedLock scopedLock(lock);
+    closeFile();
+
+    // Anything still queued is from before the last stop()
+    fifo.read(fifo.getNumReady());
+
+    captureFolder = folder;
+    maxBytesPerFile = juce::jmax(static_cast<juce::int64>(1024 * 1024), maxFileBytes);
+    sessionName = "Rosemary " + juce::Time::getCurrentTime().formatted("%Y-%m-%d %H-%M-%S");
+    droppedSamples.store(0);
+    numFilesWritten.store(0);
+    capturing.store(true);
+}
+
+void OutputCapture::stop()
+{
+    if (! capturing.exchange(false))
+        return;
+
+    {
+        const juce::ScopedLock scopedLock(lock);
+        drain();
+        closeFile();
+    }
+
+    // Only once everything is written, the drain loop needs the lock and the file needed the writer thread
+    stopThread(2000);
+    writerThread.stopThread(2000);
+}
+
+juce::File OutputCapture::getDefaultFolder()
+{
+    return juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("Rosemary Captures");
+}
+
+void OutputCapture::run()
+{
+    while (! threadShouldExit())
+    {
+        wait(drainIntervalMs);
+
+        const juce::ScopedLock scopedLock(lock);
+        if (capturing.load())
+            drain();
+    }
+}
+
+void OutputCapture::drain()
+{
+    const auto scope = fifo.read(fifo.getNumReady());
+    writeToFile(scope.startIndex1, scope.blockSize1);
+    writeToFile(scope.startIndex2, scope.blockSize2);
+}
+
+void OutputCapture::writeToFile(int start, int numSamples)
+{
+    if (numSamples <= 0)
+        return;
+
+    if (writer == nullptr || bytesInFile >= maxBytesPerFile)
+        openNextFile();
+
+    // No file to write to, e.g. the folder isn't writable
+    if (writer == nullptr)
+    {
+        droppedSamples.fetch_add(numSamples);
+        return;
+    }
+
+    for (size_t channel = 0; channel < readPointers.size(); ++channel)
+        readPointers[channel] = fifoBuffer.getReadPointer(static_cast<int>(channel), start);
+
+    // The writer's own buffer is as big as the FIFO, so it's only full if the disk has fallen behind. The
+    // audio thread carries on filling the FIFO in the meantime.
+    while (! writer->write(readPointers.data(), numSamples))
+    {
+        if (threadShouldExit())
+        {
+            droppedSamples.fetch_add(numSamples);
+            return;
+        }
+
+        juce::Thread::sleep(5);
+    }
+
+    bytesInFile += static_cast<juce::int64>(numSamples) * static_cast<juce::int64>(readPointers.size()) * static_cast<juce::int64>(sizeof(float));
+}
+
+void OutputCapture::openNextFile()
+{
+    closeFile();
+    if (! captureFolder.createDirectory())
+        return;
+
+    const int fileNumber = numFilesWritten.load() + 1;
+    const auto file = captureFolder.getChildFile(sessionName + " " + juce::String(fileNumber).paddedLeft('0', 3) + ".wav")
+                                   .getNonexistentSibling();
+
+    auto stream = std::make_unique<juce::FileOutputStream>(file);
+    if (! stream->openedOk())
+        return;
+
+    // 32 bits makes the WAV writer store floats, so the file holds exactly what the plugin produced
+    auto* formatWriter = juce::WavAudioFormat().createWriterFor(stream.get(), sampleRate,
+                                                                static_cast<unsigned int>(fifoBuffer.getNumChannels()), 32, {}, 0);
+    if (formatWriter == nullptr)
+        return;
+
+    stream.release();  // The writer owns the stream now
+    writer = std::make_unique<juce::AudioFormatWriter::ThreadedWriter>(formatWriter, writerThread, fifoBuffer.getNumSamples());
+    bytesInFile = 0;
+    numFilesWritten.store(fileNumber);
+}
+
+void OutputCapture::closeFile()
+{
+    // The threaded writer writes out everything it still holds before it goes
+    writer.reset();
+    bytesInFile = 0;
+}
+
+} // namespace rosy
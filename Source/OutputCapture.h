@@ -0,0 +1,126 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <type_traits>
+#include <vector>
+
+namespace rosy {
+
+/**
+ * @brief Records exactly what the plugin outputs to WAV files, for QA sessions without a separate recorder.
+ *
+ * All the audio thread does is copy each block into a FIFO, converting to float on the way if the host runs
+ * in double precision. If the FIFO hasn't got room for a whole block the block is dropped and counted rather
+ * than waiting on the disk, so a slow drive shows up as dropped samples instead of xruns. A background thread
+ * moves whatever is queued into a juce::AudioFormatWriter::ThreadedWriter, which does the actual writing on
+ * its own thread, and starts a new file once the current one has reached the size limit. Files can run over
+ * the limit by up to one drain interval's worth of audio. Both threads only run between start() and stop(),
+ * so capture costs nothing while it's off.
+ *
+ * Files are 32 bit float WAVs named after the time capture started and numbered in order, e.g.
+ * "Rosemary 2024-05-01 14-03-22 001.wav".
+ */
+class OutputCapture : private juce::Thread
+{
+public:
+    static constexpr juce::int64 defaultMaxFileBytes { 512 * 1024 * 1024 };
+
+    OutputCapture();
+    ~OutputCapture() override;
+
+    //==============================================================================
+    // Message thread, while the audio thread isn't processing. Starts a new file if capture is running.
+    void prepare(double sampleRate, int numChannels);
+
+    // Message thread. stop() finishes writing everything queued before it returns.
+    void start(const juce::File& folder = getDefaultFolder(), juce::int64 maxFileBytes = defaultMaxFileBytes);
+    void stop();
+    bool isCapturing() const { return capturing.load(); }
+
+    // Where captures go unless start() is given another folder
+    static juce::File getDefaultFolder();
+
+    //==============================================================================
+    // Audio thread
+    template <typename SampleType>
+    void push(const SampleType* const* channels, int numChannels, int numSamples);
+
+    //==============================================================================
+    // Any thread, counted since the last start()
+    juce::int64 getDroppedSamples() const { return droppedSamples.load(); }
+    int getNumFilesWritten() const { return numFilesWritten.load(); }
+
+private:
+    static constexpr double fifoSeconds { 2.0 };
+    static constexpr int drainIntervalMs { 50 };
+
+    void run() override;
+
+    // Capture thread, or the message thread, with the lock held
+    void drain();
+    void writeToFile(int start, int numSamples);
+    void openNextFile();
+    void closeFile();
+
+    std::atomic<bool> capturing { false };
+    std::atomic<juce::int64> droppedSamples { 0 };
+    std::atomic<int> numFilesWritten { 0 };
+
+    // Written by the audio thread, read by whichever thread holds the lock
+    juce::AbstractFifo fifo { 1 };
+    juce::AudioBuffer<float> fifoBuffer;
+    double sampleRate { 44100.0 };
+
+    // Everything from here on is guarded by the lock
+    juce::CriticalSection lock;
+    juce::TimeSliceThread writerThread { "Rosemary capture writer" };
+    std::unique_ptr<juce::AudioFormatWriter::ThreadedWriter> writer;
+    std::vector<const float*> readPointers;
+    juce::File captureFolder;
+    juce::String sessionName;
+    juce::int64 maxBytesPerFile { defaultMaxFileBytes };
+    juce::int64 bytesInFile { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(OutputCapture)
+};
+
+//==============================================================================
+template <typename SampleType>
+void OutputCapture::push(const SampleType* const* channels, int numChannels, int numSamples)
+{
+    if (! capturing.load(std::memory_order_relaxed) || numSamples <= 0)
+        return;
+
+    if (fifo.getFreeSpace() < numSamples)
+    {
+        droppedSamples.fetch_add(numSamples, std::memory_order_relaxed);
+        return;
+    }
+
+    const int numChannelsToCopy = std::min(numChannels, fifoBuffer.getNumChannels());
+    const auto scope = fifo.write(numSamples);
+    auto copy = [&](int fifoStart, int count, int sourceStart)
+    {
+        for (int channel = 0; channel < numChannelsToCopy; ++channel)
+        {
+            const SampleType* source = channels[channel] + sourceStart;
+            float* destination = fifoBuffer.getWritePointer(channel, fifoStart);
+            if constexpr (std::is_same_v<SampleType, float>)
+                juce::FloatVectorOperations::copy(destination, source, count);
+            else
+                for (int sample = 0; sample < count; ++sample)
+                    destination[sample] = static_cast<float>(source[sample]);
+        }
+
+        // A mono host buffer into a stereo capture, say, leaves silence in the channels it doesn't have
+        for (int channel = numChannelsToCopy; channel < fifoBuffer.getNumChannels(); ++channel)
+            juce::FloatVectorOperations::clear(fifoBuffer.getWritePointer(channel, fifoStart), count);
+    };
+
+    if (scope.blockSize1 > 0)
+        copy(scope.startIndex1, scope.blockSize1, 0);
+    if (scope.blockSize2 > 0)
+        copy(scope.startIndex2, scope.blockSize2, scope.blockSize1);
+}
+
+} // namespace rosy
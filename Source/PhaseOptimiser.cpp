@@ -0,0 +1,230 @@
+#include "PhaseOptimiser.h"
+
+namespace rosy {
+
+namespace {
+
+// Samples of one cycle of each harmonic, enough per cycle of the highest one that the grid's peak is close
+// to the true peak
+struct HarmonicGrid
+{
+    static constexpr size_t pointsPerHarmonic { 64 };
+
+    explicit HarmonicGrid(size_t numHarmonicsToUse)
+        : numHarmonics(numHarmonicsToUse), numPoints(std::max<size_t>(numHarmonicsToUse, 1) * pointsPerHarmonic),
+          cosines(numHarmonics * numPoints), sines(numHarmonics * numPoints)
+    {
+        for (size_t n = 0; n < numHarmonics; ++n)
+        {
+            for (size_t point = 0; point < numPoints; ++point)
+            {
+                const double angle = juce::MathConstants<double>::twoPi * static_cast<double>((n + 1) * point) / static_cast<double>(numPoints);
+                cosines[n * numPoints + point] = std::cos(angle);
+                sines[n * numPoints + point] = std::sin(angle);
+            }
+        }
+    }
+
+    // Adds g (cos(nψ) cos φ + sin(nψ) sin φ) = g cos(nψ - φ) for harmonic index n to the waveform
+    void addHarmonic(std::vector<double>& waveform, size_t n, double gain, double phase) const
+    {
+        const double cosineWeight = gain * std::cos(phase), sineWeight = gain * std::sin(phase);
+        const double* c = cosines.data() + n * numPoints;
+        const double* s = sines.data() + n * numPoints;
+        for (size_t point = 0; point < numPoints; ++point)
+            waveform[point] += cosineWeight * c[point] + sineWeight * s[point];
+    }
+
+    std::vector<double> makeWaveform(const std::vector<float>& gains, const std::vector<double>& phases) const
+    {
+        std::vector<double> waveform(numPoints, 0.0);
+        for (size_t n = 0; n < numHarmonics; ++n)
+            addHarmonic(waveform, n, gains[n], phases[n]);
+
+        return waveform;
+    }
+
+    static double getPeak(const std::vector<double>& waveform)
+    {
+        double peak = 0.0;
+        for (double value : waveform)
+            peak = std::max(peak, std::abs(value));
+
+        return peak;
+    }
+
+    size_t numHarmonics, numPoints;
+    std::vector<double> cosines, sines;
+};
+
+} // namespace
+
+//==============================================================================
+PhaseOptimiser::PhaseOptimiser() : juce::Thread("Rosemary phase optimiser")
+{
+    startThread();
+}
+
+PhaseOptimiser::~PhaseOptimiser()
+{
+    stopThread(2000);
+}
+
+void PhaseOptimiser::requestPhases(uint32_t coefficientSetId, const std::vector<float>& harmonicGains)
+{
+    {
+        const juce::ScopedLock scopedLock(lock);
+        requestedGains = harmonicGains;
+        requestedId = coefficientSetId;
+        requestPending = true;
+    }
+
+    notify();
+}
+
+bool PhaseOptimiser::getPhases(uint32_t& coefficientSetId, std::vector<float>& phases)
+{
+    const juce::ScopedLock scopedLock(lock);
+    if (! resultPending)
+        return false;
+
+    coefficientSetId = resultId;
+    phases = resultPhases;
+    resultPending = false;
+    return true;
+}
+
+void PhaseOptimiser::run()
+{
+    while (! threadShouldExit())
+    {
+        std::vector<float> gains;
+        uint32_t id = 0;
+        bool pending = false;
+        {
+            const juce::ScopedLock scopedLock(lock);
+            std::swap(pending, requestPending);
+            gains = requestedGains;
+            id = requestedId;
+        }
+
+        if (! pending)
+        {
+            wait(-1);
+            continue;
+        }
+
+        auto phases = optimisePhases(gains);
+        {
+            const juce::ScopedLock scopedLock(lock);
+
+            // A newer request makes this result stale before anyone could use it
+            if (requestPending)
+                continue;
+
+            resultPhases = std::move(phases);
+            resultId = id;
+            resultPending = true;
+        }
+
+        if (onPhasesReady != nullptr)
+            onPhasesReady();
+    }
+}
+
+std::vector<float> PhaseOptimiser::optimisePhases(const std::vector<float>& harmonicGains)
+{
+    const size_t numHarmonics = harmonicGains.size();
+    const HarmonicGrid grid(numHarmonics);
+
+    // Schroeder's phases, phi_n = -2 pi sum_{l < n} (n - l) p_l with p_l each harmonic's share of the power
+    double totalPower = 0.0;
+    for (float gain : harmonicGains)
+        totalPower += static_cast<double>(gain) * static_cast<double>(gain);
+
+    std::vector<double> phases(numHarmonics, 0.0);
+    if (totalPower > 0.0)
+    {
+        for (size_t n = 1; n < numHarmonics; ++n)
+        {
+            double sum = 0.0;
+            for (size_t l = 0; l < n; ++l)
+                sum += static_cast<double>(n - l) * static_cast<double>(harmonicGains[l]) * static_cast<double>(harmonicGains[l]) / totalPower;
+
+            phases[n] = -juce::MathConstants<double>::twoPi * sum;
+        }
+    }
+
+    // Cosine phase is the starting point instead if it happens to be better, e.g. for a lone fundamental
+    auto waveform = grid.makeWaveform(harmonicGains, phases);
+    double peak = HarmonicGrid::getPeak(waveform);
+    {
+        const std::vector<double> cosinePhases(numHarmonics, 0.0);
+        auto cosineWaveform = grid.makeWaveform(harmonicGains, cosinePhases);
+        const double cosinePeak = HarmonicGrid::getPeak(cosineWaveform);
+        if (cosinePeak <= peak)
+        {
+            phases = cosinePhases;
+            waveform = std::move(cosineWaveform);
+            peak = cosinePeak;
+        }
+    }
+
+    // Coordinate search, swapping one harmonic's contribution to the waveform at a time
+    constexpr int maxPasses = 200;
+    double step = juce::MathConstants<double>::pi / 4.0;
+    std::vector<double> candidate(waveform.size());
+    for (int pass = 0; pass < maxPasses && step > 1.0e-3; ++pass)
+    {
+        bool improved = false;
+        for (size_t n = 1; n < numHarmonics; ++n)
+        {
+            if (harmonicGains[n] == 0.0f)
+                continue;
+
+            for (double direction : { 1.0, -1.0 })
+            {
+                const double newPhase = phases[n] + direction * step;
+                candidate = waveform;
+                grid.addHarmonic(candidate, n, -static_cast<double>(harmonicGains[n]), phases[n]);
+                grid.addHarmonic(candidate, n, harmonicGains[n], newPhase);
+
+                const double candidatePeak = HarmonicGrid::getPeak(candidate);
+                if (candidatePeak < peak)
+                {
+                    std::swap(waveform, candidate);
+                    phases[n] = newPhase;
+                    peak = candidatePeak;
+                    improved = true;
+                    break;
+                }
+            }
+        }
+
+        if (! improved)
+            step *= 0.5;
+    }
+
+    std::vector<float> result(numHarmonics);
+    for (size_t n = 0; n < numHarmonics; ++n)
+        result[n] = static_cast<float>(std::remainder(phases[n], juce::MathConstants<double>::twoPi));
+
+    return result;
+}
+
+float PhaseOptimiser::calculateCrestFactor(const std::vector<float>& harmonicGains, const std::vector<float>& phases)
+{
+    const HarmonicGrid grid(harmonicGains.size());
+    std::vector<double> phasesInDouble(harmonicGains.size(), 0.0);
+    for (size_t n = 0; n < std::min(phases.size(), phasesInDouble.size()); ++n)
+        phasesInDouble[n] = phases[n];
+
+    double power = 0.0;
+    for (float gain : harmonicGains)
+        power += 0.5 * static_cast<double>(gain) * static_cast<double>(gain);
+
+    const double peak = HarmonicGrid::getPeak(grid.makeWaveform(harmonicGains, phasesInDouble));
+    return power > 0.0 ? static_cast<float>(peak / std::sqrt(power)) : 0.0f;
+}
+
+} // namespace rosy
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <vector>
+
+namespace rosy {
+
+/**
+ * @brief Picks phases for a set of harmonic gains that lower the waveform's crest factor, on a background thread.
+ *
+ * The harmonics' levels fix the RMS level of the waveform, so a lower crest factor means a lower peak, and
+ * with the quadrature shaping normalised by the sum of the gains (see
+ * HarmonicProfileCalculator::calculateQuadratureCoefficients()) that peak is headroom each voice gives back
+ * to the bus.
+ *
+ * The search starts from Schroeder's phases for the gains, which spread each harmonic's energy over the
+ * cycle, and then nudges one phase at a time while the peak keeps falling, halving the step whenever a
+ * whole pass finds nothing better. It's deterministic, so the same gains always get the same phases.
+ *
+ * Requests are tagged with the coefficient set id they belong to, and only the newest request is worked
+ * on. onPhasesReady is called on the optimiser's thread when a result is ready to be picked up.
+ */
+class PhaseOptimiser : private juce::Thread
+{
+public:
+    PhaseOptimiser();
+    ~PhaseOptimiser() override;
+
+    //==============================================================================
+    // Replaces any request that hasn't been started yet
+    void requestPhases(uint32_t coefficientSetId, const std::vector<float>& harmonicGains);
+
+    // Takes the newest result if there is one that hasn't been taken yet
+    bool getPhases(uint32_t& coefficientSetId, std::vector<float>& phases);
+
+    std::function<void()> onPhasesReady;
+
+    //==============================================================================
+    // Phases in radians, the fundamental stays at 0
+    static std::vector<float> optimisePhases(const std::vector<float>& harmonicGains);
+
+    // Peak over RMS of sum_n g_n cos(nψ - φ_n), measured on a grid fine enough for the highest harmonic
+    static float calculateCrestFactor(const std::vector<float>& harmonicGains, const std::vector<float>& phases);
+
+private:
+    void run() override;
+
+    juce::CriticalSection lock;
+    std::vector<float> requestedGains;
+    uint32_t requestedId { 0 };
+    bool requestPending { false };
+
+    std::vector<float> resultPhases;
+    uint32_t resultId { 0 };
+    bool resultPending { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PhaseOptimiser)
+};
+
+} // namespace rosy
@@ -15,11 +15,11 @@ RosemaryAudioProcessorEditor::RosemaryAudioProcessorEditor (RosemaryAudioProcess
 {
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
-    setSize (600, 400);
+    setSize (880, 400);
     
     // Make the window resizable with a minimum and maximum size
     setResizable(true, true);
-    setResizeLimits(400, 300, 800, 600);
+    setResizeLimits(640, 300, 1120, 600);
 
     // Common slider settings for all rotary sliders
     auto setupRotarySlider = [](juce::Slider& slider, const juce::String& suffix)
@@ -57,12 +57,120 @@ RosemaryAudioProcessorEditor::RosemaryAudioProcessorEditor (RosemaryAudioProcess
     shapeYSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
         audioProcessor.getParameters(), "shapeY", shapeYSlider);
 
+    setupRotarySlider(shapeXPanSlider, " X Pan");
+    shapeXPanSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "shapeXPan", shapeXPanSlider);
+
+    setupRotarySlider(shapeYPanSlider, " Y Pan");
+    shapeYPanSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "shapeYPan", shapeYPanSlider);
+
+    setupRotarySlider(harmonicDecaySlider, " s Decay");
+    harmonicDecaySlider.setDoubleClickReturnValue(true, 0.0f);
+    harmonicDecaySliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "harmonicDecay", harmonicDecaySlider);
+
+    setupRotarySlider(morphXSlider, " Morph X");
+    morphXSlider.setDoubleClickReturnValue(true, 0.0f);
+    morphXSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "morphX", morphXSlider);
+
+    setupRotarySlider(morphYSlider, " Morph Y");
+    morphYSlider.setDoubleClickReturnValue(true, 0.0f);
+    morphYSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "morphY", morphYSlider);
+
+    // Effect mode controls: input drive into the shaping, and the dry/shaped mix
+    setupRotarySlider(driveSlider, " dB Drive");
+    driveSlider.setDoubleClickReturnValue(true, 0.0f);
+    driveSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "drive", driveSlider);
+
+    setupRotarySlider(mixSlider, " Mix");
+    mixSlider.setDoubleClickReturnValue(true, 1.0f);
+    mixSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "mix", mixSlider);
+
+    // Through-zero FM of the voices' sine: modulator frequency over the note's, and modulation index
+    setupRotarySlider(fmRatioSlider, " FM Ratio");
+    fmRatioSlider.setDoubleClickReturnValue(true, 1.0f);
+    fmRatioSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "fmRatio", fmRatioSlider);
+
+    setupRotarySlider(fmIndexSlider, " FM Index");
+    fmIndexSlider.setDoubleClickReturnValue(true, 0.0f);
+    fmIndexSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "fmIndex", fmIndexSlider);
+
+    setupRotarySlider(driftSlider, " ct Drift");
+    driftSlider.setDoubleClickReturnValue(true, 0.0f);
+    driftSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "drift", driftSlider);
+
+    setupRotarySlider(jitterSlider, " dB Jitter");
+    jitterSlider.setDoubleClickReturnValue(true, 0.0f);
+    jitterSliderAttachment = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(
+        audioProcessor.getParameters(), "jitter", jitterSlider);
+
+    morphButtonAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        audioProcessor.getParameters(), "morph", morphButton);
+
+    mpeButtonAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        audioProcessor.getParameters(), "mpe", mpeButton);
+
+    // The attachments click the buttons for host changes too, so this follows automation and preset loads
+    morphButton.onClick = [this] { updateEnvelopeControls(); };
+    mpeButton.onClick = [this] { updateEnvelopeControls(); };
+    updateEnvelopeControls();
+
+    quadratureButtonAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        audioProcessor.getParameters(), "quadrature", quadratureButton);
+
+    effectButtonAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
+        audioProcessor.getParameters(), "effect", effectButton);
+
+    // Capture isn't saved with the session, so the button just follows the processor
+    captureButton.setToggleState(audioProcessor.getOutputCapture().isCapturing(), juce::dontSendNotification);
+    captureButton.onClick = [this]
+    {
+        auto& capture = audioProcessor.getOutputCapture();
+        if (captureButton.getToggleState())
+            capture.start();
+        else
+            capture.stop();
+    };
+
+    // Store buttons for the morph corners: A at (0, 0), B at (1, 0), C at (0, 1), D at (1, 1)
+    for (size_t index = 0; index < storeSnapshotButtons.size(); ++index)
+    {
+        auto& button = storeSnapshotButtons[index];
+        button.setButtonText("Store " + juce::String::charToString(static_cast<juce::juce_wchar>('A' + index)));
+        button.onClick = [this, index] { audioProcessor.storeMorphSnapshot(static_cast<int>(index)); };
+        addAndMakeVisible(button);
+    }
+
     // Add all sliders to the editor
     addAndMakeVisible(&volSlider);
     addAndMakeVisible(&panSlider);
     addAndMakeVisible(&pitchSlider);
     addAndMakeVisible(&shapeXSlider);
     addAndMakeVisible(&shapeYSlider);
+    addAndMakeVisible(&shapeXPanSlider);
+    addAndMakeVisible(&shapeYPanSlider);
+    addAndMakeVisible(&harmonicDecaySlider);
+    addAndMakeVisible(&morphXSlider);
+    addAndMakeVisible(&morphYSlider);
+    addAndMakeVisible(&driveSlider);
+    addAndMakeVisible(&mixSlider);
+    addAndMakeVisible(&fmRatioSlider);
+    addAndMakeVisible(&fmIndexSlider);
+    addAndMakeVisible(&driftSlider);
+    addAndMakeVisible(&jitterSlider);
+    addAndMakeVisible(&morphButton);
+    addAndMakeVisible(&mpeButton);
+    addAndMakeVisible(&quadratureButton);
+    addAndMakeVisible(&effectButton);
+    addAndMakeVisible(&captureButton);
 
     // Setup harmonics display
     harmonicsLabel.setJustificationType(juce::Justification::left);
@@ -80,6 +188,7 @@ RosemaryAudioProcessorEditor::RosemaryAudioProcessorEditor (RosemaryAudioProcess
     
     setupPeakLabel(preVolumePeakLabel);
     setupPeakLabel(postVolumePeakLabel);
+    setupPeakLabel(loadLabel);
     
     // Start timer to update display (10Hz)
     startTimerHz(10);
@@ -90,14 +199,44 @@ RosemaryAudioProcessorEditor::~RosemaryAudioProcessorEditor()
     stopTimer();
 }
 
+void RosemaryAudioProcessorEditor::updateEnvelopeControls()
+{
+    // The voices render without their envelopes while morphing or with MPE on, so these would do nothing
+    const bool envelopesApply = ! morphButton.getToggleState() && ! mpeButton.getToggleState();
+    harmonicDecaySlider.setEnabled(envelopesApply);
+    jitterSlider.setEnabled(envelopesApply);
+}
+
 void RosemaryAudioProcessorEditor::timerCallback()
 {
-    // Get current gains and format them for display
+    ROSY_TRACE_SCOPE("timerCallback");
+
+    // Only a new coefficient set or a new size needs a new preview
+    if (audioProcessor.getCoefficientSetId() != requestedPreviewId)
+        requestShapePreview();
+
+    const uint32_t readyId = shapePreview.getImageId();
+    if (shapePreview.hasImage() && (readyId != shownPreviewId || previewImage.getBounds() != previewArea.withZeroOrigin()))
+    {
+        // The image is swapped in before its id, so it's never older than readyId
+        shownPreviewId = readyId;
+        auto image = shapePreview.getImage();
+        if (image != previewImage)
+        {
+            previewImage = image;
+            repaint(previewArea);
+        }
+    }
+
+    // Show the target gains next to what the meter measured in the newest note
     const auto& gains = audioProcessor.getCurrentHarmonicGains();
-    juce::String text = "Harmonic Gains:\n";
+    juce::String text = "Harmonic Gains (measured):\n";
     for (size_t i = 0; i < gains.size(); ++i)
     {
         text += "H" + juce::String(i) + ": " + juce::String(gains[i], 3);
+        
+        const float measured = i < rosy::HarmonicMeter<float>::numHarmonics ? audioProcessor.getMeasuredHarmonicLevel(i) : -1.0f;
+        text += measured >= 0.0f ? " (" + juce::String(measured, 3) + ")" : juce::String(" (-)");
         if (i < gains.size() - 1) text += "\n";
     }
     harmonicsLabel.setText(text, juce::dontSendNotification);
@@ -113,7 +252,74 @@ void RosemaryAudioProcessorEditor::timerCallback()
     postVolumeText += juce::String(postVolumeDb, 1) + " dBFS";
     postVolumePeakLabel.setText(postVolumeText, juce::dontSendNotification);
     
-    repaint();  // Ensure the display updates
+    // Update CPU load display, with the 99th percentiles of the histograms since prepareToPlay
+    auto& loadMonitor = audioProcessor.getLoadMonitor();
+    auto formatPercentile = [](float load)
+    {
+        // Past the histogram's last bucket, which collects everything from 150% upwards
+        return std::isinf(load) ? juce::String("150%+") : "<" + juce::String(juce::roundToInt(load * 100.0f)) + "%";
+    };
+    juce::String loadText = "CPU Load: " + juce::String(loadMonitor.getLoad() * 100.0f, 1) + "%"
+                          + " (peak " + juce::String(loadMonitor.getPeakLoad() * 100.0f, 1) + "%, p99 "
+                          + formatPercentile(loadMonitor.getPercentileLoad(0.99f)) + ")\n";
+    for (int stage = 0; stage < rosy::LoadMonitor::numStages; ++stage)
+    {
+        auto stageId = static_cast<rosy::LoadMonitor::Stage>(stage);
+        loadText += juce::String(rosy::LoadMonitor::getStageName(stageId)) + ": "
+                  + juce::String(loadMonitor.getStageLoad(stageId) * 100.0f, 1) + "% (p99 "
+                  + formatPercentile(loadMonitor.getStagePercentileLoad(stageId, 0.99f)) + ")\n";
+    }
+    const auto& governor = audioProcessor.getQualityGovernor();
+    loadText += "Xruns: " + juce::String(static_cast<int>(loadMonitor.getXrunCount()))
+              + ", quality drops: " + juce::String(static_cast<int>(governor.getStepDownCount())) + "\n";
+    loadText += "Quality: " + juce::String(rosy::QualityGovernor::getLevelName(governor.getLevel())) + "\n";
+    loadText += "MPE set hits: " + juce::String(audioProcessor.getCoefficientSetHitRate() * 100.0f, 1) + "%\n";
+    const auto& capture = audioProcessor.getOutputCapture();
+    if (capture.isCapturing())
+        loadText += "Capture: file " + juce::String(capture.getNumFilesWritten())
+                  + ", dropped " + juce::String(capture.getDroppedSamples());
+    else
+        loadText += "Capture: off";
+    const int numImportsPending = audioProcessor.getNumImportsPending();
+    if (numImportsPending > 0)
+        loadText += "\nImport: analysing " + juce::String(numImportsPending);
+    else if (audioProcessor.getLastImportMessage().isNotEmpty())
+        loadText += "\nImport: " + audioProcessor.getLastImportMessage();
+    loadLabel.setText(loadText, juce::dontSendNotification);
+    loadMonitor.requestPeakLoadReset();
+}
+
+void RosemaryAudioProcessorEditor::requestShapePreview()
+{
+    requestedPreviewId = audioProcessor.getCoefficientSetId();
+    if (! previewArea.isEmpty())
+        shapePreview.requestPreview(requestedPreviewId, audioProcessor.getCurrentHarmonicGains(), audioProcessor.getHarmonicPhases(),
+                                    previewArea.getWidth(), previewArea.getHeight());
+}
+
+bool RosemaryAudioProcessorEditor::isInterestedInFileDrag(const juce::StringArray& files)
+{
+    for (const auto& path : files)
+        if (juce::File(path).hasFileExtension("wav;aif;aiff;flac;ogg;mp3"))
+            return true;
+
+    return false;
+}
+
+void RosemaryAudioProcessorEditor::filesDropped(const juce::StringArray& files, int x, int y)
+{
+    // Dropped on a store button fills from that corner, anywhere else from A
+    int firstSnapshot = 0;
+    for (size_t index = 0; index < storeSnapshotButtons.size(); ++index)
+        if (storeSnapshotButtons[index].getBounds().contains(x, y))
+            firstSnapshot = static_cast<int>(index);
+
+    juce::Array<juce::File> audioFiles;
+    for (const auto& path : files)
+        if (juce::File(path).hasFileExtension("wav;aif;aiff;flac;ogg;mp3"))
+            audioFiles.add(juce::File(path));
+
+    audioProcessor.importMorphSnapshots(audioFiles, firstSnapshot);
 }
 
 //==============================================================================
@@ -121,6 +327,10 @@ void RosemaryAudioProcessorEditor::paint (juce::Graphics& g)
 {
     // Fill the background
     g.fillAll(getLookAndFeel().findColour(juce::ResizableWindow::backgroundColourId));
+
+    // Stretched while a preview for a new size is on its way
+    if (previewImage.isValid())
+        g.drawImage(previewImage, previewArea.toFloat());
 }
 
 void RosemaryAudioProcessorEditor::resized()
@@ -135,12 +345,18 @@ void RosemaryAudioProcessorEditor::resized()
     // Layout the meters vertically
     auto preVolumeMeterArea = rightPanel.removeFromTop(40);
     auto postVolumeMeterArea = rightPanel.removeFromTop(40);
+    auto loadArea = rightPanel.removeFromBottom(144);
     auto harmonicsArea = rightPanel;
     
     preVolumePeakLabel.setBounds(preVolumeMeterArea);
     postVolumePeakLabel.setBounds(postVolumeMeterArea);
+    loadLabel.setBounds(loadArea);
     harmonicsLabel.setBounds(harmonicsArea);
 
+    // Shape preview across the top of the controls
+    previewArea = bounds.removeFromTop(80);
+    requestShapePreview();
+
     // Create the main vertical flexbox
     juce::FlexBox mainBox;
     mainBox.flexDirection = juce::FlexBox::Direction::column;
@@ -154,6 +370,11 @@ void RosemaryAudioProcessorEditor::resized()
     topRow.items.add(juce::FlexItem(volSlider).withFlex(1));
     topRow.items.add(juce::FlexItem(panSlider).withFlex(1));
     topRow.items.add(juce::FlexItem(pitchSlider).withFlex(1));
+    topRow.items.add(juce::FlexItem(shapeXPanSlider).withFlex(1));
+    topRow.items.add(juce::FlexItem(shapeYPanSlider).withFlex(1));
+    topRow.items.add(juce::FlexItem(driveSlider).withFlex(1));
+    topRow.items.add(juce::FlexItem(fmRatioSlider).withFlex(1));
+    topRow.items.add(juce::FlexItem(driftSlider).withFlex(1));
 
     // Create bottom row flexbox
     juce::FlexBox bottomRow;
@@ -161,10 +382,29 @@ void RosemaryAudioProcessorEditor::resized()
     bottomRow.justifyContent = juce::FlexBox::JustifyContent::center;
     bottomRow.items.add(juce::FlexItem(shapeXSlider).withFlex(1));
     bottomRow.items.add(juce::FlexItem(shapeYSlider).withFlex(1));
+    bottomRow.items.add(juce::FlexItem(harmonicDecaySlider).withFlex(1));
+    bottomRow.items.add(juce::FlexItem(morphXSlider).withFlex(1));
+    bottomRow.items.add(juce::FlexItem(morphYSlider).withFlex(1));
+    bottomRow.items.add(juce::FlexItem(mixSlider).withFlex(1));
+    bottomRow.items.add(juce::FlexItem(fmIndexSlider).withFlex(1));
+    bottomRow.items.add(juce::FlexItem(jitterSlider).withFlex(1));
+
+    // Create the toggle row: MPE, quadrature, capture, effect, morph on/off and the morph's corner store buttons
+    juce::FlexBox morphRow;
+    morphRow.flexDirection = juce::FlexBox::Direction::row;
+    morphRow.justifyContent = juce::FlexBox::JustifyContent::spaceBetween;
+    morphRow.items.add(juce::FlexItem(mpeButton).withFlex(1));
+    morphRow.items.add(juce::FlexItem(quadratureButton).withFlex(1.5f));
+    morphRow.items.add(juce::FlexItem(captureButton).withFlex(1.2f));
+    morphRow.items.add(juce::FlexItem(effectButton).withFlex(1));
+    morphRow.items.add(juce::FlexItem(morphButton).withFlex(1));
+    for (auto& button : storeSnapshotButtons)
+        morphRow.items.add(juce::FlexItem(button).withFlex(1).withMargin(2));
 
     // Add the rows to the main box with equal flex
     mainBox.items.add(juce::FlexItem(topRow).withFlex(1));
     mainBox.items.add(juce::FlexItem(bottomRow).withFlex(1));
+    mainBox.items.add(juce::FlexItem(morphRow).withHeight(30));
 
     // Perform the layout
     mainBox.performLayout(bounds);
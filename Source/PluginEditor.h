@@ -10,11 +10,13 @@
 
 #include <JuceHeader.h>
 #include "PluginProcessor.h"
+#include "ShapePreview.h"
 
 //==============================================================================
 /**
 */
 class RosemaryAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                     public juce::FileDragAndDropTarget,
                                      public juce::Timer
 {
 public:
@@ -27,8 +29,17 @@ public:
     
     // Timer callback to update the harmonic gains display
     void timerCallback() override;
+    
+    // Recorded notes dropped on the editor become morph snapshots, starting at the corner they're dropped on
+    bool isInterestedInFileDrag (const juce::StringArray& files) override;
+    void filesDropped (const juce::StringArray& files, int x, int y) override;
 
 private:
+    void requestShapePreview();
+
+    // Decay and jitter go through the harmonic envelopes, which morphing and MPE bypass
+    void updateEnvelopeControls();
+
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     RosemaryAudioProcessor& audioProcessor;
@@ -39,10 +50,37 @@ private:
     juce::Slider pitchSlider;
     juce::Slider shapeXSlider;
     juce::Slider shapeYSlider;
+    juce::Slider shapeXPanSlider;
+    juce::Slider shapeYPanSlider;
+    juce::Slider harmonicDecaySlider;
+    juce::Slider morphXSlider;
+    juce::Slider morphYSlider;
+    juce::Slider driveSlider;
+    juce::Slider mixSlider;
+    juce::Slider fmRatioSlider;
+    juce::Slider fmIndexSlider;
+    juce::Slider driftSlider;
+    juce::Slider jitterSlider;
+
+    // Morph on/off and buttons that store the current shape as each corner of the morph
+    juce::ToggleButton morphButton { "Morph" };
+    juce::ToggleButton mpeButton { "MPE" };
+    juce::ToggleButton quadratureButton { "Quadrature" };
+    juce::ToggleButton effectButton { "Effect" };
+    juce::ToggleButton captureButton { "Capture" };  // Records the output to disk, not a parameter
+    std::array<juce::TextButton, rosy::CoefficientMorph<float>::numSnapshots> storeSnapshotButtons;
 
     juce::Label harmonicsLabel;  // Display for harmonic gains
     juce::Label preVolumePeakLabel;   // Display for pre-volume peak level
     juce::Label postVolumePeakLabel;  // Display for post-volume peak level
+    juce::Label loadLabel;            // Display for CPU load and xruns
+
+    // Waveform and transfer curve of the current shape, rendered off the message thread
+    rosy::ShapePreview shapePreview;
+    juce::Image previewImage;
+    juce::Rectangle<int> previewArea;
+    uint32_t requestedPreviewId { 0 };
+    uint32_t shownPreviewId { 0 };
 
     // Slider attachments handle the connections between sliders and parameters
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> volSliderAttachment;
@@ -50,6 +88,21 @@ private:
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> pitchSliderAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> shapeXSliderAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> shapeYSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> shapeXPanSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> shapeYPanSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> harmonicDecaySliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> morphXSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> morphYSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> driveSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> mixSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> fmRatioSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> fmIndexSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> driftSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment> jitterSliderAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> morphButtonAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mpeButtonAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> quadratureButtonAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> effectButtonAttachment;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RosemaryAudioProcessorEditor)
 };
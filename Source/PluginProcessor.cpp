@@ -16,6 +16,9 @@ RosemaryAudioProcessor::RosemaryAudioProcessor()
                      #if ! JucePlugin_IsMidiEffect
                       #if ! JucePlugin_IsSynth
                        .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                      #else
+                       // Only the effect mode uses it, hosts that can route audio into an instrument can enable it
+                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), false)
                       #endif
                        .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
                      #endif
@@ -54,30 +57,370 @@ RosemaryAudioProcessor::RosemaryAudioProcessor()
                 "Shape Y",   // parameter name
                 juce::NormalisableRange<float>(0.0f, 1.0f, 0.005f),  // range with step size
                 0.5f        // default value
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "shapeXPan", // parameter ID
+                "Shape X Pan", // parameter name
+                juce::NormalisableRange<float>(0.0f, 1.0f, 0.005f),  // range with step size
+                0.5f        // default value (center)
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "shapeYPan", // parameter ID
+                "Shape Y Pan", // parameter name
+                juce::NormalisableRange<float>(0.0f, 1.0f, 0.005f),  // range with step size
+                0.5f        // default value (center)
+            ),
+            std::make_unique<juce::AudioParameterChoice>(
+                "antialiasing", // parameter ID
+                "Antialiasing", // parameter name
+                juce::StringArray { "Off", "ADAA 1st order", "ADAA 2nd order" },  // matches MuOscillator::Antialiasing
+                0           // default value (off)
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "harmonicDecay", // parameter ID
+                "Harmonic Decay", // parameter name
+                juce::NormalisableRange<float>(0.0f, 10.0f, 0.01f, 0.3f),  // seconds, skewed towards short decays
+                0.0f        // default value (static spectrum)
+            ),
+            std::make_unique<juce::AudioParameterBool>(
+                "mpe",       // parameter ID
+                "MPE",       // parameter name
+                false        // default value (every note uses the shape knobs)
+            ),
+            std::make_unique<juce::AudioParameterBool>(
+                "morph",     // parameter ID
+                "Morph",     // parameter name
+                false        // default value (use shape X/Y)
+            ),
+            std::make_unique<juce::AudioParameterBool>(
+                "quadrature", // parameter ID
+                "Quadrature", // parameter name
+                false        // default value (harmonics in cosine phase)
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "morphX",    // parameter ID
+                "Morph X",   // parameter name
+                juce::NormalisableRange<float>(0.0f, 1.0f, 0.005f),  // range with step size
+                0.0f        // default value
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "morphY",    // parameter ID
+                "Morph Y",   // parameter name
+                juce::NormalisableRange<float>(0.0f, 1.0f, 0.005f),  // range with step size
+                0.0f        // default value
+            ),
+            std::make_unique<juce::AudioParameterBool>(
+                "effect",    // parameter ID
+                "Effect",    // parameter name
+                false        // default value (play notes, the input is ignored)
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "drive",     // parameter ID
+                "Drive",     // parameter name
+                juce::NormalisableRange<float>(-24.0f, 24.0f, 0.1f),  // dB of input gain into the shaping
+                0.0f        // default value
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "mix",       // parameter ID
+                "Mix",       // parameter name
+                juce::NormalisableRange<float>(0.0f, 1.0f, 0.005f),  // dry to shaped
+                1.0f        // default value (fully shaped)
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "fmRatio",   // parameter ID
+                "FM Ratio",  // parameter name
+                juce::NormalisableRange<float>(0.25f, 8.0f, 0.25f),  // modulator over carrier frequency, whole steps stay harmonic
+                1.0f        // default value
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "fmIndex",   // parameter ID
+                "FM Index",  // parameter name
+                juce::NormalisableRange<float>(0.0f, 10.0f, 0.01f, 0.5f),  // peak deviation over modulator frequency
+                0.0f        // default value (no modulation)
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "drift",     // parameter ID
+                "Drift",     // parameter name
+                juce::NormalisableRange<float>(0.0f, 25.0f, 0.1f, 0.5f),  // cents either way, skewed towards subtle
+                0.0f        // default value (steady pitch)
+            ),
+            std::make_unique<juce::AudioParameterFloat>(
+                "jitter",    // parameter ID
+                "Jitter",    // parameter name
+                juce::NormalisableRange<float>(0.0f, 6.0f, 0.05f, 0.5f),  // dB either way on each harmonic
+                0.0f        // default value (steady harmonics)
+            ),
+            std::make_unique<juce::AudioParameterInt>(
+                "driftSeed", // parameter ID
+                "Drift Seed", // parameter name
+                1, 9999,     // range
+                1            // default value
             )
         })
 {
     // Get pointers to the atomic parameters for real-time audio processing
     volumeParameter = parameters.getRawParameterValue("volume");
     panParameter = parameters.getRawParameterValue("pan");
+    morphParameter = parameters.getRawParameterValue("morph");
+    morphXParameter = parameters.getRawParameterValue("morphX");
+    morphYParameter = parameters.getRawParameterValue("morphY");
+    quadratureParameter = parameters.getRawParameterValue("quadrature");
+    effectParameter = parameters.getRawParameterValue("effect");
+    driveParameter = parameters.getRawParameterValue("drive");
+    mixParameter = parameters.getRawParameterValue("mix");
+    fmRatioParameter = parameters.getRawParameterValue("fmRatio");
+    fmIndexParameter = parameters.getRawParameterValue("fmIndex");
+    driftParameter = parameters.getRawParameterValue("drift");
+    jitterParameter = parameters.getRawParameterValue("jitter");
+    driftSeedParameter = parameters.getRawParameterValue("driftSeed");
+    
+    // Optimised phases are handed over on the message thread, together with any quality change
+    phaseOptimiser.onPhasesReady = [this] { triggerAsyncUpdate(); };
+    resynthesisImporter.onResultsReady = [this] { triggerAsyncUpdate(); };
+
+    // Put the engine's default morph corners into the state so they're saved with it
+    for (int index = 0; index < rosy::CoefficientMorph<float>::numSnapshots; ++index)
+        setMorphSnapshot(index, floatChain.voiceEngine.getMorph().getSnapshotGains(index));
 
     // Add listeners for shape parameters
     parameters.addParameterListener("shapeX", this);
     parameters.addParameterListener("shapeY", this);
+    parameters.addParameterListener("shapeXPan", this);
+    parameters.addParameterListener("shapeYPan", this);
+    parameters.addParameterListener("antialiasing", this);
+    parameters.addParameterListener("harmonicDecay", this);
+    parameters.addParameterListener("mpe", this);
+    parameters.addParameterListener("quadrature", this);
+    parameters.addParameterListener("effect", this);
+    
+    updateExciterShape();
 }
 
 RosemaryAudioProcessor::~RosemaryAudioProcessor()
 {
+    cancelPendingUpdate();
     parameters.removeParameterListener("shapeX", this);
     parameters.removeParameterListener("shapeY", this);
+    parameters.removeParameterListener("shapeXPan", this);
+    parameters.removeParameterListener("shapeYPan", this);
+    parameters.removeParameterListener("antialiasing", this);
+    parameters.removeParameterListener("harmonicDecay", this);
+    parameters.removeParameterListener("mpe", this);
+    parameters.removeParameterListener("quadrature", this);
+    parameters.removeParameterListener("effect", this);
 }
 
 void RosemaryAudioProcessor::parameterChanged(const juce::String& parameterID, float newValue)
 {
+    ROSY_TRACE_SCOPE("parameterChanged");
+
     if (parameterID == "shapeX")
-        muOscillator.setShapeX(newValue);
+    {
+        floatChain.voiceEngine.setShapeX(newValue);
+        doubleChain.voiceEngine.setShapeX(newValue);
+        updateExciterShape();
+        requestHarmonicPhases();
+    }
     else if (parameterID == "shapeY")
-        muOscillator.setShapeY(newValue);
+    {
+        floatChain.voiceEngine.setShapeY(newValue);
+        doubleChain.voiceEngine.setShapeY(newValue);
+        updateExciterShape();
+        requestHarmonicPhases();
+    }
+    else if (parameterID == "shapeXPan")
+    {
+        floatChain.voiceEngine.setShapeXPan(newValue);
+        doubleChain.voiceEngine.setShapeXPan(newValue);
+    }
+    else if (parameterID == "shapeYPan")
+    {
+        floatChain.voiceEngine.setShapeYPan(newValue);
+        doubleChain.voiceEngine.setShapeYPan(newValue);
+    }
+    else if (parameterID == "antialiasing")
+    {
+        // Choice parameters report their index
+        floatChain.voiceEngine.setAntialiasing(static_cast<rosy::MuOscillator<float>::Antialiasing>(juce::roundToInt(newValue)));
+        doubleChain.voiceEngine.setAntialiasing(static_cast<rosy::MuOscillator<double>::Antialiasing>(juce::roundToInt(newValue)));
+        floatChain.exciter.setAntialiasing(static_cast<rosy::MuOscillator<float>::Antialiasing>(juce::roundToInt(newValue)));
+        doubleChain.exciter.setAntialiasing(static_cast<rosy::MuOscillator<double>::Antialiasing>(juce::roundToInt(newValue)));
+        
+        // The effect mode's latency depends on the order
+        triggerAsyncUpdate();
+    }
+    else if (parameterID == "harmonicDecay")
+    {
+        floatChain.voiceEngine.setHarmonicDecay(newValue);
+        doubleChain.voiceEngine.setHarmonicDecay(newValue);
+    }
+    else if (parameterID == "mpe")
+    {
+        floatChain.voiceEngine.setMpeEnabled(newValue >= 0.5f);
+        doubleChain.voiceEngine.setMpeEnabled(newValue >= 0.5f);
+    }
+    else if (parameterID == "quadrature")
+    {
+        requestHarmonicPhases();
+    }
+    else if (parameterID == "effect")
+    {
+        triggerAsyncUpdate();
+    }
+}
+
+void RosemaryAudioProcessor::updateExciterShape()
+{
+    // The voices have just worked out the gains for the new shape
+    const auto& gains = floatChain.voiceEngine.getCurrentHarmonicGains();
+    floatChain.exciter.setHarmonicGains(gains);
+    doubleChain.exciter.setHarmonicGains(gains);
+}
+
+void RosemaryAudioProcessor::requestHarmonicPhases()
+{
+    // Parameters can change on any thread, the phases are only ever set from handleAsyncUpdate()
+    if (quadratureParameter->load() >= 0.5f)
+        phaseOptimiser.requestPhases(getCoefficientSetId(), getCurrentHarmonicGains());
+    else
+        triggerAsyncUpdate();
+}
+
+void RosemaryAudioProcessor::handleAsyncUpdate()
+{
+    // Phases worked out for a shape that has since changed, or with quadrature since switched off, are dropped
+    uint32_t phasesId = 0;
+    std::vector<float> phases;
+    if (phaseOptimiser.getPhases(phasesId, phases) && phasesId == getCoefficientSetId() && quadratureParameter->load() >= 0.5f)
+    {
+        floatChain.voiceEngine.setHarmonicPhases(phases);
+        doubleChain.voiceEngine.setHarmonicPhases(phases);
+    }
+    else if (quadratureParameter->load() < 0.5f && ! floatChain.voiceEngine.getHarmonicPhases().empty())
+    {
+        floatChain.voiceEngine.setHarmonicPhases({});
+        doubleChain.voiceEngine.setHarmonicPhases({});
+    }
+    
+    // Imported profiles go through the same snapshot handover as stored ones
+    for (auto& import : resynthesisImporter.takeResults())
+    {
+        const auto name = import.file.getFileNameWithoutExtension();
+        if (! import.result.succeeded)
+        {
+            lastImportMessage = name + ": " + import.result.error;
+            continue;
+        }
+        
+        const int index = import.target % rosy::CoefficientMorph<float>::numSnapshots;
+        setMorphSnapshot(index, import.result.harmonicGains);
+        lastImportMessage = name + " " + juce::String(import.result.fundamental, 1) + " Hz in " + juce::String::charToString(static_cast<juce::juce_wchar>('A' + index));
+        
+        // The first file of a drop is put under the morph position, so the next note plays it
+        if (import.firstOfBatch)
+        {
+            auto setParameter = [this](const char* parameterID, float value)
+            {
+                auto* parameter = parameters.getParameter(parameterID);
+                parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+            };
+            
+            setParameter("morph", 1.0f);
+            setParameter("morphX", static_cast<float>(index % 2));
+            setParameter("morphY", static_cast<float>(index / 2));
+        }
+    }
+    
+    updateLatency();
+    
+    // The rest of the governor's level is applied on the audio thread, see processSamples(). The shorter sets
+    // are worked out here and reach the voices through the same handovers as a change of shape.
+    const auto harmonicLimit = rosy::QualityGovernor::getHarmonicLimit(qualityGovernor.getLevel(), rosy::MuOscillator<float>::numHarmonics);
+    if (harmonicLimit == appliedHarmonicLimit)
+        return;
+    
+    appliedHarmonicLimit = harmonicLimit;
+    floatChain.voiceEngine.setHarmonicLimit(harmonicLimit);
+    doubleChain.voiceEngine.setHarmonicLimit(harmonicLimit);
+}
+
+void RosemaryAudioProcessor::updateLatency()
+{
+    // Only the effect mode delays anything the host needs to line up
+    const int latency = effectParameter->load() >= 0.5f ? floatChain.exciter.getLatencySamples() : 0;
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
+}
+
+float RosemaryAudioProcessor::getMeasuredHarmonicLevel(size_t harmonic) const
+{
+    auto relativeLevel = [harmonic](const auto& meter)
+    {
+        const float fundamental = meter.getLevel(0);
+        if (! meter.hasMeasurement() || fundamental <= 0.0f)
+            return -1.0f;
+        
+        return meter.getLevel(harmonic) / fundamental;
+    };
+    
+    return isUsingDoublePrecision() ? relativeLevel(doubleChain.voiceEngine.getHarmonicMeter())
+                                    : relativeLevel(floatChain.voiceEngine.getHarmonicMeter());
+}
+
+void RosemaryAudioProcessor::storeMorphSnapshot(int index)
+{
+    setMorphSnapshot(index, getCurrentHarmonicGains());
+}
+
+void RosemaryAudioProcessor::importMorphSnapshots(const juce::Array<juce::File>& files, int firstSnapshot)
+{
+    resynthesisImporter.analyse(files, firstSnapshot);
+}
+
+void RosemaryAudioProcessor::setMorphSnapshot(int index, const std::vector<float>& harmonicGains)
+{
+    floatChain.voiceEngine.getMorph().setSnapshot(index, harmonicGains);
+    doubleChain.voiceEngine.getMorph().setSnapshot(index, harmonicGains);
+
+    // Snapshots live in the state tree as space separated gains
+    juce::StringArray gainStrings;
+    for (float gain : harmonicGains)
+        gainStrings.add(juce::String(gain));
+
+    auto snapshots = parameters.state.getOrCreateChildWithName("MORPH", nullptr);
+    auto snapshot = snapshots.getChildWithProperty("index", index);
+    if (! snapshot.isValid())
+    {
+        snapshot = juce::ValueTree("SNAPSHOT");
+        snapshot.setProperty("index", index, nullptr);
+        snapshots.appendChild(snapshot, nullptr);
+    }
+
+    snapshot.setProperty("gains", gainStrings.joinIntoString(" "), nullptr);
+}
+
+void RosemaryAudioProcessor::loadMorphSnapshotsFromState()
+{
+    const auto snapshots = parameters.state.getChildWithName("MORPH");
+    
+    for (int index = 0; index < rosy::CoefficientMorph<float>::numSnapshots; ++index)
+    {
+        const auto snapshot = snapshots.getChildWithProperty("index", index);
+        
+        // States saved before the morph existed keep the current snapshots
+        std::vector<float> harmonicGains;
+        if (snapshot.isValid())
+        {
+            for (const auto& gain : juce::StringArray::fromTokens(snapshot.getProperty("gains").toString(), false))
+                harmonicGains.push_back(gain.getFloatValue());
+        }
+        else
+        {
+            harmonicGains = floatChain.voiceEngine.getMorph().getSnapshotGains(index);
+        }
+        
+        setMorphSnapshot(index, harmonicGains);
+    }
 }
 
 //==============================================================================
@@ -115,7 +458,8 @@ bool RosemaryAudioProcessor::isMidiEffect() const
 
 double RosemaryAudioProcessor::getTailLengthSeconds() const
 {
-    return 0.0;
+    // Released notes ring on for the envelope's release, after that the output is silent
+    return rosy::MuVoice<float>::releaseSeconds;
 }
 
 int RosemaryAudioProcessor::getNumPrograms()
@@ -148,26 +492,44 @@ void RosemaryAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlo
     // Calculate phase increment for our sawtooth
     phaseIncrement = frequency / sampleRate;
 
-    // Prepare MuOscillator
+    // Prepare the voices, everything after the MIDI works in sub-blocks so that's the largest block they see
     juce::dsp::ProcessSpec spec;
     spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = samplesPerBlock;
+    spec.maximumBlockSize = static_cast<juce::uint32>(subBlockSize);
     spec.numChannels = getTotalNumOutputChannels();
     
-    muOscillator.prepare(spec);
-    muOscillator.setFrequency(static_cast<float>(frequency));
+    // Both precisions are kept ready, the host can switch between them without another prepareToPlay
+    scratchArena.reset();
+    floatChain.prepare(spec, scratchArena);
+    doubleChain.prepare(spec, scratchArena);
     
-    // Prepare peak level calculators
-    preVolumePeakCalculator.prepare(spec);
-    postVolumePeakCalculator.prepare(spec);
+    // Play both chains once so the first block after loading runs as fast as the rest, then prepare again to
+    // start clean. The arena hands out the same memory the second time, so it stays in the cache.
+    floatChain.warmUp(spec);
+    doubleChain.warmUp(spec);
+    scratchArena.reset();
+    floatChain.prepare(spec, scratchArena);
+    doubleChain.prepare(spec, scratchArena);
+    
+    loadMonitor.prepare(sampleRate);
+    outputCapture.prepare(sampleRate, getTotalNumOutputChannels());
+    
+    // Every prepare starts again from full quality; the chains re-apply the level from their first block.
+    // prepareToPlay isn't always called on the message thread, so only the latency, which the host reads
+    // straight after, is reported here. The harmonic limit, phases and imports are left to the async update.
+    qualityGovernor.prepare(sampleRate);
+    updateLatency();
+    triggerAsyncUpdate();
 }
 
 void RosemaryAudioProcessor::releaseResources()
 {
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
-    preVolumePeakCalculator.reset();
-    postVolumePeakCalculator.reset();
+    floatChain.preVolumePeakCalculator.reset();
+    floatChain.postVolumePeakCalculator.reset();
+    doubleChain.preVolumePeakCalculator.reset();
+    doubleChain.postVolumePeakCalculator.reset();
 }
 
 #ifndef JucePlugin_PreferredChannelConfigurations
@@ -177,17 +539,18 @@ bool RosemaryAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts)
     juce::ignoreUnused (layouts);
     return true;
   #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Anything from mono up to 7.1.4. Wider than stereo, the synth plays the same mono signal on every channel,
+    // while the effect mode shapes each channel separately.
+    const auto& output = layouts.getMainOutputChannelSet();
+    if (output.isDisabled() || static_cast<size_t>(output.size()) > rosy::HarmonicExciter<float>::maxChannels)
         return false;
 
-    // This checks if the input layout matches the output layout
+    // This checks if the input layout matches the output layout, the synth's input can also be left off
    #if ! JucePlugin_IsSynth
-    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
+    if (output != layouts.getMainInputChannelSet())
+        return false;
+   #else
+    if (! layouts.getMainInputChannelSet().isDisabled() && output != layouts.getMainInputChannelSet())
         return false;
    #endif
 
@@ -209,8 +572,72 @@ float RosemaryAudioProcessor::getNextSample()
 }
 
 void RosemaryAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples (buffer, midiMessages, floatChain);
+}
+
+void RosemaryAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples (buffer, midiMessages, doubleChain);
+}
+
+template <typename SampleType>
+void RosemaryAudioProcessor::RenderChain<SampleType>::prepare (const juce::dsp::ProcessSpec& spec, rosy::ScratchArena& arena)
+{
+    voiceEngine.prepare(spec, arena);
+    exciter.prepare(spec, arena);
+    
+    // Prepare peak level calculators
+    preVolumePeakCalculator.prepare(spec);
+    postVolumePeakCalculator.prepare(spec);
+    samplesSincePeakReset = 0;
+    appliedQualityLevel = -1;
+    
+    // Short enough to follow fast automation, long enough that pad moves don't click
+    morphX.reset(spec.sampleRate, 0.02);
+    morphY.reset(spec.sampleRate, 0.02);
+    morphPositionsX = arena.allocate<SampleType>(spec.maximumBlockSize);
+    morphPositionsY = arena.allocate<SampleType>(spec.maximumBlockSize);
+    
+    numOutputChannels = spec.numChannels;
+    outputChannels = arena.allocate<SampleType*>(numOutputChannels);
+    for (size_t channel = 0; channel < numOutputChannels; ++channel)
+        outputChannels[channel] = arena.allocate<SampleType>(spec.maximumBlockSize);
+}
+
+template <typename SampleType>
+void RosemaryAudioProcessor::RenderChain<SampleType>::warmUp (const juce::dsp::ProcessSpec& spec)
 {
     juce::ScopedNoDenormals noDenormals;
+    const int numSamples = static_cast<int>(spec.maximumBlockSize);
+    juce::dsp::AudioBlock<SampleType> block(outputChannels, numOutputChannels, spec.maximumBlockSize);
+    juce::dsp::ProcessContextReplacing<SampleType> context(block);
+    
+    juce::MidiBuffer notes;
+    for (const int noteNumber : { 48, 55, 60, 64 })
+        notes.addEvent(juce::MidiMessage::noteOn(1, noteNumber, 0.8f), 0);
+    
+    // The voices with the shape, then morphing, then skipped, the same as the three ways processBlock takes them
+    voiceEngine.process(block, notes, 0, numSamples);
+    std::fill(morphPositionsX, morphPositionsX + numSamples, SampleType(0.5));
+    std::fill(morphPositionsY, morphPositionsY + numSamples, SampleType(0.5));
+    voiceEngine.process(block, juce::MidiBuffer(), 0, numSamples, morphPositionsX, morphPositionsY);
+    voiceEngine.skip(numSamples, juce::MidiBuffer());
+    
+    preVolumePeakCalculator.process(context);
+    postVolumePeakCalculator.processSilence(numSamples);
+    rosy::VoiceEngine<SampleType>::applyVolumeAndPan(block, SampleType(0.5), SampleType(0));
+    exciter.process(block);
+}
+
+template <typename SampleType>
+void RosemaryAudioProcessor::processSamples (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages,
+                                             RenderChain<SampleType>& chain)
+{
+    ROSY_TRACE_SCOPE("processBlock");
+    juce::ScopedNoDenormals noDenormals;
+    loadMonitor.beginBlock(buffer.getNumSamples());
+    
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -218,48 +645,140 @@ void RosemaryAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juc
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    const float currentVol = *volumeParameter;
-    const float pan = *panParameter;
+    const auto currentVol = static_cast<SampleType>(volumeParameter->load());
+    const auto pan = static_cast<SampleType>(panParameter->load());
 
-    // Create an audio block and context for processing
-    juce::dsp::AudioBlock<float> block(buffer);
-    juce::dsp::ProcessContextReplacing<float> context(block);
+    // Create an audio block for the host's buffer
+    juce::dsp::AudioBlock<SampleType> block(buffer);
+    const int numSamples = buffer.getNumSamples();
     
-    // Process the oscillator
-    muOscillator.process(context);
+    // The voices smooth the index themselves, per sample, skipped or rendered
+    chain.voiceEngine.setFrequencyModulation(fmRatioParameter->load(), fmIndexParameter->load());
+    chain.voiceEngine.setAnalogDrift(driftParameter->load(), jitterParameter->load(),
+                                     static_cast<uint32_t>(juce::roundToInt(driftSeedParameter->load())));
     
-    // Measure pre-volume peak level
-    preVolumePeakCalculator.process(context);
+    // The governor's anti-aliasing order and voice limit go to the voices here, like every other per-block
+    // setting, so a step down never touches the voices from another thread while they're rendering
+    const auto qualityLevel = qualityGovernor.getLevel();
+    if (qualityLevel != chain.appliedQualityLevel)
+    {
+        chain.voiceEngine.setMaxAntialiasingOrder(rosy::QualityGovernor::getMaxAntialiasingOrder(qualityLevel));
+        chain.voiceEngine.setVoiceLimit(rosy::QualityGovernor::getVoiceLimit(qualityLevel, rosy::VoiceEngine<SampleType>::maxVoices));
+        chain.appliedQualityLevel = qualityLevel;
+    }
     
-    // Apply volume and panning
-    if (totalNumOutputChannels == 2)
+    if (effectParameter->load() >= 0.5f)
     {
-        // Equal power panning using sin/cos for stereo
-        const float panRadians = pan * juce::MathConstants<float>::halfPi;
-        const float leftGain = std::cos(panRadians) * currentVol;
-        const float rightGain = std::sin(panRadians) * currentVol;
-
-        buffer.applyGain(0, 0, buffer.getNumSamples(), leftGain);
-        buffer.applyGain(1, 0, buffer.getNumSamples(), rightGain);
+        // The notes carry on silently, so they're in the right place if the mode is switched back
+        chain.voiceEngine.skip(numSamples, midiMessages);
+        chain.morphX.skip(numSamples);
+        chain.morphY.skip(numSamples);
+        chain.exciter.setDrive(driveParameter->load());
+        chain.exciter.setMix(mixParameter->load());
+        
+        // The input is shaped in place in the host's buffer. Drive and mix set the level, so volume and pan,
+        // which are the synth's, are left out and both meters read the shaped output.
+        for (int start = 0; start < numSamples; start += subBlockSize)
+        {
+            const int length = std::min(subBlockSize, numSamples - start);
+            auto subBlock = block.getSubBlock(static_cast<size_t>(start), static_cast<size_t>(length));
+            juce::dsp::ProcessContextReplacing<SampleType> context(subBlock);
+            
+            chain.exciter.process(subBlock);
+            loadMonitor.endStage(rosy::LoadMonitor::oscillator);
+            
+            chain.preVolumePeakCalculator.process(context);
+            chain.postVolumePeakCalculator.process(context);
+            loadMonitor.endStage(rosy::LoadMonitor::meters);
+        }
+    }
+    else if (chain.voiceEngine.isSilentFor(midiMessages) || currentVol == 0)
+    {
+        // Nothing audible will come out, so keep the notes moving without rendering them.
+        // clear() also flags the buffer as silent for wrappers that pass that on to the host.
+        chain.voiceEngine.skip(numSamples, midiMessages);
+        chain.morphX.skip(numSamples);
+        chain.morphY.skip(numSamples);
+        buffer.clear();
+        loadMonitor.endStage(rosy::LoadMonitor::oscillator);
+        
+        // The meters only need to fall, the pre-volume one reads silence while muted
+        chain.preVolumePeakCalculator.processSilence(numSamples);
+        chain.postVolumePeakCalculator.processSilence(numSamples);
+        loadMonitor.endStage(rosy::LoadMonitor::meters);
     }
     else
     {
-        // For mono, just apply volume
-        buffer.applyGain(currentVol);
+        // The voices morph if the morph is on, otherwise they use the shape gains
+        chain.morphX.setTargetValue(static_cast<SampleType>(morphXParameter->load()));
+        chain.morphY.setTargetValue(static_cast<SampleType>(morphYParameter->load()));
+        const bool morphing = morphParameter->load() >= 0.5f;
+        
+        if (! morphing)
+        {
+            chain.morphX.setCurrentAndTargetValue(chain.morphX.getTargetValue());
+            chain.morphY.setCurrentAndTargetValue(chain.morphY.getTargetValue());
+        }
+        
+        // Every sub-block but the last is full size; the last takes whatever the host block has left, so
+        // there's no added latency
+        const size_t numChannels = std::min(block.getNumChannels(), chain.numOutputChannels);
+        for (int start = 0; start < numSamples; start += subBlockSize)
+        {
+            const int length = std::min(subBlockSize, numSamples - start);
+            juce::dsp::AudioBlock<SampleType> subBlock(chain.outputChannels, numChannels, static_cast<size_t>(length));
+            juce::dsp::ProcessContextReplacing<SampleType> context(subBlock);
+            
+            // Fill in this sub-block's morph positions
+            const SampleType* morphX = nullptr;
+            const SampleType* morphY = nullptr;
+            if (morphing)
+            {
+                for (int sample = 0; sample < length; ++sample)
+                {
+                    chain.morphPositionsX[sample] = chain.morphX.getNextValue();
+                    chain.morphPositionsY[sample] = chain.morphY.getNextValue();
+                }
+                
+                morphX = chain.morphPositionsX;
+                morphY = chain.morphPositionsY;
+            }
+            
+            // Render the voices, handling the sub-block's share of the MIDI
+            chain.voiceEngine.process(subBlock, midiMessages, start, numSamples, morphX, morphY);
+            loadMonitor.endStage(rosy::LoadMonitor::oscillator);
+            
+            // Measure pre-volume peak level
+            chain.preVolumePeakCalculator.process(context);
+            loadMonitor.endStage(rosy::LoadMonitor::meters);
+            
+            // Apply volume and panning, and hand the sub-block to the host
+            rosy::VoiceEngine<SampleType>::applyVolumeAndPan(subBlock, currentVol, pan);
+            block.getSubBlock(static_cast<size_t>(start), static_cast<size_t>(length)).copyFrom(subBlock);
+            loadMonitor.endStage(rosy::LoadMonitor::gain);
+            
+            // Measure post-volume peak level
+            chain.postVolumePeakCalculator.process(context);
+            loadMonitor.endStage(rosy::LoadMonitor::meters);
+        }
     }
     
-    // Measure post-volume peak level
-    postVolumePeakCalculator.process(context);
+    // Only a copy into the capture's FIFO, the disk is written from another thread
+    outputCapture.push(buffer.getArrayOfReadPointers(), buffer.getNumChannels(), numSamples);
     
     // Reset peak meters every second (assuming 10Hz refresh rate in the UI)
-    static int sampleCount = 0;
-    sampleCount += buffer.getNumSamples();
-    if (sampleCount >= getSampleRate() / 10)
+    chain.samplesSincePeakReset += buffer.getNumSamples();
+    if (chain.samplesSincePeakReset >= getSampleRate() / 10)
     {
-        preVolumePeakCalculator.resetPeak();
-        postVolumePeakCalculator.resetPeak();
-        sampleCount = 0;
+        chain.preVolumePeakCalculator.resetPeak();
+        chain.postVolumePeakCalculator.resetPeak();
+        chain.samplesSincePeakReset = 0;
     }
+    
+    // Offline renders have no deadline to meet, so they always get full quality
+    const float blockLoad = loadMonitor.endBlock();
+    if (! isNonRealtime() && qualityGovernor.update(blockLoad, buffer.getNumSamples()))
+        triggerAsyncUpdate();
 }
 
 //==============================================================================
@@ -276,15 +795,21 @@ juce::AudioProcessorEditor* RosemaryAudioProcessor::createEditor()
 //==============================================================================
 void RosemaryAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
+    // Store the parameters as XML, this is also the state blob the offline renderer reads
+    auto state = parameters.copyState();
+    std::unique_ptr<juce::XmlElement> xml (state.createXml());
+    copyXmlToBinary (*xml, destData);
 }
 
 void RosemaryAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
+    // Replacing the state notifies the parameter listeners, so the voices pick up the stored shape
+    std::unique_ptr<juce::XmlElement> xmlState (getXmlFromBinary (data, sizeInBytes));
+    if (xmlState != nullptr && xmlState->hasTagName (parameters.state.getType()))
+    {
+        parameters.replaceState (juce::ValueTree::fromXml (*xmlState));
+        loadMorphSnapshotsFromState();
+    }
 }
 
 //==============================================================================
@@ -9,14 +9,23 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include "MuOscillator.h"
+#include "VoiceEngine.h"
 #include "DbCalculator.h"
+#include "LoadMonitor.h"
+#include "ScratchArena.h"
+#include "QualityGovernor.h"
+#include "TraceRecorder.h"
+#include "PhaseOptimiser.h"
+#include "OutputCapture.h"
+#include "HarmonicExciter.h"
+#include "ResynthesisImporter.h"
 
 //==============================================================================
 /**
 */
 class RosemaryAudioProcessor  : public juce::AudioProcessor,
-                               public juce::AudioProcessorValueTreeState::Listener
+                               public juce::AudioProcessorValueTreeState::Listener,
+                               private juce::AsyncUpdater
 {
 public:
     //==============================================================================
@@ -35,6 +44,9 @@ public:
    #endif
 
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override { return true; }
+    bool supportsMPE() const override { return true; }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override;
@@ -63,11 +75,44 @@ public:
     float getVolume() const { return *volumeParameter; }
     
     // Get current harmonic gains for display
-    const std::vector<float>& getCurrentHarmonicGains() const { return muOscillator.getCurrentHarmonicGains(); }
+    const std::vector<float>& getCurrentHarmonicGains() const { return floatChain.voiceEngine.getCurrentHarmonicGains(); }
+    uint32_t getCoefficientSetId() const { return floatChain.voiceEngine.getCoefficientSetId(); }
     
-    // Get current peak levels in dB
-    float getCurrentPreVolumeDb() const { return preVolumePeakCalculator.getPeakDb(); }
-    float getCurrentPostVolumeDb() const { return postVolumePeakCalculator.getPeakDb(); }
+    // Phase of each harmonic in radians while quadrature is on, empty in cosine phase
+    const std::vector<float>& getHarmonicPhases() const { return floatChain.voiceEngine.getHarmonicPhases(); }
+    
+    // Get current peak levels in dB, from whichever precision the host is running
+    float getCurrentPreVolumeDb() const { return isUsingDoublePrecision() ? doubleChain.preVolumePeakCalculator.getPeakDb()
+                                                                          : floatChain.preVolumePeakCalculator.getPeakDb(); }
+    float getCurrentPostVolumeDb() const { return isUsingDoublePrecision() ? doubleChain.postVolumePeakCalculator.getPeakDb()
+                                                                           : floatChain.postVolumePeakCalculator.getPeakDb(); }
+    
+    // Measured level of a harmonic of the newest note relative to its fundamental, or -1 before there's a measurement
+    float getMeasuredHarmonicLevel (size_t harmonic) const;
+    
+    // Fraction of per-note shape lookups that found a set already calculated, from whichever precision is running
+    float getCoefficientSetHitRate() const { return isUsingDoublePrecision() ? doubleChain.voiceEngine.getCoefficientSetPool().getHitRate()
+                                                                             : floatChain.voiceEngine.getCoefficientSetPool().getHitRate(); }
+    
+    // Stores the current harmonic profile as one of the morph's corner snapshots, message thread only
+    void storeMorphSnapshot (int index);
+    
+    // Per-stage CPU load and deadline misses, readable from any thread
+    rosy::LoadMonitor& getLoadMonitor() { return loadMonitor; }
+    
+    // The quality level the CPU load has forced, readable from any thread
+    const rosy::QualityGovernor& getQualityGovernor() const { return qualityGovernor; }
+    
+    // Records the output to disk for QA, started and stopped from the message thread
+    rosy::OutputCapture& getOutputCapture() { return outputCapture; }
+    
+    // Analyses recorded notes in the background and stores their profiles as morph snapshots, the first file
+    // at firstSnapshot and the rest in the corners after it. Message thread only.
+    void importMorphSnapshots (const juce::Array<juce::File>& files, int firstSnapshot);
+    
+    // Files still being analysed, and what happened to the last one that finished
+    int getNumImportsPending() const { return resynthesisImporter.getNumPending(); }
+    const juce::String& getLastImportMessage() const { return lastImportMessage; }
 
 private:
     //==============================================================================
@@ -77,6 +122,18 @@ private:
     // References to parameters for real-time audio processing
     std::atomic<float>* volumeParameter = nullptr;
     std::atomic<float>* panParameter = nullptr;
+    std::atomic<float>* morphParameter = nullptr;
+    std::atomic<float>* morphXParameter = nullptr;
+    std::atomic<float>* morphYParameter = nullptr;
+    std::atomic<float>* quadratureParameter = nullptr;
+    std::atomic<float>* effectParameter = nullptr;
+    std::atomic<float>* driveParameter = nullptr;
+    std::atomic<float>* mixParameter = nullptr;
+    std::atomic<float>* fmRatioParameter = nullptr;
+    std::atomic<float>* fmIndexParameter = nullptr;
+    std::atomic<float>* driftParameter = nullptr;
+    std::atomic<float>* jitterParameter = nullptr;
+    std::atomic<float>* driftSeedParameter = nullptr;
 
     // Oscillator state
     double currentPhase = 0.0;
@@ -84,12 +141,93 @@ private:
     const double frequency = 500.0; // Hz
     float getNextSample();  // Returns sawtooth wave
 
-    // MuOscillator
-    rosy::MuOscillator muOscillator;
+    // Everything that renders audio exists once per sample type, the host picks which one runs
+    template <typename SampleType>
+    struct RenderChain
+    {
+        void prepare (const juce::dsp::ProcessSpec& spec, rosy::ScratchArena& arena);
+        
+        // Renders a few notes through every stage, so the first real block doesn't run cold code or lazily bind
+        // maths functions. Leaves the chain in any state, so prepare() has to follow.
+        void warmUp (const juce::dsp::ProcessSpec& spec);
+        
+        // Voices, driven by incoming MIDI
+        rosy::VoiceEngine<SampleType> voiceEngine;
+        
+        // The effect mode, shaping the input with the same polynomial instead of playing notes
+        rosy::HarmonicExciter<SampleType> exciter;
+        
+        // Peak level calculators
+        rosy::DbCalculator<SampleType> preVolumePeakCalculator;
+        rosy::DbCalculator<SampleType> postVolumePeakCalculator;
+        
+        // Per chain, so every instance in a session resets its own meters on its own schedule
+        int samplesSincePeakReset = 0;
+        
+        // The governor level whose anti-aliasing order and voice limit the voices were last given
+        int appliedQualityLevel = -1;
+        
+        // Smoothed per-sample morph positions, the voices read them at audio rate
+        juce::SmoothedValue<SampleType> morphX, morphY;
+        SampleType* morphPositionsX = nullptr;
+        SampleType* morphPositionsY = nullptr;
+        
+        // Each sub-block is rendered, metered and gained here before it's copied to the host's buffer
+        SampleType** outputChannels = nullptr;
+        size_t numOutputChannels = 0;
+    };
+    
+    // Pushes a snapshot to both chains and into the state so it's saved with the session
+    void setMorphSnapshot (int index, const std::vector<float>& harmonicGains);
+    void loadMorphSnapshotsFromState();
+    
+    // Gives the effect mode the current shape, after the voices have taken it
+    void updateExciterShape();
+    
+    // Starts working out low crest phases for the current shape with quadrature on, or has them cleared with it off
+    void requestHarmonicPhases();
     
-    // Peak level calculators
-    rosy::DbCalculator preVolumePeakCalculator;
-    rosy::DbCalculator postVolumePeakCalculator;
+    // Applies newly optimised phases (or clears them once quadrature is off), imported snapshots, the effect mode's latency and the governor's quality
+    // level to both chains, on the message thread
+    void handleAsyncUpdate() override;
+    
+    // Reports the effect mode's delay to the host, if it has changed
+    void updateLatency();
+    
+    template <typename SampleType>
+    void processSamples (juce::AudioBuffer<SampleType>& buffer, juce::MidiBuffer& midiMessages, RenderChain<SampleType>& chain);
+    
+    RenderChain<float> floatChain;
+    RenderChain<double> doubleChain;
+    
+    // Host blocks are processed in sub-blocks of at most this many samples, whatever size the host uses, so
+    // every stage works on cache sized, aligned scratch with the same loop lengths every time
+    static constexpr int subBlockSize = 64;
+    
+    // Scratch for both chains, only handed out in prepareToPlay
+    rosy::ScratchArena scratchArena;
+    
+    // CPU load profiling, and the quality trade-offs made when the load gets too high
+    rosy::LoadMonitor loadMonitor;
+    rosy::QualityGovernor qualityGovernor;
+    
+    // The harmonic limit needs new coefficient sets, so that part of the level is applied on the message thread
+    size_t appliedHarmonicLimit = 0;
+    
+    // Phases for the quadrature shaping, worked out in the background
+    rosy::PhaseOptimiser phaseOptimiser;
+    
+    // Everything the host gets, written to disk while capture is on
+    rosy::OutputCapture outputCapture;
+    
+    // Recorded notes turned into morph snapshots, analysed in the background
+    rosy::ResynthesisImporter resynthesisImporter;
+    juce::String lastImportMessage;
+
+   #if ROSEMARY_ENABLE_TRACING
+    // Records a trace for as long as any instance is alive
+    rosy::TraceRecorder::Session traceSession;
+   #endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RosemaryAudioProcessor)
 };
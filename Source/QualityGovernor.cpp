@@ -0,0 +1,105 @@
+#include "QualityGovernor.h"
+
+namespace rosy {
+
+void QualityGovernor::prepare(double newSampleRate)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+    reset();
+}
+
+void QualityGovernor::reset()
+{
+    smoothedLoad = 0.0f;
+    samplesSinceStep = 0;
+    samplesBelowStepUp = 0;
+    recoveryHoldSeconds = recoverySeconds;
+    lastStepWasUp = false;
+    level.store(full, std::memory_order_relaxed);
+}
+
+bool QualityGovernor::update(float blockLoad, int numSamples)
+{
+    if (numSamples <= 0)
+        return false;
+
+    // Smoothed over time rather than blocks, so the reaction speed doesn't depend on the block size
+    const float smoothing = static_cast<float>(1.0 - std::exp(-numSamples / (smoothingSeconds * sampleRate)));
+    smoothedLoad += smoothing * (blockLoad - smoothedLoad);
+    samplesSinceStep += numSamples;
+    samplesBelowStepUp = smoothedLoad < stepUpLoad ? samplesBelowStepUp + numSamples : 0;
+
+    const int current = level.load(std::memory_order_relaxed);
+    const bool overloaded = smoothedLoad > stepDownLoad || blockLoad > 1.0f;
+
+    if (overloaded && current < numLevels - 1 && samplesSinceStep >= static_cast<int64_t>(settleSeconds * sampleRate))
+    {
+        // Losing a level that was only just restored means the load is on the edge, so wait longer next time
+        if (lastStepWasUp && samplesSinceStep < static_cast<int64_t>(2.0 * recoveryHoldSeconds * sampleRate))
+            recoveryHoldSeconds = std::min(recoveryHoldSeconds * 2.0, maxRecoverySeconds);
+
+        lastStepWasUp = false;
+        stepDownCount.store(stepDownCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        setLevel(current + 1);
+        return true;
+    }
+
+    if (current > full && samplesBelowStepUp >= static_cast<int64_t>(recoveryHoldSeconds * sampleRate))
+    {
+        // A level that has held for as long as the longest wait earns the short wait back
+        if (samplesSinceStep >= static_cast<int64_t>(maxRecoverySeconds * sampleRate))
+            recoveryHoldSeconds = recoverySeconds;
+
+        lastStepWasUp = true;
+        setLevel(current - 1);
+        return true;
+    }
+
+    return false;
+}
+
+void QualityGovernor::setLevel(int newLevel)
+{
+    level.store(newLevel, std::memory_order_relaxed);
+    samplesSinceStep = 0;
+    samplesBelowStepUp = 0;
+}
+
+const char* QualityGovernor::getLevelName(Level level)
+{
+    switch (level)
+    {
+        case full:                   return "Full";
+        case firstOrderAntialiasing: return "ADAA 1st order";
+        case noAntialiasing:         return "ADAA off";
+        case reducedHarmonics:       return "Reduced harmonics";
+        case halfVoices:             return "Half voices";
+        case quarterVoices:          return "Quarter voices";
+        case numLevels:              break;
+    }
+    return "";
+}
+
+int QualityGovernor::getMaxAntialiasingOrder(Level level)
+{
+    if (level >= noAntialiasing)
+        return 0;
+
+    return level >= firstOrderAntialiasing ? 1 : 2;
+}
+
+size_t QualityGovernor::getHarmonicLimit(Level level, size_t numHarmonics)
+{
+    // The lower half carries most of the timbre and halves the polynomial's degree
+    return level >= reducedHarmonics ? std::max<size_t>(numHarmonics / 2, 1) : numHarmonics;
+}
+
+int QualityGovernor::getVoiceLimit(Level level, int numVoices)
+{
+    if (level >= quarterVoices)
+        return std::max(numVoices / 4, 1);
+
+    return level >= halfVoices ? std::max(numVoices / 2, 1) : numVoices;
+}
+
+} // namespace rosy
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <cstdint>
+
+namespace rosy {
+
+/**
+ * @brief Trades sound quality for CPU time when blocks get close to their deadline, and trades it back afterwards.
+ *
+ * Fed each block's load (the fraction of its deadline it took, from the LoadMonitor), the governor steps down
+ * one quality level at a time while the smoothed load stays above stepDownLoad, or at once after an overrun.
+ * It only steps back up once the load has stayed below stepUpLoad for a while. The gap between the two
+ * thresholds and the recovery wait are the hysteresis; a level that has to be given up again soon after it
+ * was restored doubles the wait, so a load sitting right on the edge doesn't flip back and forth.
+ *
+ * The levels are ordered from least to most audible: anti-aliasing goes first, then the upper harmonics, and
+ * only then are notes given up. The governor just picks the level, whoever owns the voices applies it.
+ */
+class QualityGovernor
+{
+public:
+    enum Level
+    {
+        full = 0,
+        firstOrderAntialiasing,  // Second order ADAA drops to first order
+        noAntialiasing,          // ADAA off
+        reducedHarmonics,        // Only the lower harmonics are shaped
+        halfVoices,              // Half the voices, new notes steal sooner
+        quarterVoices,           // A quarter of the voices
+        numLevels
+    };
+
+    static constexpr float stepDownLoad = 0.8f;
+    static constexpr float stepUpLoad = 0.5f;
+
+    // Shortest time between two steps down, so each step gets to show its effect on the load first
+    static constexpr double settleSeconds = 0.25;
+
+    // How long the load has to stay low before stepping back up, and the longest that can grow to
+    static constexpr double recoverySeconds = 2.0;
+    static constexpr double maxRecoverySeconds = 30.0;
+
+    QualityGovernor() = default;
+
+    void prepare(double sampleRate);
+
+    // Back to full quality
+    void reset();
+
+    //==============================================================================
+    // Audio thread
+    // Returns true if the level changed
+    bool update(float blockLoad, int numSamples);
+
+    //==============================================================================
+    // Any thread
+    Level getLevel() const { return static_cast<Level>(level.load(std::memory_order_relaxed)); }
+    uint32_t getStepDownCount() const { return stepDownCount.load(std::memory_order_relaxed); }
+
+    static const char* getLevelName(Level level);
+
+    // What a level allows: the highest ADAA order (0 is off), harmonics and voices
+    static int getMaxAntialiasingOrder(Level level);
+    static size_t getHarmonicLimit(Level level, size_t numHarmonics);
+    static int getVoiceLimit(Level level, int numVoices);
+
+private:
+    void setLevel(int newLevel);
+
+    double sampleRate { 44100.0 };
+
+    // Audio thread only
+    float smoothedLoad { 0.0f };
+    int64_t samplesSinceStep { 0 };
+    int64_t samplesBelowStepUp { 0 };
+    double recoveryHoldSeconds { recoverySeconds };
+    bool lastStepWasUp { false };
+
+    // Published results
+    std::atomic<int> level { full };
+    std::atomic<uint32_t> stepDownCount { 0 };
+
+    // Long enough to ride over single slow blocks, short enough to react within a few hundred milliseconds
+    static constexpr double smoothingSeconds = 0.1;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(QualityGovernor)
+};
+
+} // namespace rosy
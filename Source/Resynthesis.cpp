@@ -0,0 +1,240 @@
+#include "Resynthesis.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace rosy {
+
+Resynthesis::Result Resynthesis::analyseFile(const juce::File& file)
+{
+    Result result;
+
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+    if (reader == nullptr)
+    {
+        result.error = "Couldn't read " + file.getFileName();
+        return result;
+    }
+
+    const auto numSamples = static_cast<int>(std::min<juce::int64>(reader->lengthInSamples,
+                                                                  static_cast<juce::int64>(reader->sampleRate * maxSeconds)));
+    const int numChannels = static_cast<int>(reader->numChannels);
+    if (numSamples <= 0 || numChannels <= 0)
+    {
+        result.error = file.getFileName() + " is empty";
+        return result;
+    }
+
+    juce::AudioBuffer<float> buffer(numChannels, numSamples);
+    reader->read(&buffer, 0, numSamples, 0, true, true);
+
+    // Mono mix, the profile is the same on every channel
+    for (int channel = 1; channel < numChannels; ++channel)
+        buffer.addFrom(0, 0, buffer, channel, 0, numSamples);
+
+    buffer.applyGain(0, 0, numSamples, 1.0f / static_cast<float>(numChannels));
+    return analyse(buffer.getReadPointer(0), numSamples, reader->sampleRate);
+}
+
+Resynthesis::Result Resynthesis::analyse(const float* samples, int numSamples, double sampleRate)
+{
+    Result result;
+
+    // Find the loudest stretch, where the note is at its steadiest and furthest above the noise
+    const int pitchWindow = juce::jmin(numSamples, juce::roundToInt(sampleRate * 0.1));
+    const int pitchHop = juce::jmax(1, pitchWindow / 4);
+    int loudestStart = 0;
+    double loudestEnergy = 0.0;
+    for (int start = 0; start + pitchWindow <= numSamples; start += pitchHop)
+    {
+        double energy = 0.0;
+        for (int i = start; i < start + pitchWindow; ++i)
+            energy += static_cast<double>(samples[i]) * static_cast<double>(samples[i]);
+
+        if (energy > loudestEnergy)
+        {
+            loudestEnergy = energy;
+            loudestStart = start;
+        }
+    }
+
+    result.fundamental = estimateFundamental(samples + loudestStart, pitchWindow, sampleRate);
+    if (result.fundamental <= 0.0)
+    {
+        result.error = "No clear pitch";
+        return result;
+    }
+
+    // At least eight bins between harmonics, so neighbouring peaks don't smear into each other
+    int fftOrder = 11;
+    while (fftOrder < 16 && static_cast<double>(1 << fftOrder) < 8.0 * sampleRate / result.fundamental)
+        ++fftOrder;
+
+    const int fftSize = 1 << fftOrder;
+    const int hop = fftSize / 4;
+    const double binWidth = sampleRate / static_cast<double>(fftSize);
+    juce::dsp::FFT fft(fftOrder);
+
+    std::vector<float> window(static_cast<size_t>(fftSize));
+    for (int i = 0; i < fftSize; ++i)
+        window[static_cast<size_t>(i)] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * static_cast<float>(i) / static_cast<float>(fftSize));
+
+    // A Hann window passes half of a sinusoid's amplitude, and the magnitude spectrum is scaled by half the size
+    const float amplitudeScale = 4.0f / static_cast<float>(fftSize);
+
+    // Each harmonic is looked for within a quarter of the fundamental of where it should be, which is enough
+    // for slightly inharmonic or drifting sources
+    const double searchWidth = 0.25 * result.fundamental / binWidth;
+
+    std::vector<float> frame(static_cast<size_t>(2 * fftSize));
+    std::vector<float> frameEnergies;
+    for (int start = 0; start + fftSize <= juce::jmax(numSamples, fftSize); start += hop)
+    {
+        std::fill(frame.begin(), frame.end(), 0.0f);
+        const int count = juce::jmin(fftSize, numSamples - start);
+        for (int i = 0; i < count; ++i)
+            frame[static_cast<size_t>(i)] = samples[start + i] * window[static_cast<size_t>(i)];
+
+        fft.performFrequencyOnlyForwardTransform(frame.data());
+
+        std::array<float, numHarmonics> amplitudes {};
+        float energy = 0.0f;
+        for (int harmonic = 0; harmonic < numHarmonics; ++harmonic)
+        {
+            const double centre = result.fundamental * (harmonic + 1) / binWidth;
+            const int lowBin = juce::jmax(1, static_cast<int>(std::floor(centre - searchWidth)));
+            const int highBin = juce::jmin(fftSize / 2 - 2, static_cast<int>(std::ceil(centre + searchWidth)));
+            if (lowBin > highBin)
+                break;  // Past Nyquist, those harmonics stay at 0
+
+            int peakBin = lowBin;
+            for (int bin = lowBin + 1; bin <= highBin; ++bin)
+                if (frame[static_cast<size_t>(bin)] > frame[static_cast<size_t>(peakBin)])
+                    peakBin = bin;
+
+            // Parabolic interpolation of the log magnitudes either side of the peak. A peak on the edge of the
+            // search range needn't be a local maximum, so the offset is kept within half a bin.
+            const double left = std::log(frame[static_cast<size_t>(peakBin - 1)] + 1.0e-12);
+            const double middle = std::log(frame[static_cast<size_t>(peakBin)] + 1.0e-12);
+            const double right = std::log(frame[static_cast<size_t>(peakBin + 1)] + 1.0e-12);
+            const double curvature = left - 2.0 * middle + right;
+            const double offset = curvature < 0.0 ? juce::jlimit(-0.5, 0.5, 0.5 * (left - right) / curvature) : 0.0;
+            const double peak = middle - 0.25 * (left - right) * offset;
+
+            amplitudes[static_cast<size_t>(harmonic)] = static_cast<float>(std::exp(peak)) * amplitudeScale;
+            energy += amplitudes[static_cast<size_t>(harmonic)] * amplitudes[static_cast<size_t>(harmonic)];
+        }
+
+        result.envelope.push_back(amplitudes);
+        frameEnergies.push_back(energy);
+    }
+
+    result.frameHopSeconds = static_cast<double>(hop) / sampleRate;
+
+    // Average the body of the note, leaving out the attack's run-up and the tail's fade into the noise
+    const float loudestFrame = frameEnergies.empty() ? 0.0f : *std::max_element(frameEnergies.begin(), frameEnergies.end());
+    std::vector<double> sums(numHarmonics, 0.0);
+    int numFrames = 0;
+    for (size_t index = 0; index < result.envelope.size(); ++index)
+    {
+        if (frameEnergies[index] < loudestFrame * 0.01f)
+            continue;
+
+        for (size_t harmonic = 0; harmonic < static_cast<size_t>(numHarmonics); ++harmonic)
+            sums[harmonic] += result.envelope[index][harmonic];
+
+        ++numFrames;
+    }
+
+    const double loudestHarmonic = *std::max_element(sums.begin(), sums.end());
+    if (numFrames == 0 || loudestHarmonic <= 0.0)
+    {
+        result.error = "Too quiet";
+        return result;
+    }
+
+    // Anything more than 90 dB below the loudest harmonic is noise
+    result.harmonicGains.resize(numHarmonics);
+    for (size_t harmonic = 0; harmonic < static_cast<size_t>(numHarmonics); ++harmonic)
+    {
+        const double gain = sums[harmonic] / loudestHarmonic;
+        result.harmonicGains[harmonic] = gain > 3.16e-5 ? static_cast<float>(gain) : 0.0f;
+    }
+
+    result.succeeded = true;
+    return result;
+}
+
+double Resynthesis::estimateFundamental(const float* samples, int numSamples, double sampleRate,
+                                        double minFrequency, double maxFrequency)
+{
+    const int minLag = juce::jmax(2, static_cast<int>(sampleRate / maxFrequency));
+    const int maxLag = juce::jmin(numSamples / 2, static_cast<int>(sampleRate / minFrequency));
+    if (maxLag <= minLag + 1)
+        return 0.0;
+
+    // Difference function d(tau) over a fixed window, then normalised by its running mean
+    const int windowSize = numSamples - maxLag;
+    std::vector<double> difference(static_cast<size_t>(maxLag + 1), 0.0);
+    for (int lag = 1; lag <= maxLag; ++lag)
+    {
+        double sum = 0.0;
+        for (int i = 0; i < windowSize; ++i)
+        {
+            const double delta = static_cast<double>(samples[i]) - static_cast<double>(samples[i + lag]);
+            sum += delta * delta;
+        }
+
+        difference[static_cast<size_t>(lag)] = sum;
+    }
+
+    std::vector<double> normalised(difference.size(), 1.0);
+    double runningSum = 0.0;
+    for (int lag = 1; lag <= maxLag; ++lag)
+    {
+        runningSum += difference[static_cast<size_t>(lag)];
+        normalised[static_cast<size_t>(lag)] = runningSum > 0.0 ? difference[static_cast<size_t>(lag)] * lag / runningSum : 1.0;
+    }
+
+    // The first dip under the threshold, followed down to its minimum; failing that, the deepest dip overall
+    constexpr double threshold = 0.15;
+    int bestLag = -1;
+    for (int lag = minLag; lag < maxLag; ++lag)
+    {
+        if (normalised[static_cast<size_t>(lag)] < threshold)
+        {
+            while (lag + 1 < maxLag && normalised[static_cast<size_t>(lag + 1)] < normalised[static_cast<size_t>(lag)])
+                ++lag;
+
+            bestLag = lag;
+            break;
+        }
+    }
+
+    if (bestLag < 0)
+    {
+        const auto deepest = std::min_element(normalised.begin() + minLag, normalised.begin() + maxLag);
+        if (*deepest > 0.5)
+            return 0.0;
+
+        bestLag = static_cast<int>(std::distance(normalised.begin(), deepest));
+    }
+
+    // Parabolic interpolation between lags
+    double lag = bestLag;
+    if (bestLag > 1 && bestLag < maxLag)
+    {
+        const double left = normalised[static_cast<size_t>(bestLag - 1)];
+        const double middle = normalised[static_cast<size_t>(bestLag)];
+        const double right = normalised[static_cast<size_t>(bestLag + 1)];
+        const double curvature = left - 2.0 * middle + right;
+        if (curvature > 0.0)
+            lag += 0.5 * (left - right) / curvature;
+    }
+
+    return sampleRate / lag;
+}
+
+} // namespace rosy
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <vector>
+
+namespace rosy {
+
+/**
+ * @brief Static utility class for turning a recorded note into a harmonic profile the oscillators can play.
+ *
+ * The analysis runs in four steps:
+ * 1. The file is decoded and mixed down to mono, up to maxSeconds of it
+ * 2. The fundamental is estimated with YIN's cumulative mean normalised difference on the loudest stretch
+ * 3. Short-time spectra with a Hann window are peak-picked near each multiple of the fundamental, with
+ *    parabolic interpolation of the log magnitudes, giving each harmonic's amplitude frame by frame
+ * 4. The frames within 20 dB of the loudest are averaged into one gain per harmonic, loudest harmonic at 1
+ *
+ * The per-frame amplitudes are kept as well, for anything that wants the profile's movement over time.
+ *
+ * Like HarmonicAnalysis it is a pure static utility with no state. It allocates, so it is meant for
+ * background threads rather than the audio thread.
+ */
+class Resynthesis
+{
+public:
+    // The oscillators' harmonic count, see MuOscillator::numHarmonics
+    static constexpr int numHarmonics { 16 };
+    static constexpr double maxSeconds { 10.0 };
+
+    struct Result
+    {
+        bool succeeded { false };
+        juce::String error;
+
+        double fundamental { 0.0 };
+        std::vector<float> harmonicGains;
+
+        // Amplitude of each harmonic per analysis frame, frameHopSeconds apart
+        std::vector<std::array<float, numHarmonics>> envelope;
+        double frameHopSeconds { 0.0 };
+    };
+
+    // Decodes and analyses a file in any of JUCE's basic formats
+    static Result analyseFile(const juce::File& file);
+
+    // Analyses mono samples
+    static Result analyse(const float* samples, int numSamples, double sampleRate);
+
+    /**
+     * @brief Estimates the fundamental of a stretch of a signal with YIN.
+     *
+     * @return The fundamental in Hz, or 0 if nothing between minFrequency and maxFrequency is periodic enough
+     */
+    static double estimateFundamental(const float* samples, int numSamples, double sampleRate,
+                                      double minFrequency = 30.0, double maxFrequency = 2000.0);
+
+private:
+    // Prevent instantiation of this utility class
+    Resynthesis() = delete;
+};
+
+} // namespace rosy
@@ -0,0 +1,55 @@
+#include "ResynthesisImporter.h"
+
+namespace rosy {
+
+ResynthesisImporter::ResynthesisImporter()
+{
+}
+
+ResynthesisImporter::~ResynthesisImporter()
+{
+    // Jobs that haven't started are dropped, the ones running are waited for
+    if (pool != nullptr)
+        pool->removeAllJobs(true, 10000);
+}
+
+void ResynthesisImporter::analyse(const juce::Array<juce::File>& files, int firstTarget)
+{
+    if (files.isEmpty())
+        return;
+
+    if (pool == nullptr)
+        pool = std::make_unique<juce::ThreadPool>(juce::SystemStats::getNumCpus());
+
+    for (int index = 0; index < files.size(); ++index)
+    {
+        Import import;
+        import.file = files[index];
+        import.target = firstTarget + index;
+        import.firstOfBatch = index == 0;
+
+        ++numPending;
+        pool->addJob([this, import]() mutable
+        {
+            import.result = Resynthesis::analyseFile(import.file);
+            {
+                const juce::ScopedLock scopedLock(lock);
+                results.push_back(std::move(import));
+            }
+
+            --numPending;
+            if (onResultsReady != nullptr)
+                onResultsReady();
+        });
+    }
+}
+
+std::vector<ResynthesisImporter::Import> ResynthesisImporter::takeResults()
+{
+    const juce::ScopedLock scopedLock(lock);
+    std::vector<Import> taken;
+    std::swap(taken, results);
+    return taken;
+}
+
+} // namespace rosy
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Resynthesis.h"
+
+namespace rosy {
+
+/**
+ * @brief Analyses dropped audio files into harmonic profiles on a pool of background threads.
+ *
+ * Every file is its own job, so a batch is spread across all the cores and each result is ready as soon as
+ * its own analysis is. Results are collected under a lock and onResultsReady is called on the worker thread
+ * that finished, for the owner to pick them up on the message thread with takeResults(). Handing the gains
+ * on to the audio thread is the owner's business, the plugin stores them as morph snapshots.
+ */
+class ResynthesisImporter
+{
+public:
+    struct Import
+    {
+        juce::File file;
+        int target { 0 };          // Where the owner asked for it to go, counting up from the batch's first
+        bool firstOfBatch { false };
+        Resynthesis::Result result;
+    };
+
+    ResynthesisImporter();
+    ~ResynthesisImporter();
+
+    //==============================================================================
+    // Message thread
+    void analyse(const juce::Array<juce::File>& files, int firstTarget);
+
+    // Every import finished since the last call, in the order they finished
+    std::vector<Import> takeResults();
+
+    // Files queued or being analysed, from any thread
+    int getNumPending() const { return numPending.load(); }
+
+    std::function<void()> onResultsReady;
+
+private:
+    juce::CriticalSection lock;
+    std::vector<Import> results;
+    std::atomic<int> numPending { 0 };
+
+    // Made by the first analyse(), so an importer that's never used never starts a thread. Last, so it's
+    // destroyed first and every job has finished before the rest goes.
+    std::unique_ptr<juce::ThreadPool> pool;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ResynthesisImporter)
+};
+
+} // namespace rosy
@@ -0,0 +1,52 @@
+#include "ScratchArena.h"
+#include <cstring>
+
+namespace rosy {
+
+ScratchArena::ScratchArena(size_t chunkBytes)
+    : chunkSize(juce::jmax(chunkBytes, alignment))
+{
+}
+
+void ScratchArena::reset()
+{
+    for (auto& chunk : chunks)
+        chunk.used = 0;
+
+    currentChunk = 0;
+    bytesUsed = 0;
+}
+
+char* ScratchArena::Chunk::getStart() const
+{
+    const auto address = reinterpret_cast<uintptr_t>(memory.get());
+    return memory.get() + (alignment - address % alignment) % alignment;
+}
+
+void* ScratchArena::allocateBytes(size_t numBytes)
+{
+    // Rounding every piece up to whole cache lines keeps the next one aligned too
+    const size_t size = juce::jmax(alignment, (numBytes + alignment - 1) / alignment * alignment);
+
+    while (currentChunk < chunks.size() && chunks[currentChunk].used + size > chunks[currentChunk].size)
+        ++currentChunk;
+
+    if (currentChunk == chunks.size())
+    {
+        // Oversized pieces get a chunk of their own
+        Chunk chunk;
+        chunk.size = juce::jmax(chunkSize, size);
+        chunk.memory.allocate(chunk.size + alignment, false);
+        chunks.push_back(std::move(chunk));
+    }
+
+    auto& chunk = chunks[currentChunk];
+    char* piece = chunk.getStart() + chunk.used;
+    chunk.used += size;
+    bytesUsed += size;
+
+    std::memset(piece, 0, size);
+    return piece;
+}
+
+} // namespace rosy
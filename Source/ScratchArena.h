@@ -0,0 +1,59 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <type_traits>
+#include <vector>
+
+namespace rosy {
+
+/**
+ * @brief Per-instance working memory for the audio thread, handed out in 64 byte aligned pieces while preparing.
+ *
+ * Every buffer the render path writes to comes from here, so it all sits in a few contiguous chunks that stay
+ * warm in the cache, each buffer starts on a cache line, and nothing is allocated once playback starts. Pieces
+ * are only handed out from prepare() calls; reset() takes them all back before the next prepare, and the chunks
+ * themselves are kept so a second prepare with the same sizes reuses the same memory.
+ */
+class ScratchArena
+{
+public:
+    static constexpr size_t alignment { 64 };
+
+    explicit ScratchArena(size_t chunkBytes = 64 * 1024);
+
+    // Takes back every piece, pointers handed out before must not be used again. Message thread only.
+    void reset();
+
+    // Zeroed space for count values, starting on an alignment boundary. Message thread only.
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "Arena memory is never constructed or destroyed");
+        static_assert(alignof(T) <= alignment, "The arena can't align this type");
+        return static_cast<T*>(allocateBytes(count * sizeof(T)));
+    }
+
+    size_t getBytesUsed() const { return bytesUsed; }
+
+private:
+    void* allocateBytes(size_t numBytes);
+
+    struct Chunk
+    {
+        juce::HeapBlock<char> memory;
+        size_t size { 0 };
+        size_t used { 0 };
+
+        // The first aligned byte of the chunk's memory
+        char* getStart() const;
+    };
+
+    std::vector<Chunk> chunks;
+    size_t currentChunk { 0 };
+    size_t chunkSize;
+    size_t bytesUsed { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ScratchArena)
+};
+
+} // namespace rosy
@@ -0,0 +1,142 @@
+#include "ShapePreview.h"
+#include "HarmonicProfileCalculator.h"
+
+namespace rosy {
+
+ShapePreview::ShapePreview() : juce::Thread("Rosemary shape preview")
+{
+    startThread();
+}
+
+ShapePreview::~ShapePreview()
+{
+    stopThread(1000);
+}
+
+void ShapePreview::requestPreview(uint32_t coefficientSetId, const std::vector<float>& harmonicGains,
+                                  const std::vector<float>& harmonicPhases, int width, int height)
+{
+    {
+        const juce::ScopedLock lock(requestLock);
+        pendingRequest.coefficientSetId = coefficientSetId;
+        pendingRequest.harmonicGains = harmonicGains;
+        pendingRequest.harmonicPhases = harmonicPhases;
+        pendingRequest.width = width;
+        pendingRequest.height = height;
+        requestPending = true;
+    }
+
+    notify();
+}
+
+juce::Image ShapePreview::getImage() const
+{
+    const juce::SpinLock::ScopedLockType lock(imageLock);
+    return image;
+}
+
+void ShapePreview::run()
+{
+    while (! threadShouldExit())
+    {
+        Request request;
+        {
+            const juce::ScopedLock lock(requestLock);
+            if (requestPending)
+            {
+                request = pendingRequest;
+                requestPending = false;
+            }
+        }
+
+        if (request.width <= 0 || request.height <= 0)
+        {
+            wait(-1);
+            continue;
+        }
+
+        auto rendered = render(request);
+        {
+            const juce::SpinLock::ScopedLockType lock(imageLock);
+            std::swap(image, rendered);
+        }
+
+        imageId.store(request.coefficientSetId);
+        imageReady.store(true);
+    }
+}
+
+juce::Image ShapePreview::render(const Request& request)
+{
+    // Without phases the quadrature polynomial is all zeros and drops out
+    std::vector<double> inPhase, quadrature;
+    HarmonicProfileCalculator::calculateQuadratureCoefficients(request.harmonicGains, request.harmonicPhases, request.harmonicGains,
+                                                               inPhase, quadrature);
+    const bool phased = ! request.harmonicPhases.empty();
+
+    auto evaluate = [](const std::vector<double>& coefficients, double x)
+    {
+        // Horner's scheme, highest power first
+        double result = 0.0;
+        for (auto it = coefficients.rbegin(); it != coefficients.rend(); ++it)
+            result = *it + result * x;
+
+        return result;
+    };
+
+    // A software image, since it's drawn away from the message thread
+    juce::Image rendered(juce::Image::ARGB, request.width, request.height, true, juce::SoftwareImageType());
+    juce::Graphics g(rendered);
+
+    const float halfWidth = static_cast<float>(request.width) * 0.5f;
+    const auto waveformArea = juce::Rectangle<float>(0.0f, 0.0f, halfWidth, static_cast<float>(request.height)).reduced(4.0f);
+    const auto transferArea = waveformArea.translated(halfWidth, 0.0f);
+
+    // Both curves stay within [-1, 1], which maps onto the height of their half
+    auto drawFrame = [&g](juce::Rectangle<float> area)
+    {
+        g.setColour(juce::Colours::white.withAlpha(0.2f));
+        g.drawRect(area);
+        g.drawHorizontalLine(juce::roundToInt(area.getCentreY()), area.getX(), area.getRight());
+    };
+
+    auto plot = [&g](juce::Rectangle<float> area, int numPoints, juce::Colour colour, auto&& valueAt)
+    {
+        juce::Path path;
+        path.preallocateSpace(3 * numPoints);
+        for (int point = 0; point < numPoints; ++point)
+        {
+            const double position = static_cast<double>(point) / static_cast<double>(numPoints - 1);
+            const float value = static_cast<float>(juce::jlimit(-1.0, 1.0, valueAt(position)));
+            const float x = area.getX() + static_cast<float>(position) * area.getWidth();
+            const float y = area.getCentreY() - value * area.getHeight() * 0.5f;
+
+            if (point == 0)
+                path.startNewSubPath(x, y);
+            else
+                path.lineTo(x, y);
+        }
+
+        g.setColour(colour);
+        g.strokePath(path, juce::PathStrokeType(1.5f));
+    };
+
+    // The oscillator's sine is x = cos ψ and its quadrature y = sin ψ, a quarter cycle behind
+    const int numPoints = juce::jmax(2, static_cast<int>(halfWidth));
+    const double twoPi = juce::MathConstants<double>::twoPi;
+    drawFrame(waveformArea);
+    plot(waveformArea, numPoints, juce::Colours::white, [&](double position)
+    {
+        return evaluate(inPhase, std::sin(twoPi * position)) - std::cos(twoPi * position) * evaluate(quadrature, std::sin(twoPi * position));
+    });
+
+    drawFrame(transferArea);
+    if (phased)
+        plot(transferArea, numPoints, juce::Colours::white.withAlpha(0.4f), [&](double position) { return evaluate(quadrature, 2.0 * position - 1.0); });
+
+    plot(transferArea, numPoints, juce::Colours::white, [&](double position) { return evaluate(inPhase, 2.0 * position - 1.0); });
+
+    return rendered;
+}
+
+} // namespace rosy
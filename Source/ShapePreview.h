@@ -0,0 +1,65 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+
+namespace rosy {
+
+/**
+ * @brief Renders the current shape's single cycle waveform and transfer curve into an Image off the message thread.
+ *
+ * Working out the coefficients and drawing the curves takes long enough that doing it on every slider move
+ * would make the editor stutter. Instead the editor hands over the gains with the id of the coefficient set
+ * they belong to, and a background thread renders the newest request it has, skipping any that were
+ * superseded in the meantime. The finished image is swapped in under a lock held only for the swap, and the
+ * editor only repaints when the id of the ready image changes.
+ *
+ * The left half of the image is one cycle of the oscillator's output, the shaping polynomial applied to a
+ * sine, and the right half is the polynomial itself over [-1, 1]. With per-harmonic phases the output also
+ * depends on the quadrature sine, so the right half shows the in-phase polynomial with the quadrature one
+ * drawn fainter behind it.
+ */
+class ShapePreview : private juce::Thread
+{
+public:
+    ShapePreview();
+    ~ShapePreview() override;
+
+    //==============================================================================
+    // Message thread
+    // Replaces any request that hasn't been started yet. Empty phases draw the shape in cosine phase, see
+    // HarmonicProfileCalculator::calculateQuadratureCoefficients()
+    void requestPreview(uint32_t coefficientSetId, const std::vector<float>& harmonicGains, const std::vector<float>& harmonicPhases,
+                        int width, int height);
+
+    // The newest finished preview, and the id of the coefficient set it shows
+    juce::Image getImage() const;
+    uint32_t getImageId() const { return imageId.load(); }
+    bool hasImage() const { return imageReady.load(); }
+
+private:
+    struct Request
+    {
+        uint32_t coefficientSetId { 0 };
+        std::vector<float> harmonicGains;
+        std::vector<float> harmonicPhases;
+        int width { 0 };
+        int height { 0 };
+    };
+
+    void run() override;
+    static juce::Image render(const Request& request);
+
+    juce::CriticalSection requestLock;
+    Request pendingRequest;
+    bool requestPending { false };
+
+    juce::SpinLock imageLock;
+    juce::Image image;
+    std::atomic<uint32_t> imageId { 0 };
+    std::atomic<bool> imageReady { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(ShapePreview)
+};
+
+} // namespace rosy
@@ -0,0 +1,194 @@
+#include "TraceRecorder.h"
+
+#if ROSEMARY_ENABLE_TRACING
+
+namespace rosy {
+
+class TraceRecorder::Writer : public juce::Thread
+{
+public:
+    explicit Writer(TraceRecorder& recorderToFlush) : juce::Thread("Rosemary trace writer"), recorder(recorderToFlush) {}
+
+    void run() override
+    {
+        // Often enough that the FIFOs never fill at normal block rates
+        while (! threadShouldExit())
+        {
+            wait(250);
+            recorder.flush();
+        }
+    }
+
+private:
+    TraceRecorder& recorder;
+};
+
+//==============================================================================
+TraceRecorder& TraceRecorder::getInstance()
+{
+    static TraceRecorder instance;
+    return instance;
+}
+
+TraceRecorder::TraceRecorder()
+{
+    // Everything a thread will write into exists up front, so recording never allocates events
+    for (auto& thread : threads)
+        thread = std::make_unique<ThreadEvents>();
+
+    microsecondsPerTick = 1.0e6 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+    writer = std::make_unique<Writer>(*this);
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    writer->stopThread(1000);
+}
+
+TraceRecorder::Session::Session()
+{
+    TraceRecorder::getInstance().startSession();
+}
+
+TraceRecorder::Session::~Session()
+{
+    TraceRecorder::getInstance().endSession();
+}
+
+void TraceRecorder::startSession()
+{
+    const juce::ScopedLock lock(sessionLock);
+    if (numSessions++ > 0)
+        return;
+
+    traceFile = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                    .getChildFile("Rosemary-trace-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S") + ".json");
+    output = std::make_unique<juce::FileOutputStream>(traceFile);
+    if (output->openedOk())
+    {
+        output->setPosition(0);
+        output->truncate();
+        *output << "[\n";
+    }
+
+    firstEvent = true;
+    originTicks = juce::Time::getHighResolutionTicks();
+    for (auto& thread : threads)
+        thread->nameWritten = false;
+
+    droppedEvents.store(0);
+    recording.store(true);
+    writer->startThread();
+}
+
+void TraceRecorder::endSession()
+{
+    const juce::ScopedLock lock(sessionLock);
+    if (--numSessions > 0)
+        return;
+
+    recording.store(false);
+    writer->stopThread(1000);
+    flush();
+
+    if (output != nullptr && output->openedOk())
+        *output << "\n]\n";
+
+    output.reset();
+}
+
+TraceRecorder::ThreadEvents* TraceRecorder::claimThreadEvents()
+{
+    for (auto& thread : threads)
+    {
+        if (thread->claimed.exchange(true))
+            continue;
+
+        // The thread's first event is the only one that costs more than a copy
+        if (juce::MessageManager::existsAndIsCurrentThread())
+            thread->threadName = "Message thread";
+        else if (auto* juceThread = juce::Thread::getCurrentThread())
+            thread->threadName = juceThread->getThreadName();
+        else
+            thread->threadName = "Thread " + juce::String(numThreads.load() + 1);
+
+        numThreads.fetch_add(1);
+        thread->ready.store(true, std::memory_order_release);
+        return thread.get();
+    }
+
+    return nullptr;
+}
+
+void TraceRecorder::record(const char* name, int64_t startTicks, int64_t endTicks)
+{
+    if (! recording.load(std::memory_order_relaxed))
+        return;
+
+    // Threads keep their FIFO for good, there are only ever a handful of them
+    thread_local ThreadEvents* threadEvents = nullptr;
+    if (threadEvents == nullptr)
+        threadEvents = claimThreadEvents();
+
+    if (threadEvents == nullptr)
+    {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const auto scope = threadEvents->fifo.write(1);
+    if (scope.blockSize1 + scope.blockSize2 == 0)
+    {
+        droppedEvents.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    threadEvents->events[static_cast<size_t>(scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = { name, startTicks, endTicks };
+}
+
+void TraceRecorder::flush()
+{
+    const bool writing = output != nullptr && output->openedOk();
+
+    for (int index = 0; index < maxThreads; ++index)
+    {
+        auto& thread = *threads[static_cast<size_t>(index)];
+        if (! thread.ready.load(std::memory_order_acquire))
+            continue;
+
+        auto separator = [this]
+        {
+            *output << (firstEvent ? "" : ",\n");
+            firstEvent = false;
+        };
+
+        if (writing && ! thread.nameWritten)
+        {
+            separator();
+            *output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << index
+                    << ",\"args\":{\"name\":" << juce::JSON::toString(thread.threadName) << "}}";
+            thread.nameWritten = true;
+        }
+
+        const auto scope = thread.fifo.read(thread.fifo.getNumReady());
+        scope.forEach([&](int eventIndex)
+        {
+            if (! writing)
+                return;
+
+            // Complete events, in microseconds from the start of the session
+            const auto& event = thread.events[static_cast<size_t>(eventIndex)];
+            separator();
+            *output << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << index
+                    << ",\"ts\":" << juce::String(static_cast<double>(event.startTicks - originTicks) * microsecondsPerTick, 3)
+                    << ",\"dur\":" << juce::String(static_cast<double>(event.endTicks - event.startTicks) * microsecondsPerTick, 3) << "}";
+        });
+    }
+
+    if (writing)
+        output->flush();
+}
+
+} // namespace rosy
+
+#endif
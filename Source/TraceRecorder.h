@@ -0,0 +1,130 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+// Tracing is for chasing glitches in development builds. Define ROSEMARY_ENABLE_TRACING=1 (e.g. in the
+// exporter's preprocessor definitions) to build it in; otherwise ROSY_TRACE_SCOPE expands to nothing.
+#ifndef ROSEMARY_ENABLE_TRACING
+ #define ROSEMARY_ENABLE_TRACING 0
+#endif
+
+#if ROSEMARY_ENABLE_TRACING
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace rosy {
+
+/**
+ * @brief Records timed events from any thread and writes them to a Chrome trace file.
+ *
+ * The trace shows what the audio, message and parameter threads were doing over time, which the aggregate
+ * figures from LoadMonitor can't. Load the file in chrome://tracing or ui.perfetto.dev.
+ *
+ * Each thread writes its events into its own fixed size lock-free FIFO. A thread claims one the first time
+ * it records an event, and that is the only time it does anything more than copy an event in. A background
+ * thread drains the FIFOs a few times a second and appends the events to the file, so nothing on the audio
+ * thread ever waits for it. When a FIFO is full the newest events are dropped and counted.
+ *
+ * Recording runs while at least one Session exists. The first session starts a new trace file in the temp
+ * directory, and the last one to go flushes it and stops the writer.
+ */
+class TraceRecorder
+{
+public:
+    static constexpr int maxThreads { 16 };
+    static constexpr int eventsPerThread { 4096 };
+
+    static TraceRecorder& getInstance();
+
+    // Keeps the recorder running for as long as it exists
+    class Session
+    {
+    public:
+        Session();
+        ~Session();
+
+        JUCE_DECLARE_NON_COPYABLE(Session)
+    };
+
+    // Any thread, real-time safe apart from a thread's first event
+    void record(const char* name, int64_t startTicks, int64_t endTicks);
+
+    uint32_t getDroppedEventCount() const { return droppedEvents.load(std::memory_order_relaxed); }
+    juce::File getTraceFile() const { return traceFile; }
+
+    ~TraceRecorder();
+
+private:
+    TraceRecorder();
+
+    struct Event
+    {
+        const char* name;  // Must be a string literal, only the pointer is stored
+        int64_t startTicks;
+        int64_t endTicks;
+    };
+
+    struct ThreadEvents
+    {
+        juce::AbstractFifo fifo { eventsPerThread };
+        std::array<Event, eventsPerThread> events;
+        std::atomic<bool> claimed { false };
+        std::atomic<bool> ready { false };
+        juce::String threadName;
+        bool nameWritten { false };
+    };
+
+    class Writer;
+
+    ThreadEvents* claimThreadEvents();
+    void startSession();
+    void endSession();
+
+    // Writer thread only
+    void flush();
+
+    std::array<std::unique_ptr<ThreadEvents>, maxThreads> threads;
+    std::atomic<int> numThreads { 0 };
+    std::atomic<uint32_t> droppedEvents { 0 };
+    std::atomic<bool> recording { false };
+
+    juce::CriticalSection sessionLock;
+    int numSessions { 0 };
+    std::unique_ptr<Writer> writer;
+
+    // Written only by the writer thread while a session is running
+    juce::File traceFile;
+    std::unique_ptr<juce::FileOutputStream> output;
+    bool firstEvent { true };
+    double microsecondsPerTick { 1.0 };
+    int64_t originTicks { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TraceRecorder)
+};
+
+/**
+ * @brief Records one event covering its own lifetime.
+ */
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* eventName) noexcept
+        : name(eventName), startTicks(juce::Time::getHighResolutionTicks()) {}
+
+    ~TraceScope() { TraceRecorder::getInstance().record(name, startTicks, juce::Time::getHighResolutionTicks()); }
+
+private:
+    const char* name;
+    int64_t startTicks;
+
+    JUCE_DECLARE_NON_COPYABLE(TraceScope)
+};
+
+} // namespace rosy
+
+ #define ROSY_TRACE_SCOPE(name) const rosy::TraceScope JUCE_JOIN_MACRO(traceScope_, __LINE__) (name)
+#else
+ #define ROSY_TRACE_SCOPE(name)
+#endif
@@ -0,0 +1,571 @@
+#include "VoiceEngine.h"
+
+namespace rosy {
+
+template <typename SampleType>
+VoiceEngine<SampleType>::VoiceEngine()
+{
+    setShapeCornerSnapshots(morph);
+    updateEnvelopeProfile();
+
+    for (auto& voice : voices)
+        voice.setAnalogDrift(&analogDrift);
+
+    harmonicEnvelopes.setAnalogDrift(&analogDrift);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setShapeCornerSnapshots(CoefficientMorph<SampleType>& morphToSet)
+{
+    for (int index = 0; index < CoefficientMorph<SampleType>::numSnapshots; ++index)
+    {
+        MuOscillator<SampleType> corner;
+        corner.setShapeX((index & 1) != 0 ? 1.0f : 0.0f);
+        corner.setShapeY((index & 2) != 0 ? 1.0f : 0.0f);
+        morphToSet.setSnapshot(index, corner.getCurrentHarmonicGains());
+    }
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::prepare(const juce::dsp::ProcessSpec& spec, ScratchArena& arena)
+{
+    for (auto& voice : voices)
+        voice.prepare(spec, arena);
+
+    harmonicEnvelopes.prepare(spec.sampleRate, maxVoices, static_cast<int>(spec.maximumBlockSize));
+    analogDrift.prepare(spec.sampleRate);
+    harmonicMeter.prepare(spec.sampleRate);
+    reset();
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::reset()
+{
+    for (auto& voice : voices)
+        voice.reset();
+
+    voiceStartOrder.fill(0);
+    noteCounter = 0;
+
+    for (auto& voice : voices)
+        voice.setHarmonicMeter(nullptr);
+
+    meteredVoice = -1;
+    harmonicMeter.setFrequency(0.0);
+
+    // Every voice has just been reset, so no set is held any more
+    for (auto& voice : voices)
+        voice.clearCoefficientOverride();
+
+    noteExpressions.fill({});
+    coefficientSets.clear();
+
+    masterPitchBend = 0.0f;
+    channelPitchBends.fill(0.0f);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setShapeX(float x)
+{
+    for (auto& voice : voices)
+        voice.setShapeX(x);
+
+    updateEnvelopeProfile();
+
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+    pendingNoteShapes.shapeX = x;
+    noteShapesChanged.store(true);
+    coefficientSetId.fetch_add(1);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setShapeY(float y)
+{
+    for (auto& voice : voices)
+        voice.setShapeY(y);
+
+    updateEnvelopeProfile();
+
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+    pendingNoteShapes.shapeY = y;
+    noteShapesChanged.store(true);
+    coefficientSetId.fetch_add(1);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setHarmonicPhases(const std::vector<float>& phases)
+{
+    for (auto& voice : voices)
+        voice.setHarmonicPhases(phases);
+
+    coefficientSetId.fetch_add(1);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setShapeXPan(float pan)
+{
+    for (auto& voice : voices)
+        voice.setShapeXPan(pan);
+
+    updateEnvelopeProfile();
+
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+    pendingNoteShapes.profile.shapeXPan = juce::jlimit(0.0f, 1.0f, pan);
+    shapeProfileChanged.store(true);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setShapeYPan(float pan)
+{
+    for (auto& voice : voices)
+        voice.setShapeYPan(pan);
+
+    updateEnvelopeProfile();
+
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+    pendingNoteShapes.profile.shapeYPan = juce::jlimit(0.0f, 1.0f, pan);
+    shapeProfileChanged.store(true);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setAntialiasing(typename MuOscillator<SampleType>::Antialiasing newAntialiasing)
+{
+    requestedAntialiasing.store(static_cast<int>(newAntialiasing));
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::applyAntialiasing()
+{
+    // The orders are numbered 0 to 2, the same as the enum
+    const int limited = std::min(requestedAntialiasing.load(), requestedMaxAntialiasingOrder.load());
+    if (limited == appliedAntialiasing)
+        return;
+
+    for (auto& voice : voices)
+        voice.setAntialiasing(static_cast<typename MuOscillator<SampleType>::Antialiasing>(limited));
+
+    appliedAntialiasing = limited;
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setHarmonicLimit(size_t limit)
+{
+    for (auto& voice : voices)
+        voice.setHarmonicLimit(limit);
+
+    morph.setHarmonicLimit(limit);
+    harmonicEnvelopes.setHarmonicLimit(limit);
+
+    // The per-note shapes are recalculated on the audio thread, like after a change of panning
+    const juce::SpinLock::ScopedLockType lock(pendingLock);
+    pendingNoteShapes.profile.harmonicLimit = juce::jlimit<size_t>(1, static_cast<size_t>(MuOscillator<SampleType>::numHarmonics), limit);
+    shapeProfileChanged.store(true);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setFrequencyModulation(float ratio, float index)
+{
+    for (auto& voice : voices)
+        voice.setFrequencyModulation(static_cast<SampleType>(ratio), static_cast<SampleType>(index));
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::setAnalogDrift(float pitchCents, float jitterDecibels, uint32_t seed)
+{
+    analogDrift.setPitchDrift(pitchCents);
+    analogDrift.setGainJitter(jitterDecibels);
+    analogDrift.setSeed(seed);
+}
+
+template <typename SampleType>
+int VoiceEngine<SampleType>::getNumActiveVoices() const
+{
+    return static_cast<int>(std::count_if(voices.begin(), voices.end(),
+                                          [](const MuVoice<SampleType>& voice) { return voice.isActive(); }));
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::process(const juce::dsp::AudioBlock<SampleType>& block, const juce::MidiBuffer& midiMessages,
+                                      const SampleType* morphX, const SampleType* morphY)
+{
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    process(block, midiMessages, 0, numSamples, morphX, morphY);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::process(const juce::dsp::AudioBlock<SampleType>& block, const juce::MidiBuffer& midiMessages,
+                                      int firstSample, int hostNumSamples, const SampleType* morphX, const SampleType* morphY)
+{
+    block.clear();
+
+    morph.updateSnapshots();
+    applyAntialiasing();
+    applyVoiceLimit();
+    applyMpeChanges();
+    const MorphPositions<SampleType> morphPositions = morphX != nullptr && morphY != nullptr
+                                                    ? MorphPositions<SampleType> { &morph, morphX, morphY }
+                                                    : MorphPositions<SampleType> {};
+
+    forEachSegment(firstSample, static_cast<int>(block.getNumSamples()), hostNumSamples, midiMessages, [&](int start, int length)
+    {
+        renderVoices(block.getSubBlock(static_cast<size_t>(start), static_cast<size_t>(length)),
+                     morphPositions.offsetBy(static_cast<size_t>(start)));
+    });
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::skip(int numSamples, const juce::MidiBuffer& midiMessages)
+{
+    applyAntialiasing();
+    applyVoiceLimit();
+    applyMpeChanges();
+    forEachSegment(0, numSamples, numSamples, midiMessages, [this](int, int length)
+    {
+        for (auto& voice : voices)
+            voice.skipSamples(static_cast<size_t>(length));
+    });
+}
+
+template <typename SampleType>
+bool VoiceEngine<SampleType>::isSilentFor(const juce::MidiBuffer& midiMessages) const
+{
+    if (getNumActiveVoices() > 0)
+        return false;
+
+    for (const auto metadata : midiMessages)
+        if (metadata.getMessage().isNoteOn())
+            return false;
+
+    return true;
+}
+
+template <typename SampleType>
+template <typename SegmentCallback>
+void VoiceEngine<SampleType>::forEachSegment(int firstSample, int numSamples, int hostNumSamples, const juce::MidiBuffer& midiMessages,
+                                             SegmentCallback&& renderSegment)
+{
+    const int endSample = firstSample + numSamples;
+    int position = firstSample;
+
+    // An event exactly on the boundary belongs to the next stretch, the last one also takes those past the end
+    const int lastEventPosition = endSample < hostNumSamples ? endSample - 1 : hostNumSamples;
+
+    // Render up to each event, then apply it, so note timing doesn't depend on the block size
+    for (auto event = firstSample > 0 ? midiMessages.findNextSamplePosition(firstSample) : midiMessages.begin();
+         event != midiMessages.end(); ++event)
+    {
+        const auto metadata = *event;
+        const int eventPosition = juce::jlimit(0, hostNumSamples, metadata.samplePosition);
+        if (eventPosition > lastEventPosition)
+            break;
+
+        if (eventPosition > position)
+        {
+            renderSegment(position - firstSample, eventPosition - position);
+            position = eventPosition;
+        }
+
+        handleMidiEvent(metadata.getMessage());
+    }
+
+    if (position < endSample)
+        renderSegment(position - firstSample, endSample - position);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::applyVolumeAndPan(const juce::dsp::AudioBlock<SampleType>& block, SampleType volume, SampleType pan)
+{
+    if (block.getNumChannels() == 2)
+    {
+        // Equal power panning using sin/cos for stereo
+        const SampleType panRadians = pan * juce::MathConstants<SampleType>::halfPi;
+        block.getSingleChannelBlock(0).multiplyBy(std::cos(panRadians) * volume);
+        block.getSingleChannelBlock(1).multiplyBy(std::sin(panRadians) * volume);
+    }
+    else
+    {
+        // For mono, just apply volume
+        block.multiplyBy(volume);
+    }
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::handleMidiEvent(const juce::MidiMessage& message)
+{
+    if (message.isNoteOn())
+    {
+        auto& voice = findVoiceToStart();
+        const auto index = static_cast<size_t>(&voice - voices.data());
+        voiceStartOrder[index] = ++noteCounter;
+        voice.startNote(message.getNoteNumber(), message.getFloatVelocity(), static_cast<uint32_t>(noteCounter));
+
+        // A note starts wherever its wheel already is
+        const float bend = getNoteBend(message.getChannel());
+        if (bend != 0.0f)
+            voice.setPitchBend(bend);
+
+        // The meter follows the newest note
+        if (meteredVoice >= 0)
+            voices[static_cast<size_t>(meteredVoice)].setHarmonicMeter(nullptr);
+
+        meteredVoice = static_cast<int>(index);
+        voice.setHarmonicMeter(&harmonicMeter);
+        harmonicMeter.setFrequency(static_cast<double>(voice.getBentFrequency()));
+
+        auto& expression = noteExpressions[index];
+        expression.channel = message.getChannel();
+        expression.slide = -1.0f;
+        expression.pressure = 0.0f;
+        if (mpeEnabled)
+            updateNoteShape(index, false);
+    }
+    else if (message.isNoteOff())
+    {
+        // With MPE the same note can be playing on several channels at once
+        for (size_t index = 0; index < voices.size(); ++index)
+            if (voices[index].isActive() && voices[index].getNoteNumber() == message.getNoteNumber()
+                && (! mpeEnabled || noteExpressions[index].channel == message.getChannel()))
+                voices[index].stopNote(true);
+    }
+    else if (message.isAllNotesOff() || message.isAllSoundOff())
+    {
+        for (auto& voice : voices)
+            voice.stopNote(message.isAllNotesOff());
+    }
+    else if (message.isPitchWheel())
+    {
+        handlePitchWheel(message);
+    }
+    else
+    {
+        handleExpression(message);
+    }
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::handleExpression(const juce::MidiMessage& message)
+{
+    // Notes are tracked even with MPE off, so turning it on picks up where each note already is
+    auto applyToNotes = [this, &message](bool matchNoteNumber, auto&& apply)
+    {
+        for (size_t index = 0; index < voices.size(); ++index)
+        {
+            auto& expression = noteExpressions[index];
+            if (! voices[index].isActive() || expression.channel != message.getChannel()
+                || (matchNoteNumber && voices[index].getNoteNumber() != message.getNoteNumber()))
+                continue;
+
+            apply(expression);
+            if (mpeEnabled)
+                updateNoteShape(index, false);
+        }
+    };
+
+    if (message.isController() && message.getControllerNumber() == 74)
+        applyToNotes(false, [&](NoteExpression& expression) { expression.slide = static_cast<float>(message.getControllerValue()) / 127.0f; });
+    else if (message.isChannelPressure())
+        applyToNotes(false, [&](NoteExpression& expression) { expression.pressure = static_cast<float>(message.getChannelPressureValue()) / 127.0f; });
+    else if (message.isAftertouch())
+        applyToNotes(true, [&](NoteExpression& expression) { expression.pressure = static_cast<float>(message.getAfterTouchValue()) / 127.0f; });
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::handlePitchWheel(const juce::MidiMessage& message)
+{
+    const int channel = message.getChannel();
+    const float position = juce::jlimit(-1.0f, 1.0f, static_cast<float>(message.getPitchWheelValue() - 8192) / 8191.0f);
+    if (mpeEnabled && channel != 1)
+        channelPitchBends[static_cast<size_t>(channel)] = position;
+    else
+        masterPitchBend = position;
+
+    for (size_t index = 0; index < voices.size(); ++index)
+    {
+        if (! voices[index].isActive())
+            continue;
+
+        const int noteChannel = noteExpressions[index].channel;
+        if (mpeEnabled && channel != 1 && noteChannel != channel)
+            continue;
+
+        voices[index].setPitchBend(getNoteBend(noteChannel));
+        if (static_cast<int>(index) == meteredVoice)
+            harmonicMeter.setFrequency(static_cast<double>(voices[index].getBentFrequency()));
+    }
+}
+
+template <typename SampleType>
+float VoiceEngine<SampleType>::getNoteBend(int channel) const
+{
+    float semitones = masterPitchBend * pitchBendSemitones;
+    if (mpeEnabled && channel != 1)
+        semitones += channelPitchBends[static_cast<size_t>(channel)] * mpeNoteBendSemitones;
+
+    return semitones;
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::applyVoiceLimit()
+{
+    const int requested = requestedVoiceLimit.load();
+    if (requested == voiceLimit)
+        return;
+
+    // Notes that lose their voice fade out with their normal release, rather than being cut
+    if (requested < voiceLimit)
+        for (int index = requested; index < voiceLimit; ++index)
+            if (voices[static_cast<size_t>(index)].isActive())
+                voices[static_cast<size_t>(index)].stopNote(true);
+
+    voiceLimit = requested;
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::applyMpeChanges()
+{
+    bool profileChanged = false;
+    bool shapesChanged = false;
+    if (shapeProfileChanged.load() || noteShapesChanged.load())
+    {
+        // Try again next block
+        const juce::SpinLock::ScopedTryLockType lock(pendingLock);
+        if (lock.isLocked())
+        {
+            noteShapes = pendingNoteShapes;
+            profileChanged = shapeProfileChanged.exchange(false);
+            shapesChanged = noteShapesChanged.exchange(false);
+        }
+    }
+
+    // The panning changes every set, held or cached, so the cached ones go even with MPE off
+    if (profileChanged)
+        coefficientSets.refresh(noteShapes.profile);
+
+    const bool requested = mpeRequested.load();
+    if (requested != mpeEnabled)
+    {
+        mpeEnabled = requested;
+
+        for (size_t index = 0; index < voices.size(); ++index)
+        {
+            if (! mpeEnabled)
+                releaseNoteShape(index);
+            else if (voices[index].isActive())
+                updateNoteShape(index, true);
+
+            // The member channels' bends only count with MPE on
+            if (voices[index].isActive())
+                voices[index].setPitchBend(getNoteBend(noteExpressions[index].channel));
+        }
+
+        return;
+    }
+
+    // A shape knob only changes which set each note maps to
+    if (mpeEnabled && (profileChanged || shapesChanged))
+        for (size_t index = 0; index < voices.size(); ++index)
+            if (voices[index].isActive())
+                updateNoteShape(index, profileChanged);
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::updateNoteShape(size_t voiceIndex, bool reload)
+{
+    auto& expression = noteExpressions[voiceIndex];
+    const float x = expression.slide >= 0.0f ? expression.slide : noteShapes.shapeX;
+    const float y = noteShapes.shapeY + expression.pressure * (1.0f - noteShapes.shapeY);
+    const auto key = coefficientSets.quantise(x, y);
+
+    if (expression.shapeEntry >= 0 && coefficientSets.getKey(expression.shapeEntry) == key)
+    {
+        if (! reload)
+            return;
+    }
+    else
+    {
+        // Take the new set before letting go of the old one, so a shared set is never dropped in between
+        const int entry = coefficientSets.acquire(key, noteShapes.profile);
+        if (expression.shapeEntry >= 0)
+            coefficientSets.release(expression.shapeEntry);
+
+        expression.shapeEntry = entry;
+    }
+
+    voices[voiceIndex].setCoefficientOverride(coefficientSets.getCoefficients(expression.shapeEntry, 0),
+                                              coefficientSets.getCoefficients(expression.shapeEntry, 1),
+                                              coefficientSets.getNumCoefficients(expression.shapeEntry));
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::releaseNoteShape(size_t voiceIndex)
+{
+    auto& expression = noteExpressions[voiceIndex];
+    if (expression.shapeEntry >= 0)
+        coefficientSets.release(expression.shapeEntry);
+
+    expression.shapeEntry = -1;
+    voices[voiceIndex].clearCoefficientOverride();
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::renderVoices(const juce::dsp::AudioBlock<SampleType>& block, MorphPositions<SampleType> morphPositions)
+{
+    // The profile the shape knobs last set, taken over before any segment's batch is worked out with it
+    harmonicEnvelopes.updateProfile();
+
+    if (morphPositions.isActive() || mpeEnabled || ! harmonicEnvelopes.isActive())
+    {
+        for (auto& voice : voices)
+            if (voice.isActive())
+                voice.renderNextBlock(block, morphPositions);
+
+        return;
+    }
+
+    // Every sounding voice's envelope ticks for this segment go through the coefficient transform together
+    harmonicEnvelopes.clearVoices();
+    for (int index = 0; index < maxVoices; ++index)
+    {
+        const auto& voice = voices[static_cast<size_t>(index)];
+        if (voice.isActive())
+            harmonicEnvelopes.addVoice(index, voice.getNextControlTick(), voice.getSamplesUntilControlTick(), block.getNumSamples(),
+                                       voice.getNoteKey());
+    }
+
+    harmonicEnvelopes.calculate();
+
+    for (int index = 0; index < maxVoices; ++index)
+    {
+        auto& voice = voices[static_cast<size_t>(index)];
+        if (voice.isActive())
+            voice.renderNextBlock(block, morphPositions, harmonicEnvelopes.getCoefficients(index));
+    }
+}
+
+template <typename SampleType>
+void VoiceEngine<SampleType>::updateEnvelopeProfile()
+{
+    // All voices share the same harmonic profile, so any voice's gains will do
+    const auto& voice = voices[0];
+    harmonicEnvelopes.setProfile(voice.getCurrentHarmonicGains(), voice.getChannelHarmonicGains(0),
+                                 voice.getChannelHarmonicGains(1), voice.isStereo());
+}
+
+template <typename SampleType>
+MuVoice<SampleType>& VoiceEngine<SampleType>::findVoiceToStart()
+{
+    const auto numVoices = static_cast<size_t>(voiceLimit);
+    for (size_t index = 0; index < numVoices; ++index)
+        if (! voices[index].isActive())
+            return voices[index];
+
+    // Every voice is busy, steal the one that has been playing longest
+    auto oldest = std::min_element(voiceStartOrder.begin(), voiceStartOrder.begin() + static_cast<std::ptrdiff_t>(numVoices));
+    return voices[static_cast<size_t>(oldest - voiceStartOrder.begin())];
+}
+
+//==============================================================================
+template class VoiceEngine<float>;
+template class VoiceEngine<double>;
+
+} // namespace rosy
\ No newline at end of file
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include "MuVoice.h"
+#include "CoefficientSetPool.h"
+
+namespace rosy {
+
+/**
+ * @brief The synth engine shared by the plugin and the offline renderer.
+ *
+ * Owns a fixed pool of MuVoices, allocates them from incoming MIDI (stealing the oldest note when the pool
+ * is full) and renders them with sample-accurate event timing by splitting each block at the MIDI events.
+ * The output stage (volume and panning) lives here too so everything that renders Rosemary sounds the same.
+ *
+ * With MPE on, each note's slide (CC74) sets its shape X and its pressure (channel pressure on the note's
+ * channel, or polyphonic aftertouch) pushes its shape Y from the knob's value towards 1. Until a note gets a
+ * slide message its shape X stays on the knob. Per-note shapes come from a CoefficientSetPool, so notes with
+ * the same quantised shape share one set.
+ *
+ * The pitch wheel bends every note by up to pitchBendSemitones either way, from whichever channel it comes on.
+ * With MPE on that only holds for the master channel (channel 1), each member channel bends its own notes by up
+ * to mpeNoteBendSemitones on top, the ranges the MPE spec starts a zone with.
+ *
+ * Every note gets its own key from the order notes were started in, which picks its AnalogDrift curves, so a
+ * session played the same way with the same seed drifts the same way.
+ */
+template <typename SampleType>
+class VoiceEngine
+{
+public:
+    static constexpr int maxVoices { 8 };
+    static constexpr float pitchBendSemitones { 2.0f };
+    static constexpr float mpeNoteBendSemitones { 48.0f };
+
+    VoiceEngine();
+
+    //==============================================================================
+    // The voices' render buffers come from the arena, sized for spec.maximumBlockSize samples per process() call
+    void prepare(const juce::dsp::ProcessSpec& spec, ScratchArena& arena);
+    void reset();
+
+    //==============================================================================
+    void setShapeX(float x);
+    void setShapeY(float y);
+    void setShapeXPan(float pan);
+    void setShapeYPan(float pan);
+
+    // Applied by the audio thread at the start of the next block, like the limits below
+    void setAntialiasing(typename MuOscillator<SampleType>::Antialiasing antialiasing);
+
+    // Per-harmonic phases of the shape, see MuOscillator::setHarmonicPhases(), message thread only
+    void setHarmonicPhases(const std::vector<float>& phases);
+    const std::vector<float>& getHarmonicPhases() const { return voices[0].getHarmonicPhases(); }
+
+    //==============================================================================
+    // Quality limits, see QualityGovernor. Each caps the setting above without changing it, so lifting the
+    // limit goes straight back to what was chosen.
+    // Highest anti-aliasing order the voices may use, 0 turns it off. Applied at the start of the next block.
+    void setMaxAntialiasingOrder(int order) { requestedMaxAntialiasingOrder.store(std::max(order, 0)); }
+
+    // Most harmonics every shaping path is worked out with, message thread only
+    void setHarmonicLimit(size_t limit);
+
+    // Voices that may be playing; notes on voices above the limit are released at the start of the next block
+    void setVoiceLimit(int limit) { requestedVoiceLimit.store(juce::jlimit(1, maxVoices, limit)); }
+
+    // Per-harmonic decay of each note's spectrum, see HarmonicEnvelopes, 0 keeps the spectrum static.
+    // Not applied while morphing or with MPE on, see renderVoices().
+    void setHarmonicDecay(float seconds) { harmonicEnvelopes.setDecay(seconds); }
+
+    // Through-zero FM of every voice, see MuOscillator::setFrequencyModulation(), audio thread only
+    void setFrequencyModulation(float ratio, float index);
+
+    // Per-note pitch drift and harmonic gain jitter, see AnalogDrift, audio thread only. The jitter takes the
+    // voices through the harmonic envelopes, so like them it doesn't apply while morphing or with MPE on,
+    // and the editor disables both controls in those modes.
+    void setAnalogDrift(float pitchCents, float jitterDecibels, uint32_t seed);
+
+    // Takes effect at the start of the next block, so it's safe from any thread
+    void setMpeEnabled(bool shouldBeEnabled) { mpeRequested.store(shouldBeEnabled); }
+
+    // The shared per-note shapes, for their hit rate
+    const CoefficientSetPool<SampleType>& getCoefficientSetPool() const { return coefficientSets; }
+
+    // All voices share the same harmonic profile, so any voice's gains will do
+    const std::vector<float>& getCurrentHarmonicGains() const { return voices[0].getCurrentHarmonicGains(); }
+
+    // Changes whenever the shape does, so readers of the gains above can tell when they're out of date
+    uint32_t getCoefficientSetId() const { return coefficientSetId.load(); }
+
+    int getNumActiveVoices() const;
+
+    // Measured harmonic levels of the newest note's oscillator, before its envelope
+    const HarmonicMeter<SampleType>& getHarmonicMeter() const { return harmonicMeter; }
+
+    // The snapshots the voices morph between when process() is given morph positions
+    CoefficientMorph<SampleType>& getMorph() { return morph; }
+
+    // Default morph corners: the corners of the shape X/Y plane, so the morph starts out spanning every shape
+    static void setShapeCornerSnapshots(CoefficientMorph<SampleType>& morphToSet);
+
+    //==============================================================================
+    // Overwrites the block with the voices' output, handling the MIDI events at their sample positions.
+    // If per-sample morph positions are given, the voices morph between the snapshots instead of using the shape
+    // (and per-note shapes or the harmonic envelopes). Per-note shapes take precedence over the envelopes.
+    void process(const juce::dsp::AudioBlock<SampleType>& block, const juce::MidiBuffer& midiMessages,
+                 const SampleType* morphX = nullptr, const SampleType* morphY = nullptr);
+
+    // Renders samples [firstSample, firstSample + block length) of a host block hostNumSamples long, handling only
+    // the events that fall in that range (events past the end of the host block go to its last stretch). Calling
+    // this for consecutive stretches gives the same output as one process() call over the whole block.
+    void process(const juce::dsp::AudioBlock<SampleType>& block, const juce::MidiBuffer& midiMessages,
+                 int firstSample, int hostNumSamples, const SampleType* morphX = nullptr, const SampleType* morphY = nullptr);
+
+    // Handles the MIDI and moves every voice on by numSamples like process() would, without rendering anything
+    void skip(int numSamples, const juce::MidiBuffer& midiMessages);
+
+    // True when no voice is sounding and the MIDI can't start one, so the block will be all zeros
+    bool isSilentFor(const juce::MidiBuffer& midiMessages) const;
+
+    // Equal power panning for stereo, plain volume otherwise
+    static void applyVolumeAndPan(const juce::dsp::AudioBlock<SampleType>& block, SampleType volume, SampleType pan);
+
+private:
+    // Calls renderSegment(start, length) for each stretch between MIDI events in [firstSample, firstSample + numSamples)
+    // of the host block, handling the events in between. Starts are relative to firstSample.
+    template <typename SegmentCallback>
+    void forEachSegment(int firstSample, int numSamples, int hostNumSamples, const juce::MidiBuffer& midiMessages,
+                        SegmentCallback&& renderSegment);
+
+    void handleMidiEvent(const juce::MidiMessage& message);
+    void renderVoices(const juce::dsp::AudioBlock<SampleType>& block, MorphPositions<SampleType> morphPositions);
+    void updateEnvelopeProfile();
+
+    void applyAntialiasing();
+    void applyVoiceLimit();
+
+    // Per-note shapes, audio thread only
+    void applyMpeChanges();
+    void handleExpression(const juce::MidiMessage& message);
+    void handlePitchWheel(const juce::MidiMessage& message);
+    float getNoteBend(int channel) const;
+    void updateNoteShape(size_t voiceIndex, bool reload);
+    void releaseNoteShape(size_t voiceIndex);
+    MuVoice<SampleType>& findVoiceToStart();
+
+    std::array<MuVoice<SampleType>, maxVoices> voices;
+    CoefficientMorph<SampleType> morph;
+    HarmonicEnvelopes<SampleType> harmonicEnvelopes;
+    AnalogDrift analogDrift;
+    HarmonicMeter<SampleType> harmonicMeter;
+    int meteredVoice { -1 };
+
+    // What each voice's note is doing on its own MIDI channel, and the shared set it's shaped with
+    struct NoteExpression
+    {
+        int channel { 1 };
+        float slide { -1.0f };  // Negative until the note's first slide message
+        float pressure { 0.0f };
+        int shapeEntry { -1 };
+    };
+
+    std::array<NoteExpression, maxVoices> noteExpressions;
+
+    // Pitch wheel positions from -1 to 1: the one every note follows, and each MIDI channel's own for MPE
+    float masterPitchBend { 0.0f };
+    std::array<float, 17> channelPitchBends {};
+    CoefficientSetPool<SampleType> coefficientSets;
+    bool mpeEnabled { false };
+    std::atomic<bool> mpeRequested { false };
+
+    // The knobs every note's shape starts from, and the profile the shared sets are worked out with
+    struct NoteShapes
+    {
+        float shapeX { 0.0f };
+        float shapeY { 0.0f };
+        typename CoefficientSetPool<SampleType>::Profile profile;
+    };
+
+    // What the per-note shapes use, and what the message thread last set. The pending copy is handed over
+    // under a SpinLock the audio thread only ever tries, so a set is never worked out from half a change.
+    NoteShapes noteShapes;
+    NoteShapes pendingNoteShapes;
+    std::atomic<bool> noteShapesChanged { false };
+    std::atomic<bool> shapeProfileChanged { false };
+    juce::SpinLock pendingLock;
+    std::atomic<uint32_t> coefficientSetId { 0 };
+
+    // Requested from any thread, applied to the voices on the audio thread
+    std::atomic<int> requestedAntialiasing { static_cast<int>(MuOscillator<SampleType>::Antialiasing::off) };
+    std::atomic<int> requestedMaxAntialiasingOrder { 2 };
+    int appliedAntialiasing { static_cast<int>(MuOscillator<SampleType>::Antialiasing::off) };
+    int voiceLimit { maxVoices };
+    std::atomic<int> requestedVoiceLimit { maxVoices };
+
+    // Order in which voices were started, used to pick the oldest note to steal
+    std::array<uint64_t, maxVoices> voiceStartOrder {};
+    uint64_t noteCounter { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(VoiceEngine)
+};
+
+} // namespace rosy
\ No newline at end of file
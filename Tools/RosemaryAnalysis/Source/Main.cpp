@@ -0,0 +1,234 @@
+/*
+  ==============================================================================
+
+    Oscillator regression suite: renders MuOscillator over a grid of sample
+    rates, frequencies and shapes, in both precisions, and checks each render
+    against the double precision additive reference from HarmonicAnalysis.
+
+    For every case it records the residual against the reference, the worst
+    harmonic level error and the time process() took per sample, prints a
+    summary, and writes every case to a CSV file so runs can be compared over
+    time. It exits with 1 if any case is past a threshold, so it can gate a
+    build.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include "../../../Source/HarmonicAnalysis.h"
+#include "../../../Source/MuOscillator.h"
+
+namespace
+{
+    struct Settings
+    {
+        std::vector<double> sampleRates { 44100.0, 48000.0, 96000.0 };
+        std::vector<double> frequencies { 55.0, 220.0, 440.0, 1000.0 };
+        int blockSize = 512;
+        double seconds = 0.5;
+        juce::File csvFile;
+
+        // Float renders measure -44 to -65 dB against the reference with the default grid, double ones past -110 dB
+        double maxFloatResidualDb = -40.0;
+        double maxDoubleResidualDb = -90.0;
+        double maxLevelErrorDb = 0.1;
+
+        // Depends on the machine, so it's off unless asked for
+        double maxNanosecondsPerSample = 0.0;
+    };
+
+    // The corners and centre of the shape plane
+    const std::array<std::pair<float, float>, 5> shapes {{ { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f },
+                                                          { 1.0f, 1.0f }, { 0.5f, 0.5f } }};
+
+    struct Result
+    {
+        double residualDb = 0.0;
+        double maxLevelErrorDb = 0.0;
+        double nanosecondsPerSample = 0.0;
+
+        // The reference doesn't alias, so the residual only means something with every harmonic below Nyquist
+        bool residualMeasured = false;
+    };
+
+    //==============================================================================
+    template <typename SampleType>
+    Result analyse(const Settings& settings, double sampleRate, double frequency, float shapeX, float shapeY)
+    {
+        rosy::ScratchArena arena;
+        rosy::MuOscillator<SampleType> oscillator;
+        oscillator.prepare({ sampleRate, static_cast<juce::uint32>(settings.blockSize), 1 }, arena);
+        oscillator.setShapeX(shapeX);
+        oscillator.setShapeY(shapeY);
+        oscillator.setFrequency(static_cast<SampleType>(frequency));
+
+        const int numSamples = static_cast<int>(settings.seconds * sampleRate);
+        juce::AudioBuffer<SampleType> buffer(1, numSamples);
+        juce::dsp::AudioBlock<SampleType> block(buffer);
+
+        // Only process() is timed, in the block size a host would use
+        int64_t ticks = 0;
+        for (int start = 0; start < numSamples; start += settings.blockSize)
+        {
+            auto subBlock = block.getSubBlock(static_cast<size_t>(start), static_cast<size_t>(juce::jmin(settings.blockSize, numSamples - start)));
+            juce::dsp::ProcessContextReplacing<SampleType> context(subBlock);
+
+            const auto blockStart = juce::Time::getHighResolutionTicks();
+            oscillator.process(context);
+            ticks += juce::Time::getHighResolutionTicks() - blockStart;
+        }
+
+        std::vector<float> samples(static_cast<size_t>(numSamples));
+        std::transform(buffer.getReadPointer(0), buffer.getReadPointer(0) + numSamples, samples.begin(),
+                       [](SampleType sample) { return static_cast<float>(sample); });
+
+        const auto& gains = oscillator.getCurrentHarmonicGains();
+        const auto levels = rosy::HarmonicAnalysis::measureHarmonicLevels(samples.data(), numSamples, frequency, sampleRate,
+                                                                          static_cast<int>(gains.size()));
+        const auto errors = rosy::HarmonicAnalysis::calculateLevelErrorsDb(levels, gains);
+
+        Result result;
+        result.nanosecondsPerSample = juce::Time::highResolutionTicksToSeconds(ticks) * 1.0e9 / numSamples;
+
+        // Harmonics too quiet to measure, or above Nyquist, don't count
+        size_t highestHarmonic = 0;
+        for (size_t harmonic = 0; harmonic < errors.size(); ++harmonic)
+        {
+            if (gains[harmonic] <= 1.0e-4f)
+                continue;
+
+            highestHarmonic = harmonic + 1;
+            if (frequency * static_cast<double>(harmonic + 1) < sampleRate * 0.5)
+                result.maxLevelErrorDb = juce::jmax(result.maxLevelErrorDb, std::abs(errors[harmonic]));
+        }
+
+        result.residualMeasured = frequency * static_cast<double>(highestHarmonic) < sampleRate * 0.5;
+        if (result.residualMeasured)
+        {
+            const auto reference = rosy::HarmonicAnalysis::renderAdditiveReference(gains, frequency, sampleRate, numSamples);
+            result.residualDb = rosy::HarmonicAnalysis::measureResidualDb(samples.data(), reference.data(), numSamples);
+        }
+
+        return result;
+    }
+
+    //==============================================================================
+    std::vector<double> parseList(const juce::String& text)
+    {
+        std::vector<double> values;
+        for (const auto& token : juce::StringArray::fromTokens(text, ",", ""))
+            values.push_back(token.trim().getDoubleValue());
+
+        return values;
+    }
+
+    int runAnalysis(const juce::ArgumentList& args)
+    {
+        auto option = [&args](const juce::String& name, double defaultValue)
+        {
+            return args.containsOption(name) ? args.getValueForOption(name).getDoubleValue() : defaultValue;
+        };
+
+        Settings settings;
+        if (args.containsOption("--samplerates"))
+            settings.sampleRates = parseList(args.getValueForOption("--samplerates"));
+        if (args.containsOption("--frequencies"))
+            settings.frequencies = parseList(args.getValueForOption("--frequencies"));
+
+        settings.blockSize = static_cast<int>(option("--blocksize", settings.blockSize));
+        settings.seconds = option("--seconds", settings.seconds);
+        settings.csvFile = args.containsOption("--csv") ? args.getFileForOption("--csv")
+                                                        : juce::File::getCurrentWorkingDirectory().getChildFile("RosemaryAnalysis.csv");
+        settings.maxFloatResidualDb = option("--max-float-residual", settings.maxFloatResidualDb);
+        settings.maxDoubleResidualDb = option("--max-double-residual", settings.maxDoubleResidualDb);
+        settings.maxLevelErrorDb = option("--max-level-error", settings.maxLevelErrorDb);
+        settings.maxNanosecondsPerSample = option("--max-ns-per-sample", settings.maxNanosecondsPerSample);
+
+        auto isPositive = [](double value) { return value > 0.0; };
+        if (settings.sampleRates.empty() || settings.frequencies.empty()
+            || ! std::all_of(settings.sampleRates.begin(), settings.sampleRates.end(), isPositive)
+            || ! std::all_of(settings.frequencies.begin(), settings.frequencies.end(), isPositive)
+            || settings.blockSize <= 0 || settings.seconds <= 0.0)
+            juce::ConsoleApplication::fail("Sample rates, frequencies, block size and length must be positive");
+
+        juce::String csv = "precision,samplerate,frequency,shapeX,shapeY,residual_db,max_level_error_db,ns_per_sample,passed\n";
+        int numCases = 0;
+        int numFailed = 0;
+        double worstResidual[2] = { -200.0, -200.0 };
+        double worstLevelError = 0.0;
+        double worstNanoseconds[2] = { 0.0, 0.0 };
+
+        auto runCase = [&](auto sampleType, double sampleRate, double frequency, float shapeX, float shapeY)
+        {
+            using SampleType = decltype(sampleType);
+            constexpr bool isDouble = std::is_same<SampleType, double>::value;
+
+            const auto result = analyse<SampleType>(settings, sampleRate, frequency, shapeX, shapeY);
+            const double maxResidualDb = isDouble ? settings.maxDoubleResidualDb : settings.maxFloatResidualDb;
+            const bool passed = (! result.residualMeasured || result.residualDb <= maxResidualDb)
+                             && result.maxLevelErrorDb <= settings.maxLevelErrorDb
+                             && (settings.maxNanosecondsPerSample <= 0.0 || result.nanosecondsPerSample <= settings.maxNanosecondsPerSample);
+
+            ++numCases;
+            numFailed += passed ? 0 : 1;
+            if (result.residualMeasured)
+                worstResidual[isDouble] = juce::jmax(worstResidual[isDouble], result.residualDb);
+            worstLevelError = juce::jmax(worstLevelError, result.maxLevelErrorDb);
+            worstNanoseconds[isDouble] = juce::jmax(worstNanoseconds[isDouble], result.nanosecondsPerSample);
+
+            const juce::String precision = isDouble ? "double" : "float";
+            csv << precision << "," << sampleRate << "," << frequency << "," << shapeX << "," << shapeY << ","
+                << (result.residualMeasured ? juce::String(result.residualDb, 2) : juce::String()) << ","
+                << juce::String(result.maxLevelErrorDb, 4) << "," << juce::String(result.nanosecondsPerSample, 2) << ","
+                << (passed ? 1 : 0) << "\n";
+
+            if (! passed)
+                std::cout << "  FAILED " << precision << " " << sampleRate << " Hz, " << frequency << " Hz note, shape ("
+                          << shapeX << ", " << shapeY << "): residual "
+                          << (result.residualMeasured ? juce::String(result.residualDb, 1) + " dB" : juce::String("-"))
+                          << ", level error " << juce::String(result.maxLevelErrorDb, 3) << " dB, "
+                          << juce::String(result.nanosecondsPerSample, 1) << " ns per sample" << std::endl;
+        };
+
+        std::cout << "Rosemary oscillator analysis" << std::endl;
+
+        for (const auto sampleRate : settings.sampleRates)
+            for (const auto frequency : settings.frequencies)
+                for (const auto& [shapeX, shapeY] : shapes)
+                {
+                    runCase(float {}, sampleRate, frequency, shapeX, shapeY);
+                    runCase(double {}, sampleRate, frequency, shapeX, shapeY);
+                }
+
+        if (! settings.csvFile.replaceWithText(csv))
+            juce::ConsoleApplication::fail("Couldn't write " + settings.csvFile.getFullPathName());
+
+        std::cout << "  Worst residual:    " << juce::String(worstResidual[0], 1) << " dB float, "
+                  << juce::String(worstResidual[1], 1) << " dB double" << std::endl
+                  << "  Worst level error: " << juce::String(worstLevelError, 3) << " dB" << std::endl
+                  << "  Slowest render:    " << juce::String(worstNanoseconds[0], 1) << " ns per sample float, "
+                  << juce::String(worstNanoseconds[1], 1) << " ns per sample double" << std::endl
+                  << "  " << numFailed << " of " << numCases << " cases past a threshold, written to "
+                  << settings.csvFile.getFullPathName() << std::endl;
+
+        return numFailed == 0 ? 0 : 1;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        std::cout << "Usage: " << args.executableName << " [--samplerates 44100,48000,96000] [--frequencies 55,220,440,1000]" << std::endl
+                  << "       [--blocksize 512] [--seconds 0.5] [--csv RosemaryAnalysis.csv] [--max-float-residual -40]" << std::endl
+                  << "       [--max-double-residual -90] [--max-level-error 0.1] [--max-ns-per-sample 0 (off)]" << std::endl << std::endl
+                  << "Exits with 1 if any case is past a threshold." << std::endl;
+        return 0;
+    }
+
+    return juce::ConsoleApplication::invokeCatchingFailures ([&] { return runAnalysis (args); });
+}
@@ -0,0 +1,852 @@
+/*
+  ==============================================================================
+
+    Many-instance benchmark: runs N RosemaryAudioProcessors in one process,
+    driven by a simulated host the way a large session drives them.
+
+    The host has a pool of audio threads that share out the instances every
+    period, the way multi-threaded hosts do, while the main thread runs the
+    message loop. Every instance has its own MIDI and its own automation of
+    the shape and morph parameters.
+
+    Four passes:
+    1. Solo: a few instances are rendered on their own, offline. Their output
+       is the reference, and their block times the uncontended baseline.
+    2. Crowd, offline: all N instances as fast as they'll go. The same
+       instances must give bit-identical output to the solo pass, anything
+       else is state shared between instances. The slowdown over the solo
+       block times is the cost of the shared caches and memory bandwidth.
+       Startup is reported from the same instances: construction, prepare
+       and the first block after it against the instance's median block.
+    3. Crowd, real time: all N instances paced to the period, with the CPU
+       load monitor and quality governor live. Reports total CPU, missed
+       periods and, on Linux, hardware cache counters.
+    4. Kernels: a single oscillator on its own in float and in double, with
+       each anti-aliasing order and with 2x and 4x oversampling instead, for
+       the per sample cost of each precision and of each way of fighting
+       aliasing, and with FM against without it, which should stay well
+       under twice the cost.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include "../../../Source/PluginProcessor.h"
+
+#if JUCE_LINUX
+ #include <linux/perf_event.h>
+ #include <sys/ioctl.h>
+ #include <sys/resource.h>
+ #include <sys/syscall.h>
+ #include <unistd.h>
+#elif JUCE_MAC
+ #include <mach/mach.h>
+ #include <sys/resource.h>
+#elif JUCE_WINDOWS
+ #include <windows.h>
+ #include <psapi.h>
+#endif
+
+namespace
+{
+    struct Settings
+    {
+        int numInstances = 100;
+        int numThreads = 1;
+        int blockSize = 256;
+        double sampleRate = 48000.0;
+        double seconds = 10.0;
+        int numVerified = 8;
+        bool paced = true;
+    };
+
+    //==============================================================================
+    // Resident memory of the whole process in bytes, 0 where it can't be read
+    int64_t getResidentBytes()
+    {
+       #if JUCE_LINUX
+        long pages = 0, resident = 0;
+        if (auto* statm = std::fopen("/proc/self/statm", "r"))
+        {
+            if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+                resident = 0;
+
+            std::fclose(statm);
+        }
+        return static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE);
+       #elif JUCE_MAC
+        mach_task_basic_info info;
+        mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+        if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+            return 0;
+        return static_cast<int64_t>(info.resident_size);
+       #elif JUCE_WINDOWS
+        PROCESS_MEMORY_COUNTERS counters;
+        if (! K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+            return 0;
+        return static_cast<int64_t>(counters.WorkingSetSize);
+       #else
+        return 0;
+       #endif
+    }
+
+    // User plus system CPU time of the whole process in seconds
+    double getProcessCpuSeconds()
+    {
+       #if JUCE_LINUX || JUCE_MAC
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+             + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1.0e-6;
+       #elif JUCE_WINDOWS
+        FILETIME creation, exit, kernel, user;
+        if (! GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+            return 0.0;
+
+        auto toSeconds = [](const FILETIME& time)
+        {
+            return static_cast<double>((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1.0e-7;
+        };
+        return toSeconds(kernel) + toSeconds(user);
+       #else
+        return 0.0;
+       #endif
+    }
+
+    //==============================================================================
+    /**
+     * Hardware counters for this process, Linux only. The counters are inherited by threads created after
+     * they're opened, so they have to be opened before the host's audio threads start and read after
+     * they've been joined.
+     */
+    class CacheCounters
+    {
+    public:
+        CacheCounters()
+        {
+           #if JUCE_LINUX
+            constexpr uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D
+                                           | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                           | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+            open("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+            open("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+            open("cache references", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES);
+            open("cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+            open("L1D read misses", PERF_TYPE_HW_CACHE, l1dReadMiss);
+           #endif
+        }
+
+        ~CacheCounters()
+        {
+           #if JUCE_LINUX
+            for (auto& counter : counters)
+                close(counter.fd);
+           #endif
+        }
+
+        bool isAvailable() const { return ! counters.empty(); }
+
+        // Prints each counter per processed block
+        void report(int64_t numBlocks) const
+        {
+            if (! isAvailable())
+            {
+                std::cout << "  Cache counters:    unavailable (needs Linux and perf_event_paranoid <= 2)" << std::endl;
+                return;
+            }
+
+           #if JUCE_LINUX
+            std::cout << "  Per instance block:" << std::endl;
+
+            for (const auto& counter : counters)
+            {
+                uint64_t value = 0;
+                if (read(counter.fd, &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value)))
+                    continue;
+
+                std::cout << "    " << juce::String(counter.name).paddedRight(' ', 18)
+                          << juce::String(static_cast<double>(value) / static_cast<double>(juce::jmax<int64_t>(1, numBlocks)), 0) << std::endl;
+            }
+           #else
+            juce::ignoreUnused(numBlocks);
+           #endif
+        }
+
+    private:
+       #if JUCE_LINUX
+        void open(const char* name, uint32_t type, uint64_t config)
+        {
+            perf_event_attr attributes {};
+            attributes.size = sizeof(attributes);
+            attributes.type = type;
+            attributes.config = config;
+            attributes.inherit = 1;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+
+            const auto fd = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+            if (fd >= 0)
+                counters.push_back({ name, fd });
+        }
+       #endif
+
+        struct Counter
+        {
+            const char* name;
+            int fd;
+        };
+
+        std::vector<Counter> counters;
+    };
+
+    //==============================================================================
+    /**
+     * One plugin instance with what the host keeps for it: its buffers, its MIDI and automation, and what
+     * it measured. Everything the audio threads touch is allocated up front.
+     */
+    class Instance
+    {
+    public:
+        Instance(int index, const Settings& settings, int64_t numBlocks)
+            : index(index),
+              blockSize(settings.blockSize),
+              sampleRate(settings.sampleRate),
+              buffer(2, settings.blockSize),
+              random(index + 1)
+        {
+            const auto constructionStart = juce::Time::getHighResolutionTicks();
+            processor = std::make_unique<RosemaryAudioProcessor>();
+            constructionTicks = juce::Time::getHighResolutionTicks() - constructionStart;
+
+            // A spread of the configurations a session has, the same for every run of an index
+            setParameter("antialiasing", static_cast<float>(index % 3));
+            setParameter("morph", index % 3 == 1 ? 1.0f : 0.0f);
+            setParameter("fmIndex", index % 4 == 3 ? 2.0f : 0.0f);
+            setParameter("harmonicDecay", index % 5 == 2 ? 1.5f : 0.0f);
+
+            shapeX = processor->getParameters().getParameter("shapeX");
+            shapeY = processor->getParameters().getParameter("shapeY");
+            morphX = processor->getParameters().getParameter("morphX");
+            morphY = processor->getParameters().getParameter("morphY");
+
+            // Each instance sweeps at its own rate, so no two send the same automation
+            lfoRate = 0.05 + 0.02 * static_cast<double>(index % 11);
+            lfoOffset = static_cast<double>(index) * 0.137;
+
+            midi.ensureSize(256);
+            blockTicks.resize(static_cast<size_t>(numBlocks));
+        }
+
+        // Message thread
+        void prepare(bool nonRealtime)
+        {
+            processor->setNonRealtime(nonRealtime);
+            processor->setRateAndBufferSizeDetails(sampleRate, blockSize);
+
+            const auto prepareStart = juce::Time::getHighResolutionTicks();
+            processor->prepareToPlay(sampleRate, blockSize);
+            prepareTicks = juce::Time::getHighResolutionTicks() - prepareStart;
+        }
+
+        // Audio thread
+        void processBlock(int64_t blockIndex)
+        {
+            const double time = static_cast<double>(blockIndex * blockSize) / sampleRate;
+            const double phase = juce::MathConstants<double>::twoPi * (lfoRate * time + lfoOffset);
+            automate(shapeX, 0.5 + 0.45 * std::sin(phase));
+            automate(shapeY, 0.5 + 0.45 * std::sin(1.3 * phase));
+            automate(morphX, 0.5 + 0.5 * std::sin(0.7 * phase));
+            automate(morphY, 0.5 + 0.5 * std::cos(0.9 * phase));
+
+            fillMidi();
+            buffer.clear();
+
+            const auto startTicks = juce::Time::getHighResolutionTicks();
+            {
+                const juce::ScopedLock lock(processor->getCallbackLock());
+                processor->processBlock(buffer, midi);
+            }
+            blockTicks[static_cast<size_t>(blockIndex)] = juce::Time::getHighResolutionTicks() - startTicks;
+
+            // FNV-1a of the output, to compare runs bit for bit
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            {
+                const auto* samples = buffer.getReadPointer(channel);
+                for (int sample = 0; sample < blockSize; ++sample)
+                {
+                    uint32_t bits;
+                    std::memcpy(&bits, samples + sample, sizeof(bits));
+                    hash = (hash ^ bits) * 0x100000001b3ull;
+                }
+            }
+        }
+
+        int getIndex() const { return index; }
+        uint64_t getHash() const { return hash; }
+        RosemaryAudioProcessor& getProcessor() { return *processor; }
+
+        // Block times in seconds, for the blocks processed so far
+        std::vector<double> getBlockSeconds(int64_t numBlocks) const
+        {
+            std::vector<double> seconds(static_cast<size_t>(numBlocks));
+            for (size_t block = 0; block < seconds.size(); ++block)
+                seconds[block] = juce::Time::highResolutionTicksToSeconds(blockTicks[block]);
+            return seconds;
+        }
+
+        // The processor's constructor, the last prepareToPlay() and the first block after it
+        double getConstructionSeconds() const { return juce::Time::highResolutionTicksToSeconds(constructionTicks); }
+        double getPrepareSeconds() const { return juce::Time::highResolutionTicksToSeconds(prepareTicks); }
+        double getFirstBlockSeconds() const { return juce::Time::highResolutionTicksToSeconds(blockTicks.front()); }
+
+    private:
+        void setParameter(const char* parameterID, float value)
+        {
+            auto* parameter = processor->getParameters().getParameter(parameterID);
+            parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+        }
+
+        static void automate(juce::RangedAudioParameter* parameter, double value)
+        {
+            parameter->setValueNotifyingHost(static_cast<float>(value));
+        }
+
+        // A few overlapping notes at a time, at random points in the block
+        void fillMidi()
+        {
+            midi.clear();
+
+            for (auto& note : heldNotes)
+            {
+                if (note.number >= 0 && --note.blocksLeft <= 0)
+                {
+                    midi.addEvent(juce::MidiMessage::noteOff(1, note.number), random.nextInt(blockSize));
+                    note.number = -1;
+                }
+            }
+
+            if (random.nextFloat() < 0.05f)
+            {
+                for (auto& note : heldNotes)
+                {
+                    if (note.number < 0)
+                    {
+                        note.number = 36 + random.nextInt(48);
+                        note.blocksLeft = 20 + random.nextInt(400);
+                        midi.addEvent(juce::MidiMessage::noteOn(1, note.number, 0.3f + 0.6f * random.nextFloat()),
+                                      random.nextInt(blockSize));
+                        break;
+                    }
+                }
+            }
+        }
+
+        struct HeldNote
+        {
+            int number = -1;
+            int blocksLeft = 0;
+        };
+
+        const int index;
+        const int blockSize;
+        const double sampleRate;
+
+        std::unique_ptr<RosemaryAudioProcessor> processor;
+        juce::AudioBuffer<float> buffer;
+        juce::MidiBuffer midi;
+        juce::Random random;
+        std::array<HeldNote, 4> heldNotes;
+
+        juce::RangedAudioParameter* shapeX = nullptr;
+        juce::RangedAudioParameter* shapeY = nullptr;
+        juce::RangedAudioParameter* morphX = nullptr;
+        juce::RangedAudioParameter* morphY = nullptr;
+        double lfoRate = 0.0;
+        double lfoOffset = 0.0;
+
+        int64_t constructionTicks = 0;
+        int64_t prepareTicks = 0;
+        std::vector<int64_t> blockTicks;
+        uint64_t hash = 0xcbf29ce484222325ull;
+    };
+
+    //==============================================================================
+    /**
+     * The simulated host: audio threads that take the instances in turn each period, and a main thread that
+     * runs the message loop in between.
+     */
+    class Host
+    {
+    public:
+        Host(std::vector<Instance*> instancesToRun, int numThreads)
+            : instances(std::move(instancesToRun))
+        {
+            for (int thread = 0; thread < numThreads; ++thread)
+                workers.push_back(std::make_unique<Worker>(*this, thread));
+
+            for (auto& worker : workers)
+                worker->startThread(juce::Thread::Priority::highest);
+        }
+
+        ~Host()
+        {
+            for (auto& worker : workers)
+            {
+                worker->signalThreadShouldExit();
+                worker->start.signal();
+            }
+
+            for (auto& worker : workers)
+                worker->stopThread(1000);
+        }
+
+        /**
+         * Runs every instance for numBlocks periods. Paced runs start each period on the period's schedule
+         * and count the periods whose instances didn't all finish in time.
+         */
+        void run(int64_t numBlocks, double periodSeconds, bool paced)
+        {
+            const auto periodTicks = juce::Time::secondsToHighResolutionTicks(periodSeconds);
+            auto nextStart = juce::Time::getHighResolutionTicks();
+
+            for (int64_t block = 0; block < numBlocks; ++block)
+            {
+                currentBlock = block;
+                nextInstance.store(0);
+                busyWorkers.store(static_cast<int>(workers.size()));
+
+                for (auto& worker : workers)
+                    worker->start.signal();
+
+                done.wait();
+
+                if (juce::Time::getHighResolutionTicks() - nextStart > periodTicks)
+                    ++missedPeriods;
+
+                // Whatever the instances posted to the message thread, as a host's UI thread would
+                nextStart += periodTicks;
+                if (paced)
+                {
+                    while (juce::Time::getHighResolutionTicks() < nextStart)
+                    {
+                        const auto msLeft = juce::Time::highResolutionTicksToSeconds(nextStart - juce::Time::getHighResolutionTicks()) * 1000.0;
+                        juce::MessageManager::getInstance()->runDispatchLoopUntil(juce::jmax(0, static_cast<int>(msLeft)));
+                    }
+                }
+                else if (block % 16 == 0)
+                {
+                    juce::MessageManager::getInstance()->runDispatchLoopUntil(0);
+                    nextStart = juce::Time::getHighResolutionTicks();
+                }
+                else
+                {
+                    nextStart = juce::Time::getHighResolutionTicks();
+                }
+            }
+        }
+
+        int64_t getMissedPeriods() const { return missedPeriods; }
+
+    private:
+        class Worker : public juce::Thread
+        {
+        public:
+            Worker(Host& host, int index)
+                : juce::Thread("Audio " + juce::String(index)), host(host)
+            {
+            }
+
+            void run() override
+            {
+                for (;;)
+                {
+                    start.wait();
+                    if (threadShouldExit())
+                        return;
+
+                    for (auto next = host.nextInstance.fetch_add(1); next < static_cast<int>(host.instances.size());
+                         next = host.nextInstance.fetch_add(1))
+                        host.instances[static_cast<size_t>(next)]->processBlock(host.currentBlock);
+
+                    if (host.busyWorkers.fetch_sub(1) == 1)
+                        host.done.signal();
+                }
+            }
+
+            juce::WaitableEvent start;
+
+        private:
+            Host& host;
+        };
+
+        std::vector<Instance*> instances;
+        std::vector<std::unique_ptr<Worker>> workers;
+
+        std::atomic<int> nextInstance { 0 };
+        std::atomic<int> busyWorkers { 0 };
+        juce::WaitableEvent done;
+        int64_t currentBlock = 0;
+        int64_t missedPeriods = 0;
+    };
+
+    //==============================================================================
+    double percentile(std::vector<double> values, double fraction)
+    {
+        if (values.empty())
+            return 0.0;
+
+        const auto position = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1));
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(position), values.end());
+        return values[position];
+    }
+
+    juce::String formatMicroseconds(double seconds)
+    {
+        return juce::String(seconds * 1.0e6, 1) + " us";
+    }
+
+    double mean(const std::vector<double>& values)
+    {
+        return values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+    }
+
+    juce::String formatMilliseconds(double seconds)
+    {
+        return juce::String(seconds * 1.0e3, 2) + " ms";
+    }
+
+    juce::String formatMegabytes(double bytes)
+    {
+        return juce::String(bytes / (1024.0 * 1024.0), 2) + " MB";
+    }
+
+    //==============================================================================
+    /**
+     * One oscillator on its own, playing a 440 Hz note for the benchmark's length in its block size. Returns the
+     * median block time per sample, so it compares the oscillator's kernels without the rest of the plugin.
+     * With oversamplingLog2 above 0 the oscillator runs at that many times the rate, through the same half band
+     * filters the JUCE oversampler would give the plugin, and the filters are timed along with it. An fmIndex
+     * above 0 modulates it at a 1:1 ratio.
+     */
+    template <typename SampleType>
+    double timeOscillator(const Settings& settings, typename rosy::MuOscillator<SampleType>::Antialiasing antialiasing,
+                          int oversamplingLog2 = 0, float fmIndex = 0.0f)
+    {
+        const int factor = 1 << oversamplingLog2;
+        const auto oversampledBlockSize = static_cast<juce::uint32>(settings.blockSize * factor);
+
+        rosy::ScratchArena arena;
+        rosy::MuOscillator<SampleType> oscillator;
+        oscillator.prepare({ settings.sampleRate * factor, oversampledBlockSize, 1 }, arena);
+        oscillator.setAntialiasing(antialiasing);
+        oscillator.setFrequency(static_cast<SampleType>(440));
+        oscillator.setFrequencyModulation(static_cast<SampleType>(1), static_cast<SampleType>(fmIndex));
+
+        juce::dsp::Oversampling<SampleType> oversampling(1, static_cast<size_t>(oversamplingLog2),
+                                                         juce::dsp::Oversampling<SampleType>::filterHalfBandPolyphaseIIR, true);
+        oversampling.initProcessing(static_cast<size_t>(settings.blockSize));
+
+        juce::AudioBuffer<SampleType> buffer(1, settings.blockSize);
+        juce::dsp::AudioBlock<SampleType> block(buffer);
+
+        const auto numBlocks = static_cast<size_t>(std::ceil(settings.seconds * settings.sampleRate / settings.blockSize));
+        std::vector<double> blockSeconds;
+        blockSeconds.reserve(numBlocks);
+
+        for (size_t index = 0; index < numBlocks; ++index)
+        {
+            const auto start = juce::Time::getHighResolutionTicks();
+            if (oversamplingLog2 > 0)
+            {
+                auto oversampledBlock = oversampling.processSamplesUp(block);
+                oscillator.process(juce::dsp::ProcessContextReplacing<SampleType>(oversampledBlock));
+                oversampling.processSamplesDown(block);
+            }
+            else
+            {
+                oscillator.process(juce::dsp::ProcessContextReplacing<SampleType>(block));
+            }
+            blockSeconds.push_back(juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start));
+        }
+
+        return percentile(blockSeconds, 0.5) / settings.blockSize;
+    }
+
+    juce::String formatNanoseconds(double seconds)
+    {
+        return juce::String(seconds * 1.0e9, 2) + " ns";
+    }
+
+    //==============================================================================
+    int runBenchmark(const juce::ArgumentList& args)
+    {
+        auto option = [&args](const juce::String& name, double defaultValue)
+        {
+            return args.containsOption(name) ? args.getValueForOption(name).getDoubleValue() : defaultValue;
+        };
+
+        Settings settings;
+        settings.numInstances = static_cast<int>(option("--instances", settings.numInstances));
+        settings.numThreads = static_cast<int>(option("--threads", juce::SystemStats::getNumCpus()));
+        settings.blockSize = static_cast<int>(option("--blocksize", settings.blockSize));
+        settings.sampleRate = option("--samplerate", settings.sampleRate);
+        settings.seconds = option("--seconds", settings.seconds);
+        settings.numVerified = juce::jmin(settings.numInstances, static_cast<int>(option("--verify", settings.numVerified)));
+        settings.paced = ! args.containsOption("--unpaced");
+
+        if (settings.numInstances <= 0 || settings.numThreads <= 0 || settings.blockSize <= 0
+            || settings.sampleRate <= 0.0 || settings.seconds <= 0.0 || settings.numVerified < 0)
+            juce::ConsoleApplication::fail("Instance, thread and verify counts, block size, sample rate and length must be positive");
+
+        const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+        const auto numBlocks = static_cast<int64_t>(std::ceil(settings.seconds * settings.sampleRate / settings.blockSize));
+        const double periodSeconds = settings.blockSize / settings.sampleRate;
+
+        std::cout << "Rosemary many-instance benchmark" << std::endl
+                  << "  " << settings.numInstances << " instances on " << settings.numThreads << " audio threads, "
+                  << settings.blockSize << " samples at " << settings.sampleRate << " Hz ("
+                  << formatMicroseconds(periodSeconds) << " period), " << settings.seconds << " s" << std::endl << std::endl;
+
+        //==============================================================================
+        // 1. Solo, one instance at a time on one thread
+        std::map<int, uint64_t> soloHashes;
+        std::map<int, double> soloMedians;
+
+        // The first instance in the process, before anything has run: the startup a host sees loading one plugin
+        double coldConstructionSeconds = 0.0;
+        double coldPrepareSeconds = 0.0;
+        double coldFirstBlockSeconds = 0.0;
+
+        // The first instances already cover every configuration, see Instance
+        for (int index = 0; index < settings.numVerified; ++index)
+        {
+            Instance instance(index, settings, numBlocks);
+            instance.prepare(true);
+            {
+                Host host({ &instance }, 1);
+                host.run(numBlocks, periodSeconds, false);
+            }
+
+            soloHashes[index] = instance.getHash();
+            soloMedians[index] = percentile(instance.getBlockSeconds(numBlocks), 0.5);
+
+            if (index == 0)
+            {
+                coldConstructionSeconds = instance.getConstructionSeconds();
+                coldPrepareSeconds = instance.getPrepareSeconds();
+                coldFirstBlockSeconds = instance.getFirstBlockSeconds();
+            }
+        }
+
+        //==============================================================================
+        // Construction and preparation, measured for the memory each instance takes
+        const auto residentBefore = getResidentBytes();
+
+        std::vector<std::unique_ptr<Instance>> instances;
+        std::vector<Instance*> instancePointers;
+        std::vector<double> constructionSeconds, prepareSeconds;
+        for (int index = 0; index < settings.numInstances; ++index)
+        {
+            instances.push_back(std::make_unique<Instance>(index, settings, numBlocks));
+            instances.back()->prepare(true);
+            instancePointers.push_back(instances.back().get());
+            constructionSeconds.push_back(instances.back()->getConstructionSeconds());
+            prepareSeconds.push_back(instances.back()->getPrepareSeconds());
+        }
+
+        const auto residentPrepared = getResidentBytes();
+
+        //==============================================================================
+        // 2. Crowd, offline, as fast as the threads go
+        const auto offlineStart = juce::Time::getHighResolutionTicks();
+        {
+            Host host(instancePointers, settings.numThreads);
+            host.run(numBlocks, periodSeconds, false);
+        }
+        const auto offlineSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - offlineStart);
+
+        int numMismatched = 0;
+        double slowdownSum = 0.0;
+        std::cout << "Solo against crowd (offline)" << std::endl;
+
+        for (const auto& [index, soloHash] : soloHashes)
+        {
+            auto& instance = *instances[static_cast<size_t>(index)];
+            const bool matches = instance.getHash() == soloHash;
+            const auto crowdMedian = percentile(instance.getBlockSeconds(numBlocks), 0.5);
+            const auto slowdown = soloMedians[index] > 0.0 ? crowdMedian / soloMedians[index] : 0.0;
+            numMismatched += matches ? 0 : 1;
+            slowdownSum += slowdown;
+
+            std::cout << "  #" << juce::String(index).paddedRight(' ', 5)
+                      << (matches ? "identical  " : "DIFFERENT  ")
+                      << "median block " << formatMicroseconds(soloMedians[index]) << " solo, "
+                      << formatMicroseconds(crowdMedian) << " crowd (x" << juce::String(slowdown, 2) << ")" << std::endl;
+        }
+
+        if (! soloHashes.empty())
+            std::cout << "  " << numMismatched << " of " << soloHashes.size() << " instances changed output next to others, "
+                      << "mean slowdown x" << juce::String(slowdownSum / static_cast<double>(soloHashes.size()), 2) << std::endl;
+
+        std::cout << "  Offline render:    " << juce::String(settings.seconds * settings.numInstances / offlineSeconds, 1)
+                  << " instance-seconds per second" << std::endl << std::endl;
+
+        //==============================================================================
+        // Startup: what loading an instance costs, and whether its first block runs slower than the rest
+        std::vector<double> firstBlockSeconds, firstBlockRatios;
+        for (auto& instance : instances)
+        {
+            const auto median = percentile(instance->getBlockSeconds(numBlocks), 0.5);
+            firstBlockSeconds.push_back(instance->getFirstBlockSeconds());
+            firstBlockRatios.push_back(median > 0.0 ? instance->getFirstBlockSeconds() / median : 0.0);
+        }
+
+        std::cout << "Startup" << std::endl;
+        if (settings.numVerified > 0)
+            std::cout << "  First instance:    construct " << formatMilliseconds(coldConstructionSeconds)
+                      << ", prepare " << formatMilliseconds(coldPrepareSeconds)
+                      << ", first block " << formatMicroseconds(coldFirstBlockSeconds)
+                      << " (x" << juce::String(soloMedians[0] > 0.0 ? coldFirstBlockSeconds / soloMedians[0] : 0.0, 2)
+                      << " its median)" << std::endl;
+
+        std::cout << "  Construct:         mean " << formatMilliseconds(mean(constructionSeconds))
+                  << ", max " << formatMilliseconds(percentile(constructionSeconds, 1.0)) << std::endl
+                  << "  Prepare:           mean " << formatMilliseconds(mean(prepareSeconds))
+                  << ", max " << formatMilliseconds(percentile(prepareSeconds, 1.0)) << std::endl
+                  << "  First block:       mean " << formatMicroseconds(mean(firstBlockSeconds))
+                  << ", max " << formatMicroseconds(percentile(firstBlockSeconds, 1.0))
+                  << ", mean x" << juce::String(mean(firstBlockRatios), 2) << " the instance's median" << std::endl << std::endl;
+
+        //==============================================================================
+        // 3. Crowd in real time, with the load monitor and quality governor live
+        for (auto& instance : instances)
+            instance->prepare(false);
+
+        double realtimeCpuSeconds = 0.0;
+        double realtimeWallSeconds = 0.0;
+        int64_t missedPeriods = 0;
+        {
+            // Opened before the host's threads are created, so the counters follow them
+            CacheCounters counters;
+            const auto cpuStart = getProcessCpuSeconds();
+            const auto wallStart = juce::Time::getHighResolutionTicks();
+            {
+                Host host(instancePointers, settings.numThreads);
+                host.run(numBlocks, periodSeconds, settings.paced);
+                missedPeriods = host.getMissedPeriods();
+            }
+            realtimeWallSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - wallStart);
+            realtimeCpuSeconds = getProcessCpuSeconds() - cpuStart;
+
+            std::cout << (settings.paced ? "Crowd in real time" : "Crowd in real time, unpaced") << std::endl;
+            counters.report(numBlocks * settings.numInstances);
+        }
+
+        std::vector<double> allBlockSeconds;
+        allBlockSeconds.reserve(static_cast<size_t>(numBlocks * settings.numInstances));
+        uint32_t xruns = 0;
+        uint32_t stepDowns = 0;
+        int numSilent = 0;
+
+        for (auto& instance : instances)
+        {
+            const auto blockSeconds = instance->getBlockSeconds(numBlocks);
+            allBlockSeconds.insert(allBlockSeconds.end(), blockSeconds.begin(), blockSeconds.end());
+            xruns += instance->getProcessor().getLoadMonitor().getXrunCount();
+            stepDowns += instance->getProcessor().getQualityGovernor().getStepDownCount();
+            numSilent += instance->getProcessor().getCurrentPostVolumeDb() <= -100.0f ? 1 : 0;
+        }
+
+        const auto coresBusy = realtimeWallSeconds > 0.0 ? realtimeCpuSeconds / realtimeWallSeconds : 0.0;
+        std::cout << "  Total CPU:         " << juce::String(coresBusy, 2) << " cores busy, "
+                  << juce::String(100.0 * coresBusy / settings.numInstances, 3) << "% of a core per instance" << std::endl
+                  << "  Block time:        p50 " << formatMicroseconds(percentile(allBlockSeconds, 0.5))
+                  << ", p99 " << formatMicroseconds(percentile(allBlockSeconds, 0.99))
+                  << ", max " << formatMicroseconds(percentile(allBlockSeconds, 1.0)) << std::endl
+                  << "  Missed periods:    " << missedPeriods << " of " << numBlocks << std::endl
+                  << "  Instance xruns:    " << xruns << ", quality step-downs: " << stepDowns << std::endl
+                  << "  Silent at the end: " << numSilent << " of " << settings.numInstances << std::endl << std::endl;
+
+        //==============================================================================
+        const auto residentEnd = getResidentBytes();
+        std::cout << "Memory" << std::endl;
+        if (residentBefore > 0)
+            std::cout << "  Per instance:      " << formatMegabytes(static_cast<double>(residentPrepared - residentBefore) / settings.numInstances)
+                      << " after prepare, " << formatMegabytes(static_cast<double>(residentEnd - residentBefore) / settings.numInstances)
+                      << " after running" << std::endl;
+        else
+            std::cout << "  Unavailable on this platform" << std::endl;
+
+        // Processors are torn down on the message thread, as a host would
+        instancePointers.clear();
+        instances.clear();
+
+        //==============================================================================
+        // 4. One oscillator per precision, on its own: what the double path costs over the float one, the
+        // anti-aliasing orders next to the oversampling they stand in for, and what FM adds to a plain voice
+        using FloatAntialiasing = rosy::MuOscillator<float>::Antialiasing;
+        using DoubleAntialiasing = rosy::MuOscillator<double>::Antialiasing;
+        std::cout << std::endl << "Oscillator per sample" << std::endl;
+
+        struct KernelCase
+        {
+            const char* name;
+            int antialiasingOrder;
+            int oversamplingLog2;
+            float fmIndex;
+        };
+
+        // The first case is the plain oscillator the FM one is compared with
+        const std::array<KernelCase, 6> kernelCases {{ { "off", 0, 0, 0.0f }, { "ADAA 1st order", 1, 0, 0.0f },
+                                                       { "ADAA 2nd order", 2, 0, 0.0f }, { "2x oversampling", 0, 1, 0.0f },
+                                                       { "4x oversampling", 0, 2, 0.0f }, { "FM, index 2", 0, 0, 2.0f } }};
+        double plainSeconds[2] = { 0.0, 0.0 };
+        for (const auto& kernelCase : kernelCases)
+        {
+            const auto floatSeconds = timeOscillator<float>(settings, static_cast<FloatAntialiasing>(kernelCase.antialiasingOrder),
+                                                            kernelCase.oversamplingLog2, kernelCase.fmIndex);
+            const auto doubleSeconds = timeOscillator<double>(settings, static_cast<DoubleAntialiasing>(kernelCase.antialiasingOrder),
+                                                              kernelCase.oversamplingLog2, kernelCase.fmIndex);
+            if (&kernelCase == &kernelCases.front())
+            {
+                plainSeconds[0] = floatSeconds;
+                plainSeconds[1] = doubleSeconds;
+            }
+
+            std::cout << "  " << juce::String(kernelCase.name).paddedRight(' ', 19)
+                      << formatNanoseconds(floatSeconds) << " float, " << formatNanoseconds(doubleSeconds) << " double (x"
+                      << juce::String(floatSeconds > 0.0 ? doubleSeconds / floatSeconds : 0.0, 2) << ")" << std::endl;
+
+            if (kernelCase.fmIndex > 0.0f)
+                std::cout << "  " << juce::String().paddedRight(' ', 19) << "x"
+                          << juce::String(plainSeconds[0] > 0.0 ? floatSeconds / plainSeconds[0] : 0.0, 2) << " float, x"
+                          << juce::String(plainSeconds[1] > 0.0 ? doubleSeconds / plainSeconds[1] : 0.0, 2)
+                          << " double the plain oscillator" << std::endl;
+        }
+
+        return numMismatched == 0 ? 0 : 1;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        std::cout << "Usage: " << args.executableName << " [--instances 100] [--threads cpus] [--blocksize 256]" << std::endl
+                  << "       [--samplerate 48000] [--seconds 10] [--verify 8] [--unpaced]" << std::endl << std::endl
+                  << "Exits with 1 if any verified instance's output changed when running next to the others." << std::endl;
+        return 0;
+    }
+
+    return juce::ConsoleApplication::invokeCatchingFailures ([&] { return runBenchmark (args); });
+}
@@ -0,0 +1,218 @@
+/*
+  ==============================================================================
+
+    The headless engine's implementation, the same render path as
+    RosemaryAudioProcessor::processSamples without the host, the parameter
+    tree or the load monitoring.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "RosemaryEngine.h"
+#include "../../../Source/VoiceEngine.h"
+#include "../../../Source/DbCalculator.h"
+#include <array>
+#include <type_traits>
+
+namespace rosy {
+
+struct Engine::Impl
+{
+    // Everything that renders exists once per sample type, like the plugin's render chains
+    template <typename SampleType>
+    struct Chain
+    {
+        void prepare(const juce::dsp::ProcessSpec& spec, ScratchArena& arena)
+        {
+            voiceEngine.prepare(spec, arena);
+            peakCalculator.prepare(spec);
+
+            numOutputChannels = spec.numChannels;
+            outputChannels = arena.allocate<SampleType*>(numOutputChannels);
+            for (size_t channel = 0; channel < numOutputChannels; ++channel)
+                outputChannels[channel] = arena.allocate<SampleType>(spec.maximumBlockSize);
+        }
+
+        VoiceEngine<SampleType> voiceEngine;
+        DbCalculator<SampleType> peakCalculator;
+        SampleType** outputChannels = nullptr;
+        size_t numOutputChannels = 0;
+    };
+
+    Impl(double newSampleRate, int newNumChannels, int newMaximumBlockSize)
+        : sampleRate(newSampleRate > 0.0 ? newSampleRate : 48000.0),
+          numChannels(juce::jlimit(1, 2, newNumChannels)),
+          maximumBlockSize(juce::jmax(1, newMaximumBlockSize))
+    {
+        const juce::dsp::ProcessSpec spec { sampleRate, static_cast<juce::uint32>(maximumBlockSize),
+                                            static_cast<juce::uint32>(numChannels) };
+        floatChain.prepare(spec, arena);
+        doubleChain.prepare(spec, arena);
+
+        for (size_t index = 0; index < parameterValues.size(); ++index)
+            setParameter(static_cast<Parameter>(index), parameterValues[index]);
+    }
+
+    void setParameter(Parameter parameter, float value)
+    {
+        parameterValues[static_cast<size_t>(parameter)] = value;
+
+        applyParameter(floatChain.voiceEngine, parameter, value);
+        applyParameter(doubleChain.voiceEngine, parameter, value);
+    }
+
+    template <typename SampleType>
+    static void applyParameter(VoiceEngine<SampleType>& voiceEngine, Parameter parameter, float value)
+    {
+        switch (parameter)
+        {
+            case Parameter::shapeX:        voiceEngine.setShapeX(value); break;
+            case Parameter::shapeY:        voiceEngine.setShapeY(value); break;
+            case Parameter::shapeXPan:     voiceEngine.setShapeXPan(value); break;
+            case Parameter::shapeYPan:     voiceEngine.setShapeYPan(value); break;
+            case Parameter::harmonicDecay: voiceEngine.setHarmonicDecay(value); break;
+            case Parameter::mpe:           voiceEngine.setMpeEnabled(value >= 0.5f); break;
+            case Parameter::antialiasing:
+                voiceEngine.setAntialiasing(static_cast<typename MuOscillator<SampleType>::Antialiasing>(juce::jlimit(0, 2, juce::roundToInt(value))));
+                break;
+
+            // Applied to the mixed output in render()
+            case Parameter::volume:
+            case Parameter::pan:
+                break;
+
+            // These go to the voices together at the start of render(), like the plugin does per block
+            case Parameter::fmRatio:
+            case Parameter::fmIndex:
+            case Parameter::drift:
+            case Parameter::jitter:
+            case Parameter::driftSeed:
+                break;
+        }
+    }
+
+    template <typename SampleType>
+    void render(Chain<SampleType>& chain, SampleType* const* channels, int numSamples)
+    {
+        juce::ScopedNoDenormals noDenormals;
+        if (numSamples <= 0)
+            return;
+
+        const juce::dsp::AudioBlock<SampleType> output(channels, static_cast<size_t>(numChannels), static_cast<size_t>(numSamples));
+        const auto volume = static_cast<SampleType>(parameterValues[static_cast<size_t>(Parameter::volume)]);
+        const auto pan = static_cast<SampleType>(parameterValues[static_cast<size_t>(Parameter::pan)]);
+        chain.voiceEngine.setFrequencyModulation(parameterValues[static_cast<size_t>(Parameter::fmRatio)],
+                                                 parameterValues[static_cast<size_t>(Parameter::fmIndex)]);
+        chain.voiceEngine.setAnalogDrift(parameterValues[static_cast<size_t>(Parameter::drift)],
+                                         parameterValues[static_cast<size_t>(Parameter::jitter)],
+                                         static_cast<uint32_t>(juce::jlimit(1, 9999, juce::roundToInt(parameterValues[static_cast<size_t>(Parameter::driftSeed)]))));
+
+        if (chain.voiceEngine.isSilentFor(pendingMidi) || volume == 0)
+        {
+            chain.voiceEngine.skip(numSamples, pendingMidi);
+            output.clear();
+            chain.peakCalculator.processSilence(numSamples);
+        }
+        else
+        {
+            for (int start = 0; start < numSamples; start += maximumBlockSize)
+            {
+                const int length = std::min(maximumBlockSize, numSamples - start);
+                juce::dsp::AudioBlock<SampleType> subBlock(chain.outputChannels, chain.numOutputChannels, static_cast<size_t>(length));
+
+                chain.voiceEngine.process(subBlock, pendingMidi, start, numSamples);
+                VoiceEngine<SampleType>::applyVolumeAndPan(subBlock, volume, pan);
+                output.getSubBlock(static_cast<size_t>(start), static_cast<size_t>(length)).copyFrom(subBlock);
+                chain.peakCalculator.process(juce::dsp::ProcessContextReplacing<SampleType>(subBlock));
+            }
+        }
+
+        pendingMidi.clear();
+        lastRenderedDouble = std::is_same_v<SampleType, double>;
+    }
+
+    void addEvent(const juce::MidiMessage& message, int sampleOffset)
+    {
+        pendingMidi.addEvent(message, juce::jmax(0, sampleOffset));
+    }
+
+    const double sampleRate;
+    const int numChannels;
+    const int maximumBlockSize;
+
+    ScratchArena arena;
+    Chain<float> floatChain;
+    Chain<double> doubleChain;
+    bool lastRenderedDouble = false;
+
+    juce::MidiBuffer pendingMidi;
+    std::array<float, 14> parameterValues { 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+};
+
+//==============================================================================
+Engine::Engine(double sampleRate, int numChannels, int maximumBlockSize)
+    : impl(std::make_unique<Impl>(sampleRate, numChannels, maximumBlockSize))
+{
+}
+
+Engine::~Engine() = default;
+Engine::Engine(Engine&&) noexcept = default;
+Engine& Engine::operator=(Engine&&) noexcept = default;
+
+void Engine::setParameter(Parameter parameter, float value) { impl->setParameter(parameter, value); }
+float Engine::getParameter(Parameter parameter) const { return impl->parameterValues[static_cast<size_t>(parameter)]; }
+
+void Engine::noteOn(int channel, int noteNumber, float velocity, int sampleOffset)
+{
+    impl->addEvent(juce::MidiMessage::noteOn(channel, noteNumber, velocity), sampleOffset);
+}
+
+void Engine::noteOff(int channel, int noteNumber, float velocity, int sampleOffset)
+{
+    impl->addEvent(juce::MidiMessage::noteOff(channel, noteNumber, velocity), sampleOffset);
+}
+
+void Engine::pitchBend(int channel, int value, int sampleOffset)
+{
+    impl->addEvent(juce::MidiMessage::pitchWheel(channel, value), sampleOffset);
+}
+
+void Engine::controller(int channel, int number, int value, int sampleOffset)
+{
+    impl->addEvent(juce::MidiMessage::controllerEvent(channel, number, value), sampleOffset);
+}
+
+void Engine::channelPressure(int channel, int value, int sampleOffset)
+{
+    impl->addEvent(juce::MidiMessage::channelPressureChange(channel, value), sampleOffset);
+}
+
+void Engine::reset()
+{
+    impl->pendingMidi.clear();
+    impl->floatChain.voiceEngine.reset();
+    impl->doubleChain.voiceEngine.reset();
+    impl->floatChain.peakCalculator.reset();
+    impl->doubleChain.peakCalculator.reset();
+}
+
+void Engine::render(float* const* channels, int numSamples) { impl->render(impl->floatChain, channels, numSamples); }
+void Engine::render(double* const* channels, int numSamples) { impl->render(impl->doubleChain, channels, numSamples); }
+
+int Engine::getNumChannels() const { return impl->numChannels; }
+double Engine::getSampleRate() const { return impl->sampleRate; }
+
+int Engine::getNumActiveVoices() const
+{
+    return impl->lastRenderedDouble ? impl->doubleChain.voiceEngine.getNumActiveVoices()
+                                    : impl->floatChain.voiceEngine.getNumActiveVoices();
+}
+
+float Engine::getPeakDb() const
+{
+    return impl->lastRenderedDouble ? impl->doubleChain.peakCalculator.getPeakDb()
+                                    : impl->floatChain.peakCalculator.getPeakDb();
+}
+
+} // namespace rosy
@@ -0,0 +1,87 @@
+/*
+  ==============================================================================
+
+    Headless engine: Rosemary's voice engine behind a small plain C++ API, for
+    embedding in hosts that aren't plugin hosts, e.g. a render server.
+
+    Nothing here depends on JUCE's headers, so code that includes this file
+    only has to link the RosemaryEngine static library (and JUCE's core, audio
+    basics, audio formats and dsp modules it's built from).
+
+    Each Engine owns all of its state. Engines share nothing mutable, so any
+    number of them can run on different threads at the same time; a single
+    Engine must only be used from one thread at a time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <memory>
+
+namespace rosy {
+
+class Engine
+{
+public:
+    // Defaults match RosemaryAudioProcessor's parameter layout, ranges are the same as the plugin's
+    enum class Parameter
+    {
+        volume,          // 0 to 1, default 0.5
+        pan,             // 0 (left) to 1 (right), default 0.5
+        shapeX,          // 0 to 1, default 0.5
+        shapeY,          // 0 to 1, default 0.5
+        shapeXPan,       // 0 to 1, default 0.5
+        shapeYPan,       // 0 to 1, default 0.5
+        antialiasing,    // 0 off, 1 ADAA 1st order, 2 ADAA 2nd order, default 0
+        harmonicDecay,   // Seconds, 0 keeps the spectrum static, default 0, ignored with MPE on
+        mpe,             // 0 or 1, default 0
+        fmRatio,         // Modulator over note frequency, 0.25 to 8, default 1
+        fmIndex,         // Peak deviation over modulator frequency, 0 to 10, default 0
+        drift,           // Cents of pitch drift either way, 0 to 25, default 0
+        jitter,          // Decibels of harmonic gain jitter either way, 0 to 6, default 0, ignored with MPE on
+        driftSeed        // Whole number 1 to 9999 picking the drift and jitter curves, default 1
+    };
+
+    // Buffers passed to render() can be any length; the engine works through them maximumBlockSize samples
+    // at a time. numChannels is 1 or 2.
+    Engine(double sampleRate, int numChannels = 2, int maximumBlockSize = 64);
+    ~Engine();
+
+    Engine(Engine&&) noexcept;
+    Engine& operator=(Engine&&) noexcept;
+
+    //==============================================================================
+    void setParameter(Parameter parameter, float value);
+    float getParameter(Parameter parameter) const;
+
+    // Events are queued for the next render() call, at sampleOffset samples into it. Channels are 1 to 16
+    // like MIDI's, and only matter with MPE on.
+    void noteOn(int channel, int noteNumber, float velocity, int sampleOffset = 0);
+    void noteOff(int channel, int noteNumber, float velocity = 0.0f, int sampleOffset = 0);
+    void pitchBend(int channel, int value, int sampleOffset = 0);        // 0 to 16383, centre 8192, 2 semitones either way (48 on an MPE member channel)
+    void controller(int channel, int number, int value, int sampleOffset = 0);
+    void channelPressure(int channel, int value, int sampleOffset = 0);
+
+    // Stops every note at once and clears anything queued
+    void reset();
+
+    //==============================================================================
+    // Overwrites numSamples samples of each of the channels with the engine's output. Each precision has its own
+    // voices, like the plugin's, so stick to one of the two for the life of the engine.
+    void render(float* const* channels, int numSamples);
+    void render(double* const* channels, int numSamples);
+
+    int getNumChannels() const;
+    double getSampleRate() const;
+    int getNumActiveVoices() const;
+
+    // Peak of the rendered output in dBFS, held for half a second and then falling
+    float getPeakDb() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+} // namespace rosy
@@ -0,0 +1,419 @@
+/*
+  ==============================================================================
+
+    Offline renderer: plays a MIDI file through Rosemary's voice engine and
+    writes the result to a WAV file, faster than real time.
+
+    Notes are first given voices the way the plugin's engine gives them, so
+    past its polyphony the oldest note is cut off just as it is live. Then
+    every note is rendered by its own MuVoice on a thread pool, and the notes
+    are mixed in file order. Voices render sample by sample, so the result is
+    bit-exact whatever the block size or number of threads.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include <iostream>
+#include <optional>
+#include "../../../Source/VoiceEngine.h"
+
+namespace
+{
+    // Defaults match RosemaryAudioProcessor's parameter layout
+    struct RenderParameters
+    {
+        float volume = 0.5f;
+        float pan = 0.5f;
+        float shapeX = 0.5f;
+        float shapeY = 0.5f;
+        float shapeXPan = 0.5f;
+        float shapeYPan = 0.5f;
+        int antialiasing = 0;
+        float harmonicDecay = 0.0f;
+        float fmRatio = 1.0f;
+        float fmIndex = 0.0f;
+        float drift = 0.0f;
+        float jitter = 0.0f;
+        int driftSeed = 1;
+        bool morph = false;
+        float morphX = 0.0f;
+        float morphY = 0.0f;
+
+        // Morph corners saved by the plugin, empty for corners that keep the engine's default
+        std::array<std::vector<float>, rosy::CoefficientMorph<float>::numSnapshots> morphSnapshots;
+    };
+
+    struct Note
+    {
+        int noteNumber;
+        float velocity;
+        int64_t startSample;
+        int64_t endSample;
+
+        // Where another note took the note's voice, see allocateVoices()
+        int64_t cutSample = std::numeric_limits<int64_t>::max();
+    };
+
+    //==============================================================================
+    // Reads either a raw plugin state blob (as written by getStateInformation) or plain XML
+    RenderParameters loadParameters(const juce::File& stateFile)
+    {
+        RenderParameters result;
+
+        juce::MemoryBlock data;
+        if (! stateFile.loadFileAsData(data))
+            juce::ConsoleApplication::fail("Couldn't read state file " + stateFile.getFullPathName());
+
+        // AudioProcessor::copyXmlToBinary writes a magic number and the string length before the XML
+        constexpr juce::uint32 magicXmlNumber = 0x21324356;
+        std::unique_ptr<juce::XmlElement> xml;
+        const auto* bytes = static_cast<const char*>(data.getData());
+
+        if (data.getSize() > 8 && juce::ByteOrder::littleEndianInt(bytes) == magicXmlNumber)
+        {
+            const auto length = juce::jmin(static_cast<size_t>(juce::ByteOrder::littleEndianInt(bytes + 4)),
+                                           data.getSize() - 8);
+            xml = juce::parseXML(juce::String::fromUTF8(bytes + 8, static_cast<int>(length)));
+        }
+        else
+        {
+            xml = juce::parseXML(data.toString());
+        }
+
+        if (xml == nullptr)
+            juce::ConsoleApplication::fail("State file doesn't contain any parameters: " + stateFile.getFullPathName());
+
+        for (auto* param : xml->getChildWithTagNameIterator("PARAM"))
+        {
+            const auto id = param->getStringAttribute("id");
+            const auto value = static_cast<float>(param->getDoubleAttribute("value"));
+
+            if (id == "volume")      result.volume = value;
+            else if (id == "pan")    result.pan = value;
+            else if (id == "shapeX") result.shapeX = value;
+            else if (id == "shapeY") result.shapeY = value;
+            else if (id == "shapeXPan") result.shapeXPan = value;
+            else if (id == "shapeYPan") result.shapeYPan = value;
+            else if (id == "antialiasing") result.antialiasing = juce::roundToInt(value);
+            else if (id == "harmonicDecay") result.harmonicDecay = value;
+            else if (id == "fmRatio") result.fmRatio = value;
+            else if (id == "fmIndex") result.fmIndex = value;
+            else if (id == "drift")  result.drift = value;
+            else if (id == "jitter") result.jitter = value;
+            else if (id == "driftSeed") result.driftSeed = juce::roundToInt(value);
+            else if (id == "morph")  result.morph = value >= 0.5f;
+            else if (id == "morphX") result.morphX = value;
+            else if (id == "morphY") result.morphY = value;
+        }
+
+        if (auto* morph = xml->getChildByName("MORPH"))
+        {
+            for (auto* snapshot : morph->getChildWithTagNameIterator("SNAPSHOT"))
+            {
+                const int index = snapshot->getIntAttribute("index", -1);
+                if (! juce::isPositiveAndBelow(index, rosy::CoefficientMorph<float>::numSnapshots))
+                    continue;
+
+                auto& gains = result.morphSnapshots[static_cast<size_t>(index)];
+                for (const auto& gain : juce::StringArray::fromTokens(snapshot->getStringAttribute("gains"), false))
+                    gains.push_back(gain.getFloatValue());
+            }
+        }
+
+        return result;
+    }
+
+    std::vector<Note> loadNotes(const juce::File& midiFile, double sampleRate)
+    {
+        juce::FileInputStream stream(midiFile);
+        juce::MidiFile file;
+        if (! stream.openedOk() || ! file.readFrom(stream))
+            juce::ConsoleApplication::fail("Couldn't read MIDI file " + midiFile.getFullPathName());
+
+        file.convertTimestampTicksToSeconds();
+
+        juce::MidiMessageSequence sequence;
+        for (int track = 0; track < file.getNumTracks(); ++track)
+            sequence.addSequence(*file.getTrack(track), 0.0);
+        sequence.updateMatchedPairs();
+
+        std::vector<Note> notes;
+        for (auto* event : sequence)
+        {
+            if (! event->message.isNoteOn())
+                continue;
+
+            const double start = event->message.getTimeStamp();
+            const double end = event->noteOffObject != nullptr ? event->noteOffObject->message.getTimeStamp()
+                                                               : sequence.getEndTime();
+
+            notes.push_back({ event->message.getNoteNumber(),
+                              event->message.getFloatVelocity(),
+                              static_cast<int64_t>(std::llround(start * sampleRate)),
+                              static_cast<int64_t>(std::llround(end * sampleRate)) });
+        }
+
+        return notes;
+    }
+
+    // Samples a voice keeps sounding after its note off, the most its release can take
+    int64_t getReleaseSamples(double sampleRate)
+    {
+        return static_cast<int64_t>(std::ceil(rosy::MuVoice<float>::releaseSeconds * sampleRate)) + 1;
+    }
+
+    //==============================================================================
+    /**
+     * Plays the notes through VoiceEngine's voice allocation without rendering them. A note off releases every
+     * sounding note of that pitch, and a note on takes the first free voice or steals the one started longest
+     * ago, which cuts the note playing on it off. Each note's end is moved to where it was released and its
+     * cut to where it was stolen, so rendering the notes independently afterwards sounds like the engine.
+     *
+     * A voice counts as busy for the longest its release can take, so one freed within a sample of a note on
+     * can be stolen from here where the engine would find it free.
+     */
+    void allocateVoices(std::vector<Note>& notes, double sampleRate)
+    {
+        struct Event
+        {
+            int64_t sample;
+            int order;  // Note offs before note ons on the same sample, except a note's own off
+            size_t note;
+        };
+
+        std::vector<Event> events;
+        for (size_t index = 0; index < notes.size(); ++index)
+        {
+            const auto& note = notes[index];
+            events.push_back({ note.startSample, 1, index });
+            events.push_back({ note.endSample, note.endSample > note.startSample ? 0 : 2, index });
+        }
+
+        std::stable_sort(events.begin(), events.end(), [](const Event& a, const Event& b)
+        {
+            return a.sample != b.sample ? a.sample < b.sample : a.order < b.order;
+        });
+
+        struct Voice
+        {
+            std::optional<size_t> note;
+            bool held = false;
+            int64_t busyUntil = 0;
+        };
+
+        const auto releaseSamples = getReleaseSamples(sampleRate);
+        std::array<Voice, rosy::VoiceEngine<float>::maxVoices> voices;
+        std::vector<int64_t> releaseSample(notes.size(), std::numeric_limits<int64_t>::max());
+
+        for (const auto& event : events)
+        {
+            if (event.order == 1)
+            {
+                auto isFree = [&event](const Voice& voice) { return ! voice.held && voice.busyUntil <= event.sample; };
+                auto voice = std::find_if(voices.begin(), voices.end(), isFree);
+
+                // Notes start in file order, so the oldest is the one with the lowest index
+                if (voice == voices.end())
+                {
+                    voice = std::min_element(voices.begin(), voices.end(), [](const Voice& a, const Voice& b) { return *a.note < *b.note; });
+                    notes[*voice->note].cutSample = event.sample;
+                }
+
+                *voice = { event.note, true, 0 };
+                continue;
+            }
+
+            const int noteNumber = notes[event.note].noteNumber;
+            for (auto& voice : voices)
+            {
+                if (voice.held && notes[*voice.note].noteNumber == noteNumber)
+                {
+                    voice.held = false;
+                    voice.busyUntil = event.sample + releaseSamples;
+                    releaseSample[*voice.note] = event.sample;
+                }
+            }
+        }
+
+        // Notes stolen while held never see a note off, they're cut while still sounding
+        for (size_t index = 0; index < notes.size(); ++index)
+            notes[index].endSample = std::min(notes[index].endSample, releaseSample[index]);
+    }
+
+    // Left and right channels of one rendered note
+    using RenderedNote = std::array<std::vector<float>, 2>;
+
+    //==============================================================================
+    // Renders one note from its start until its release has finished or its voice is stolen. noteKey is the
+    // note's place in the file counting from 1, which is the key the plugin's engine gives it when it plays the
+    // file from the start.
+    RenderedNote renderNote(const Note& note, uint32_t noteKey, const RenderParameters& parameters,
+                            const rosy::CoefficientMorph<float>& morph, double sampleRate, int blockSize)
+    {
+        // Automation isn't rendered, so the morph position is the same for every sample
+        const std::vector<float> morphX(static_cast<size_t>(blockSize), parameters.morphX);
+        const std::vector<float> morphY(static_cast<size_t>(blockSize), parameters.morphY);
+        const auto morphPositions = parameters.morph ? rosy::MorphPositions<float> { &morph, morphX.data(), morphY.data() }
+                                                     : rosy::MorphPositions<float> {};
+
+        rosy::ScratchArena arena;
+        rosy::MuVoice<float> voice;
+        voice.prepare({ sampleRate, static_cast<juce::uint32>(blockSize), 2 }, arena);
+        voice.setShapeX(parameters.shapeX);
+        voice.setShapeY(parameters.shapeY);
+        voice.setShapeXPan(parameters.shapeXPan);
+        voice.setShapeYPan(parameters.shapeYPan);
+        voice.setAntialiasing(static_cast<rosy::MuOscillator<float>::Antialiasing>(parameters.antialiasing));
+        voice.setFrequencyModulation(parameters.fmRatio, parameters.fmIndex);
+
+        rosy::AnalogDrift drift;
+        drift.prepare(sampleRate);
+        drift.setPitchDrift(parameters.drift);
+        drift.setGainJitter(parameters.jitter);
+        drift.setSeed(static_cast<uint32_t>(parameters.driftSeed));
+        voice.setAnalogDrift(&drift);
+
+        // A batch of one, so the note's spectrum evolves exactly as it does in the plugin's engine
+        rosy::HarmonicEnvelopes<float> harmonicEnvelopes;
+        harmonicEnvelopes.prepare(sampleRate, 1, blockSize);
+        harmonicEnvelopes.setDecay(parameters.harmonicDecay);
+        harmonicEnvelopes.setAnalogDrift(&drift);
+        harmonicEnvelopes.setProfile(voice.getCurrentHarmonicGains(), voice.getChannelHarmonicGains(0),
+                                     voice.getChannelHarmonicGains(1), voice.isStereo());
+        harmonicEnvelopes.updateProfile();
+        const bool useEnvelopes = harmonicEnvelopes.isActive() && ! parameters.morph;
+
+        const int64_t heldSamples = std::max<int64_t>(note.endSample - note.startSample, 0);
+        const int64_t soundingSamples = std::min(heldSamples + getReleaseSamples(sampleRate), note.cutSample - note.startSample);
+        const auto length = static_cast<size_t>(std::max<int64_t>(soundingSamples, 0));
+        RenderedNote output { std::vector<float>(length, 0.0f), std::vector<float>(length, 0.0f) };
+
+        voice.startNote(note.noteNumber, note.velocity, noteKey);
+
+        int64_t position = 0;
+        while (position < static_cast<int64_t>(length) && voice.isActive())
+        {
+            // Checked before rendering, so a note off on the note on's own sample still releases the note
+            if (position == heldSamples)
+                voice.stopNote(true);
+
+            // Split at the note off so it lands on the same sample as it would in the plugin
+            const int64_t boundary = std::min(position < heldSamples ? heldSamples : std::numeric_limits<int64_t>::max(),
+                                              static_cast<int64_t>(length));
+            const auto numSamples = static_cast<size_t>(std::min<int64_t>(blockSize, boundary - position));
+
+            float* channels[] = { output[0].data() + position, output[1].data() + position };
+            if (useEnvelopes)
+            {
+                harmonicEnvelopes.clearVoices();
+                harmonicEnvelopes.addVoice(0, voice.getNextControlTick(), voice.getSamplesUntilControlTick(), numSamples, noteKey);
+                harmonicEnvelopes.calculate();
+            }
+
+            voice.renderNextBlock(juce::dsp::AudioBlock<float>(channels, 2, numSamples), morphPositions,
+                                  useEnvelopes ? harmonicEnvelopes.getCoefficients(0) : rosy::EnvelopeCoefficients<float> {});
+            position += static_cast<int64_t>(numSamples);
+        }
+
+        return output;
+    }
+
+    //==============================================================================
+    int render(const juce::ArgumentList& args)
+    {
+        const auto stateFile = args.getExistingFileForOption("--state");
+        const auto midiFile = args.getExistingFileForOption("--midi");
+        const auto outputFile = args.getFileForOption("--output");
+
+        const double sampleRate = args.containsOption("--samplerate") ? args.getValueForOption("--samplerate").getDoubleValue() : 48000.0;
+        const int blockSize = args.containsOption("--blocksize") ? args.getValueForOption("--blocksize").getIntValue() : 512;
+        const int bitsPerSample = args.containsOption("--bits") ? args.getValueForOption("--bits").getIntValue() : 24;
+        const int numThreads = args.containsOption("--threads") ? args.getValueForOption("--threads").getIntValue()
+                                                                : juce::SystemStats::getNumCpus();
+
+        if (sampleRate <= 0.0 || blockSize <= 0 || numThreads <= 0)
+            juce::ConsoleApplication::fail("Sample rate, block size and thread count must be positive");
+
+        const auto parameters = loadParameters(stateFile);
+        auto notes = loadNotes(midiFile, sampleRate);
+        allocateVoices(notes, sampleRate);
+
+        // Same corners as the plugin: its defaults, replaced by any the state saved
+        rosy::CoefficientMorph<float> morph;
+        rosy::VoiceEngine<float>::setShapeCornerSnapshots(morph);
+        for (int index = 0; index < rosy::CoefficientMorph<float>::numSnapshots; ++index)
+            if (! parameters.morphSnapshots[static_cast<size_t>(index)].empty())
+                morph.setSnapshot(index, parameters.morphSnapshots[static_cast<size_t>(index)]);
+        morph.updateSnapshots();
+
+        const auto startTicks = juce::Time::getHighResolutionTicks();
+
+        // Once their voices are settled notes don't interact, so render each one as its own job
+        std::vector<RenderedNote> renderedNotes(notes.size());
+        {
+            juce::ThreadPool pool(numThreads);
+            for (size_t i = 0; i < notes.size(); ++i)
+                pool.addJob([&, i] { renderedNotes[i] = renderNote(notes[i], static_cast<uint32_t>(i + 1), parameters, morph, sampleRate, blockSize); });
+
+            while (pool.getNumJobs() > 0)
+                juce::Thread::sleep(1);
+        }
+
+        // Mix in file order so the sum is the same however the jobs were scheduled
+        int64_t totalSamples = 0;
+        for (size_t i = 0; i < notes.size(); ++i)
+            totalSamples = std::max(totalSamples, notes[i].startSample + static_cast<int64_t>(renderedNotes[i][0].size()));
+
+        if (totalSamples > std::numeric_limits<int>::max())
+            juce::ConsoleApplication::fail("MIDI file is too long to render in one go");
+
+        juce::AudioBuffer<float> mix(2, static_cast<int>(totalSamples));
+        mix.clear();
+        for (size_t i = 0; i < notes.size(); ++i)
+            for (int channel = 0; channel < mix.getNumChannels(); ++channel)
+                mix.addFrom(channel, static_cast<int>(notes[i].startSample), renderedNotes[i][static_cast<size_t>(channel)].data(),
+                            static_cast<int>(renderedNotes[i][static_cast<size_t>(channel)].size()));
+
+        rosy::VoiceEngine<float>::applyVolumeAndPan(juce::dsp::AudioBlock<float>(mix), parameters.volume, parameters.pan);
+
+        const double renderSeconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        // Write the result
+        outputFile.deleteFile();
+        auto stream = std::make_unique<juce::FileOutputStream>(outputFile);
+        if (! stream->openedOk())
+            juce::ConsoleApplication::fail("Couldn't open " + outputFile.getFullPathName() + " for writing");
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(juce::WavAudioFormat().createWriterFor(stream.get(), sampleRate,
+                                                                                              static_cast<unsigned int>(mix.getNumChannels()),
+                                                                                              bitsPerSample, {}, 0));
+        if (writer == nullptr)
+            juce::ConsoleApplication::fail("Couldn't create a " + juce::String(bitsPerSample) + " bit WAV writer");
+
+        stream.release();  // The writer owns the stream now
+        writer->writeFromAudioSampleBuffer(mix, 0, mix.getNumSamples());
+
+        const double durationSeconds = totalSamples / sampleRate;
+        std::cout << "Rendered " << notes.size() << " notes, " << durationSeconds << " s of audio in "
+                  << renderSeconds << " s (" << (renderSeconds > 0.0 ? durationSeconds / renderSeconds : 0.0)
+                  << "x real time) on " << numThreads << " threads" << std::endl;
+
+        return 0;
+    }
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    if (args.size() == 0 || args.containsOption("--help|-h"))
+    {
+        std::cout << "Usage: " << args.executableName << " --state <file> --midi <file.mid> --output <file.wav>" << std::endl
+                  << "       [--samplerate 48000] [--blocksize 512] [--bits 24] [--threads <cores>]" << std::endl;
+        return 0;
+    }
+
+    return juce::ConsoleApplication::invokeCatchingFailures ([&] { return render (args); });
+}
\ No newline at end of file